@@ -10,7 +10,9 @@ MediaPlayerControl::MediaPlayerControl():
     mSeekingPosition(0),
     mPrepareSync(false),
     mPrepareStatus(NO_ERROR),
-    mAudioSessionId(0)
+    mAudioSessionId(0),
+    mEventCount(0),
+    mEventBatchStart(0)
 {
 }
 
@@ -202,21 +204,46 @@ status_t MediaPlayerControl::seekTo(float msec)
 {
     if (mMediaPlayerEx != nullptr)
     {
-        // if in seeking state, put seek message in queue, to process after preview seeking.
-        if (mSeeking)
-        {
-            mMediaPlayerEx->getMessageQueue()->postMessage(MSG_REQUEST_SEEK, msec);
-        }
-        else
-        {
-            mMediaPlayerEx->seekTo(msec);
-            mSeekingPosition = (long) msec;
-            mSeeking = true;
-        }
+        // 定位不阻塞，正在定位时新的目标直接替换旧的目标，只回调最后一次定位完成
+        mMediaPlayerEx->seekTo(msec);
+        mSeekingPosition = (long) msec;
+        mSeeking = true;
     }
     return NO_ERROR;
 }
 
+status_t MediaPlayerControl::beginScrub()
+{
+    if (mMediaPlayerEx == nullptr)
+    {
+        return INVALID_OPERATION;
+    }
+    mMediaPlayerEx->beginScrub();
+    return NO_ERROR;
+}
+
+status_t MediaPlayerControl::updateScrub(float msec)
+{
+    if (mMediaPlayerEx == nullptr)
+    {
+        return INVALID_OPERATION;
+    }
+    mMediaPlayerEx->updateScrub(msec);
+    mSeekingPosition = (long) msec;
+    mSeeking = true;
+    return NO_ERROR;
+}
+
+status_t MediaPlayerControl::endScrub()
+{
+    if (mMediaPlayerEx == nullptr)
+    {
+        return INVALID_OPERATION;
+    }
+    mMediaPlayerEx->endScrub();
+    return NO_ERROR;
+}
+
 long MediaPlayerControl::getCurrentPosition()
 {
     if (mMediaPlayerEx != nullptr)
@@ -230,6 +257,35 @@ long MediaPlayerControl::getCurrentPosition()
     return 0;
 }
 
+status_t MediaPlayerControl::dumpTrace(const char *path)
+{
+    if (mMediaPlayerEx == nullptr)
+    {
+        return INVALID_OPERATION;
+    }
+    return mMediaPlayerEx->dumpTrace(path);
+}
+
+status_t MediaPlayerControl::getStats(PlayerStats *stats)
+{
+    if (mMediaPlayerEx == nullptr)
+    {
+        return INVALID_OPERATION;
+    }
+    mMediaPlayerEx->getStats(stats);
+    return NO_ERROR;
+}
+
+status_t MediaPlayerControl::getPlaybackSnapshot(PlaybackSnapshot *snapshot)
+{
+    if (mMediaPlayerEx == nullptr)
+    {
+        return INVALID_OPERATION;
+    }
+    mMediaPlayerEx->getPlaybackSnapshot(snapshot);
+    return NO_ERROR;
+}
+
 long MediaPlayerControl::getDuration()
 {
     if (mMediaPlayerEx != nullptr)
@@ -347,17 +403,65 @@ void MediaPlayerControl::notify(int msg, int ext1, int ext2, void *obj, int len)
     }
 }
 
+/**
+ * 投递事件，开启批量投递时先累积，位置和缓冲进度只保留最新的值，
+ * 其他状态事件到来时连同之前累积的事件立即投递，带数据的事件不参与批量投递
+ */
 void MediaPlayerControl::postEvent(int what, int arg1, int arg2, void *obj)
 {
-    if (mListener != nullptr)
+    if (mListener == nullptr)
     {
+        return;
+    }
+    int batchTime = mMediaPlayerEx != nullptr ? mMediaPlayerEx->getPlayerState()->eventBatchTime : 0;
+    if (batchTime <= 0 || obj != NULL)
+    {
+        flushEvents();
         mListener->notify(what, arg1, arg2, obj);
+        return;
+    }
+
+    bool reducible = (what == MEDIA_CURRENT || what == MEDIA_BUFFERING_UPDATE);
+    if (reducible)
+    {
+        // 累积的事件中只有位置和缓冲进度，直接替换不会改变与状态事件的先后顺序
+        for (int i = 0; i < mEventCount; ++i)
+        {
+            if (mEvents[i * 3] == what)
+            {
+                mEvents[i * 3 + 1] = arg1;
+                mEvents[i * 3 + 2] = arg2;
+                return;
+            }
+        }
     }
+    if (mEventCount == 0)
+    {
+        mEventBatchStart = av_gettime_relative();
+    }
+    mEvents[mEventCount * 3] = what;
+    mEvents[mEventCount * 3 + 1] = arg1;
+    mEvents[mEventCount * 3 + 2] = arg2;
+    mEventCount++;
+    if (!reducible || mEventCount == EVENT_BATCH_MAX)
+    {
+        flushEvents();
+    }
+}
+
+void MediaPlayerControl::flushEvents()
+{
+    if (mEventCount > 0 && mListener != nullptr)
+    {
+        mListener->notifyBatch(mEvents, mEventCount);
+    }
+    mEventCount = 0;
 }
 
 void MediaPlayerControl::run()
 {
     int retval;
+    TRACE_THREAD("message");
     while (true)
     {
         if (abortRequest)
@@ -373,7 +477,28 @@ void MediaPlayerControl::run()
         }
 
         AVMessage msg;
-        retval = mMediaPlayerEx->getMessageQueue()->getMessage(&msg);
+        if (mEventCount > 0)
+        {
+            // 有累积的事件时，最多等到时间窗口结束
+            int batchTime = mMediaPlayerEx->getPlayerState()->eventBatchTime;
+            int64_t remaining = mEventBatchStart + batchTime * 1000LL - av_gettime_relative();
+            if (remaining <= 0)
+            {
+                flushEvents();
+                continue;
+            }
+            retval = mMediaPlayerEx->getMessageQueue()->getMessage(&msg, 1,
+                                                                   (int) ((remaining + 999) / 1000));
+            if (retval == 0)
+            {
+                flushEvents();
+                continue;
+            }
+        }
+        else
+        {
+            retval = mMediaPlayerEx->getMessageQueue()->getMessage(&msg);
+        }
         if (retval < 0)
         {
             ALOGE("getMessage error");
@@ -381,6 +506,7 @@ void MediaPlayerControl::run()
         }
 
         assert(retval > 0);
+        TRACE_SCOPE_ARG("message", msg.what);
 
         switch (msg.what)
         {
@@ -557,4 +683,5 @@ void MediaPlayerControl::run()
         }
         message_free_resouce(&msg);
     }
+    flushEvents();
 }
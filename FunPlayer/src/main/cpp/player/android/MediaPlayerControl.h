@@ -70,10 +70,22 @@ enum media_info_type {
 };
 
 
+// 一次批量投递的最大事件数
+#define EVENT_BATCH_MAX 32
+
 class MediaPlayerListener
 {
 public:
     virtual void notify(int msg, int ext1, int ext2, void *obj) {}
+
+    // 批量投递事件，events 按照 msg, ext1, ext2 依次排列，count 为事件数
+    virtual void notifyBatch(const int *events, int count)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            notify(events[i * 3], events[i * 3 + 1], events[i * 3 + 2], NULL);
+        }
+    }
 };
 
 class MediaPlayerControl
@@ -119,10 +131,22 @@ public:
 
     status_t seekTo(float msec);
 
+    status_t beginScrub();
+
+    status_t updateScrub(float msec);
+
+    status_t endScrub();
+
     long getCurrentPosition();
 
     long getDuration();
 
+    status_t getStats(PlayerStats *stats);
+
+    status_t getPlaybackSnapshot(PlaybackSnapshot *snapshot);
+
+    status_t dumpTrace(const char *path);
+
     status_t reset();
 
     status_t setAudioStreamType(int type);
@@ -154,6 +178,9 @@ public:
 private:
     void postEvent(int what, int arg1, int arg2, void *obj = NULL);
 
+    // 投递累积的事件
+    void flushEvents();
+
 private:
     std::mutex              mMutex;
     std::thread             mThread;
@@ -167,4 +194,8 @@ private:
     bool                    mPrepareSync;
     status_t                mPrepareStatus;
     int                     mAudioSessionId;
+
+    int                     mEvents[EVENT_BATCH_MAX * 3];   // 累积待投递的事件
+    int                     mEventCount;                    // 累积的事件数
+    int64_t                 mEventBatchStart;               // 第一个累积事件的时间
 };
\ No newline at end of file
@@ -15,6 +15,7 @@ struct fields_t
 {
     jfieldID context;
     jmethodID post_event;
+    jmethodID post_events;
 };
 
 static fields_t fields;
@@ -42,6 +43,8 @@ public:
 
     void notify(int msg, int ext1, int ext2, void *obj) override;
 
+    void notifyBatch(const int *events, int count) override;
+
 private:
     jclass mClass;
     jobject mObject;
@@ -93,6 +96,40 @@ void JniMediaPlayerListener::notify(int msg, int ext1, int ext2, void *obj)
     }
 }
 
+/**
+ * 一次JNI调用投递多个事件，减少线程附加和跨越JNI的次数
+ */
+void JniMediaPlayerListener::notifyBatch(const int *events, int count)
+{
+    if (fields.post_events == NULL)
+    {
+        MediaPlayerListener::notifyBatch(events, count);
+        return;
+    }
+    JNIEnv *env = getJNIEnv();
+
+    bool status = (javaVM->AttachCurrentThread(&env, NULL) >= 0);
+
+    jintArray array = env->NewIntArray(count * 3);
+    if (array != NULL)
+    {
+        env->SetIntArrayRegion(array, 0, count * 3, events);
+        env->CallStaticVoidMethod(mClass, fields.post_events, mObject, array);
+        env->DeleteLocalRef(array);
+    }
+
+    if (env->ExceptionCheck())
+    {
+        ALOGW("An exception occurred while notifying events.");
+        env->ExceptionClear();
+    }
+
+    if (status)
+    {
+        javaVM->DetachCurrentThread();
+    }
+}
+
 static MediaPlayerControl *getMediaPlayer(JNIEnv *env, jobject thiz)
 {
     MediaPlayerControl *const mp = (MediaPlayerControl *) env->GetLongField(thiz, fields.context);
@@ -286,6 +323,14 @@ void MediaPlayerEx_init(JNIEnv *env)
     {
         return;
     }
+
+    // 批量投递的方法不存在时逐个投递
+    fields.post_events = env->GetStaticMethodID(clazz, "postEventsFromNative",
+            "(Ljava/lang/Object;[I)V");
+    if (fields.post_events == NULL)
+    {
+        env->ExceptionClear();
+    }
     env->DeleteLocalRef(clazz);
 }
 
@@ -459,6 +504,39 @@ void MediaPlayerEx_seekTo(JNIEnv *env, jobject thiz, jfloat timeMs)
     mp->seekTo(timeMs);
 }
 
+void MediaPlayerEx_beginScrub(JNIEnv *env, jobject thiz)
+{
+    MediaPlayerControl *mp = getMediaPlayer(env, thiz);
+    if (mp == NULL)
+    {
+        jniThrowException(env, "java/lang/IllegalStateException");
+        return;
+    }
+    mp->beginScrub();
+}
+
+void MediaPlayerEx_updateScrub(JNIEnv *env, jobject thiz, jfloat timeMs)
+{
+    MediaPlayerControl *mp = getMediaPlayer(env, thiz);
+    if (mp == NULL)
+    {
+        jniThrowException(env, "java/lang/IllegalStateException");
+        return;
+    }
+    mp->updateScrub(timeMs);
+}
+
+void MediaPlayerEx_endScrub(JNIEnv *env, jobject thiz)
+{
+    MediaPlayerControl *mp = getMediaPlayer(env, thiz);
+    if (mp == NULL)
+    {
+        jniThrowException(env, "java/lang/IllegalStateException");
+        return;
+    }
+    mp->endScrub();
+}
+
 void MediaPlayerEx_setMute(JNIEnv *env, jobject thiz, jboolean mute)
 {
     MediaPlayerControl *mp = getMediaPlayer(env, thiz);
@@ -525,6 +603,148 @@ jlong MediaPlayerEx_getDuration(JNIEnv *env, jobject thiz)
     return mp->getDuration();
 }
 
+/**
+ * 统计快照展开成long数组，按功能分组依次写入，每组的下标与MediaPlayerEx.java中的STATS_*常量对应，
+ * 新增的统计只能追加在末尾
+ */
+jlongArray MediaPlayerEx_getStats(JNIEnv *env, jobject thiz)
+{
+    MediaPlayerControl *mp = getMediaPlayer(env, thiz);
+    if (mp == NULL)
+    {
+        jniThrowException(env, "java/lang/IllegalStateException");
+        return NULL;
+    }
+    PlayerStats stats;
+    if (mp->getStats(&stats) != NO_ERROR)
+    {
+        return NULL;
+    }
+    jlong values[STAGE_COUNT * 5 + 11 + STARTUP_PHASE_COUNT + 26];
+    int count = 0;
+    // 各阶段的次数、总耗时、最大耗时、p50、p99(微秒)
+    for (int i = 0; i < STAGE_COUNT; ++i)
+    {
+        values[count++] = stats.stages[i].count;
+        values[count++] = stats.stages[i].totalTime;
+        values[count++] = stats.stages[i].maxTime;
+        values[count++] = stats.stages[i].p50;
+        values[count++] = stats.stages[i].p99;
+    }
+    // 队列深度，STATS_AUDIO_PACKETS
+    values[count++] = stats.audioPackets;
+    values[count++] = stats.videoPackets;
+    values[count++] = stats.audioQueueBytes;
+    values[count++] = stats.videoQueueBytes;
+    values[count++] = stats.videoFrames;
+    values[count++] = stats.audioBufferBytes;
+    // 帧计数，STATS_DECODED_FRAMES
+    values[count++] = stats.decodedFrames;
+    values[count++] = stats.droppedFrames;
+    values[count++] = stats.presentedFrames;
+    values[count++] = stats.repeatedFrames;
+    values[count++] = stats.skippedFrames;
+    // 起播各阶段完成的时间(微秒)，STATS_STARTUP_OPEN
+    for (int i = 0; i < STARTUP_PHASE_COUNT; ++i)
+    {
+        values[count++] = stats.startupTime[i];
+    }
+    // 数据包缓存定位，STATS_CACHED_SEEKS
+    values[count++] = stats.cachedSeeks;
+    values[count++] = stats.demuxerSeeks;
+    values[count++] = stats.packetCacheBytes;
+    // 定位合并与中断，STATS_COALESCED_SEEKS，以及定位到显示的耗时，STATS_SEEK_LATENCY
+    values[count++] = stats.coalescedSeeks;
+    values[count++] = stats.abortedSeeks;
+    values[count++] = stats.seekLatency.count;
+    values[count++] = stats.seekLatency.totalTime;
+    values[count++] = stats.seekLatency.maxTime;
+    values[count++] = stats.seekLatency.p50;
+    values[count++] = stats.seekLatency.p99;
+    // 精确定位，STATS_ACCURATE_SEEKS，以及追帧耗时，STATS_CATCHUP_TIME
+    values[count++] = stats.accurateSeeks;
+    values[count++] = stats.catchupFrames;
+    values[count++] = stats.catchupTime.count;
+    values[count++] = stats.catchupTime.totalTime;
+    values[count++] = stats.catchupTime.maxTime;
+    values[count++] = stats.catchupTime.p50;
+    values[count++] = stats.catchupTime.p99;
+    // 关键帧索引，STATS_INDEX_SEEKS
+    values[count++] = stats.indexSeeks;
+    values[count++] = stats.seekIndexEntries;
+    // 预读I/O，STATS_IO_BUFFERED_BYTES
+    values[count++] = stats.ioBufferedBytes;
+    values[count++] = stats.ioReadBytes;
+    values[count++] = stats.ioReadTime;
+    values[count++] = stats.ioStalls;
+    values[count++] = stats.ioStallTime;
+    values[count++] = stats.ioBufferSeeks;
+    values[count++] = stats.ioSeeks;
+
+    jlongArray array = env->NewLongArray(count);
+    if (array != NULL)
+    {
+        env->SetLongArrayRegion(array, 0, count, values);
+    }
+    return array;
+}
+
+/**
+ * 播放状态快照展开成long数组，顺序与PlaybackSnapshot一致
+ */
+jlongArray MediaPlayerEx_getPlaybackSnapshot(JNIEnv *env, jobject thiz)
+{
+    MediaPlayerControl *mp = getMediaPlayer(env, thiz);
+    if (mp == NULL)
+    {
+        jniThrowException(env, "java/lang/IllegalStateException");
+        return NULL;
+    }
+    PlaybackSnapshot snapshot;
+    if (mp->getPlaybackSnapshot(&snapshot) != NO_ERROR)
+    {
+        return NULL;
+    }
+    jlong values[] = {
+            snapshot.position,
+            snapshot.duration,
+            snapshot.bufferedPosition,
+            snapshot.videoWidth,
+            snapshot.videoHeight,
+            snapshot.rotation,
+            snapshot.state,
+            snapshot.seeking,
+            snapshot.droppedFrames,
+            snapshot.stallCount
+    };
+    int count = sizeof(values) / sizeof(values[0]);
+
+    jlongArray array = env->NewLongArray(count);
+    if (array != NULL)
+    {
+        env->SetLongArrayRegion(array, 0, count, values);
+    }
+    return array;
+}
+
+jint MediaPlayerEx_dumpTrace(JNIEnv *env, jobject thiz, jstring path_)
+{
+    MediaPlayerControl *mp = getMediaPlayer(env, thiz);
+    if (mp == NULL)
+    {
+        jniThrowException(env, "java/lang/IllegalStateException");
+        return -1;
+    }
+    const char *path = env->GetStringUTFChars(path_, 0);
+    if (path == NULL)
+    {
+        return -1;
+    }
+    int ret = mp->dumpTrace(path);
+    env->ReleaseStringUTFChars(path_, path);
+    return ret;
+}
+
 jboolean MediaPlayerEx_isPlaying(JNIEnv *env, jobject thiz)
 {
     MediaPlayerControl *mp = getMediaPlayer(env, thiz);
@@ -628,10 +848,16 @@ static const JNINativeMethod gMethods[] = {
         {"_getVideoWidth",      "()I",                                      (void *) MediaPlayerEx_getVideoWidth},
         {"_getVideoHeight",     "()I",                                      (void *) MediaPlayerEx_getVideoHeight},
         {"_seekTo",             "(F)V",                                     (void *) MediaPlayerEx_seekTo},
+        {"_beginScrub",         "()V",                                      (void *) MediaPlayerEx_beginScrub},
+        {"_updateScrub",        "(F)V",                                     (void *) MediaPlayerEx_updateScrub},
+        {"_endScrub",           "()V",                                      (void *) MediaPlayerEx_endScrub},
         {"_pause",              "()V",                                      (void *) MediaPlayerEx_pause},
         {"_isPlaying",          "()Z",                                      (void *) MediaPlayerEx_isPlaying},
         {"_getCurrentPosition", "()J",                                      (void *) MediaPlayerEx_getCurrentPosition},
         {"_getDuration",        "()J",                                      (void *) MediaPlayerEx_getDuration},
+        {"_getStats",           "()[J",                                     (void *) MediaPlayerEx_getStats},
+        {"_dumpTrace",          "(Ljava/lang/String;)I",                    (void *) MediaPlayerEx_dumpTrace},
+        {"_getPlaybackSnapshot", "()[J",                                    (void *) MediaPlayerEx_getPlaybackSnapshot},
         {"_release",            "()V",                                      (void *) MediaPlayerEx_release},
         {"_reset",              "()V",                                      (void *) MediaPlayerEx_reset},
         {"_setLooping",         "(Z)V",                                     (void *) MediaPlayerEx_setLooping},
@@ -0,0 +1,23 @@
+#ifndef HOSTTEST_H
+#define HOSTTEST_H
+
+#include <cstdio>
+
+/**
+ * 桌面端检查程序共用的断言，每个检查程序只有一个源文件
+ * 条件不成立时输出失败信息并计数，不中断，main根据失败次数返回非0
+ */
+static int failures = 0;
+
+#define CHECK(cond, ...)                                \
+    do                                                  \
+    {                                                   \
+        if (!(cond))                                    \
+        {                                               \
+            fprintf(stderr, "FAILED: " __VA_ARGS__);    \
+            fprintf(stderr, "\n");                      \
+            failures++;                                 \
+        }                                               \
+    } while (0)
+
+#endif //HOSTTEST_H
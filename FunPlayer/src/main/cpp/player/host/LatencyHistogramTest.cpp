@@ -0,0 +1,105 @@
+/**
+ * 耗时直方图检查程序
+ * 检查每个桶的上下界是否连续、单调，以及亚毫秒级耗时的百分位数是否落在正确的桶里
+ * 流水线中解复用、重采样、上传等阶段通常不到1毫秒，百分位数必须能区分到微秒级
+ *
+ * 用法: latency_histogram_test
+ */
+#include <cstdio>
+#include <common/LatencyHistogram.h>
+#include "HostTest.h"
+
+/**
+ * 桶的上界单调递增，上界前一微秒落在本桶，上界本身落在下一个桶
+ */
+static void checkBuckets()
+{
+    int64_t lower = 0;
+    for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS - 1; ++i)
+    {
+        int64_t limit = LatencyHistogram::getBucketLimit(i);
+        CHECK(limit > lower, "bucket %d limit %lld not above %lld", i, (long long) limit,
+              (long long) lower);
+        CHECK(LatencyHistogram::getBucket(lower) == i, "%lld us in bucket %d, expected %d",
+              (long long) lower, LatencyHistogram::getBucket(lower), i);
+        CHECK(LatencyHistogram::getBucket(limit - 1) == i, "%lld us in bucket %d, expected %d",
+              (long long) (limit - 1), LatencyHistogram::getBucket(limit - 1), i);
+        // 相对误差不超过子桶的宽度
+        CHECK(i < LATENCY_HISTOGRAM_SUB_BUCKETS
+              || (limit - lower) * LATENCY_HISTOGRAM_SUB_BUCKETS <= lower,
+              "bucket %d [%lld, %lld) too wide", i, (long long) lower, (long long) limit);
+        lower = limit;
+    }
+    CHECK(LatencyHistogram::getBucket(lower) == LATENCY_HISTOGRAM_BUCKETS - 1,
+          "%lld us not in the last bucket", (long long) lower);
+    CHECK(LatencyHistogram::getBucket(INT64_MAX) == LATENCY_HISTOGRAM_BUCKETS - 1,
+          "INT64_MAX not in the last bucket");
+    printf("buckets:      %d, last bound %.2f s\n", LATENCY_HISTOGRAM_BUCKETS,
+           lower / 1000000.0);
+}
+
+/**
+ * 记录亚毫秒级的耗时，百分位数返回的上界与真实值的差距不超过一个子桶
+ */
+static void checkSubMillisecond()
+{
+    LatencyHistogram histogram;
+    // 90%为120微秒，9%为300微秒，1%为800微秒
+    for (int i = 0; i < 1000; ++i)
+    {
+        histogram.add(i < 900 ? 120 : i < 990 ? 300 : 800);
+    }
+    int64_t p50 = histogram.getPercentile(50);
+    int64_t p95 = histogram.getPercentile(95);
+    int64_t p99 = histogram.getPercentile(99);
+    int64_t p100 = histogram.getPercentile(100);
+    printf("sub-ms:       p50 < %lld us, p95 < %lld us, p99 < %lld us, p100 < %lld us\n",
+           (long long) p50, (long long) p95, (long long) p99, (long long) p100);
+    CHECK(p50 > 120 && p50 <= 120 + 120 / LATENCY_HISTOGRAM_SUB_BUCKETS, "p50 %lld",
+          (long long) p50);
+    CHECK(p95 > 300 && p95 <= 300 + 300 / LATENCY_HISTOGRAM_SUB_BUCKETS, "p95 %lld",
+          (long long) p95);
+    CHECK(p99 > 300 && p99 <= 300 + 300 / LATENCY_HISTOGRAM_SUB_BUCKETS, "p99 %lld",
+          (long long) p99);
+    CHECK(p100 > 800 && p100 <= 800 + 800 / LATENCY_HISTOGRAM_SUB_BUCKETS, "p100 %lld",
+          (long long) p100);
+    CHECK(histogram.getTotal() == 1000, "total %lld", (long long) histogram.getTotal());
+    CHECK(histogram.getSum() == 900 * 120 + 90 * 300 + 10 * 800, "sum %lld",
+          (long long) histogram.getSum());
+    CHECK(histogram.getMax() == 800, "max %lld", (long long) histogram.getMax());
+
+    // 几微秒的耗时各自落在单独的桶里
+    LatencyHistogram tiny;
+    tiny.add(-5);
+    tiny.add(0);
+    tiny.add(1);
+    tiny.add(3);
+    CHECK(tiny.getCount(0) == 2, "bucket 0 count %lld", (long long) tiny.getCount(0));
+    CHECK(tiny.getPercentile(50) == 1, "tiny p50 %lld", (long long) tiny.getPercentile(50));
+    CHECK(tiny.getPercentile(100) == 4, "tiny p100 %lld", (long long) tiny.getPercentile(100));
+}
+
+/**
+ * 超过最后一个有上界的桶时，百分位数返回最大值
+ */
+static void checkOverflow()
+{
+    LatencyHistogram histogram;
+    histogram.add(100LL * 1000000);
+    CHECK(histogram.getCount(LATENCY_HISTOGRAM_BUCKETS - 1) == 1, "overflow bucket empty");
+    CHECK(histogram.getPercentile(50) == 100LL * 1000000, "overflow p50 %lld",
+          (long long) histogram.getPercentile(50));
+    histogram.reset();
+    CHECK(histogram.getTotal() == 0 && histogram.getMax() == 0, "reset");
+    CHECK(histogram.getPercentile(99) == 0, "empty p99 %lld",
+          (long long) histogram.getPercentile(99));
+}
+
+int main()
+{
+    checkBuckets();
+    checkSubMillisecond();
+    checkOverflow();
+    printf("%s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,197 @@
+/**
+ * 数据包队列微基准程序
+ * 对比原来基于互斥锁 + av_malloc链表的队列和现在的单生产者单消费者节点复用队列
+ * 读包线程入队，解码线程阻塞出队，统计每个数据包的平均耗时，并检查队列统计是否归零
+ *
+ * 用法: packet_queue_bench [packets] [batch]
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <queue/PacketQueue.h>
+
+extern "C" {
+#include <libavutil/time.h>
+};
+
+/**
+ * 原来的数据包队列实现，每个数据包分配一次节点，入队出队都加锁
+ */
+class LegacyPacketQueue
+{
+public:
+    // 原来的队列节点，next不是原子变量，也没有入队序号
+    typedef struct Node
+    {
+        AVPacket pkt;
+        struct Node *next;
+        int serial;
+    } Node;
+
+    LegacyPacketQueue()
+    {
+        first_pkt = NULL;
+        last_pkt = NULL;
+        nb_packets = 0;
+        size = 0;
+        duration = 0;
+    }
+
+    int pushPacket(AVPacket *pkt)
+    {
+        mMutex.lock();
+        Node *pkt1 = (Node *) av_malloc(sizeof(Node));
+        if (!pkt1)
+        {
+            mMutex.unlock();
+            av_packet_unref(pkt);
+            return -1;
+        }
+        pkt1->pkt = *pkt;
+        pkt1->next = NULL;
+        pkt1->serial = 0;
+        if (!last_pkt)
+        {
+            first_pkt = pkt1;
+        }
+        else
+        {
+            last_pkt->next = pkt1;
+        }
+        last_pkt = pkt1;
+        nb_packets++;
+        size += pkt1->pkt.size + sizeof(*pkt1);
+        duration += pkt1->pkt.duration;
+        mCondition.signal();
+        mMutex.unlock();
+        return 0;
+    }
+
+    int getPacket(AVPacket *pkt)
+    {
+        mMutex.lock();
+        while (!first_pkt)
+        {
+            mCondition.wait(mMutex);
+        }
+        Node *pkt1 = first_pkt;
+        first_pkt = pkt1->next;
+        if (!first_pkt)
+        {
+            last_pkt = NULL;
+        }
+        nb_packets--;
+        size -= pkt1->pkt.size + sizeof(*pkt1);
+        duration -= pkt1->pkt.duration;
+        *pkt = pkt1->pkt;
+        av_free(pkt1);
+        mMutex.unlock();
+        return 1;
+    }
+
+    int getPacketSize()
+    {
+        Mutex::Autolock lock(mMutex);
+        return nb_packets;
+    }
+
+    int getSize()
+    {
+        Mutex::Autolock lock(mMutex);
+        return size;
+    }
+
+    int64_t getDuration()
+    {
+        Mutex::Autolock lock(mMutex);
+        return duration;
+    }
+
+private:
+    Mutex mMutex;
+    Condition mCondition;
+    Node *first_pkt, *last_pkt;
+    int nb_packets;
+    int size;
+    int64_t duration;
+};
+
+/**
+ * 所有数据包出队之后，队列的包数、字节数和时长都必须归零
+ * @param name
+ * @param queue
+ * @return 0表示统计归零
+ */
+template<class Queue>
+static int checkEmpty(const char *name, Queue *queue)
+{
+    if (queue->getPacketSize() != 0 || queue->getSize() != 0 || queue->getDuration() != 0)
+    {
+        fprintf(stderr, "FAILED: %s remains %d packets %d bytes %lld duration\n", name,
+                queue->getPacketSize(), queue->getSize(), (long long) queue->getDuration());
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * 入队一批数据包后让出时间片，模拟读包线程的节奏
+ */
+template<class Queue>
+static double runBench(Queue *queue, int packets, int batch)
+{
+    int64_t start = av_gettime_relative();
+    std::thread consumer([queue, packets]()
+                         {
+                             AVPacket pkt;
+                             for (int i = 0; i < packets; ++i)
+                             {
+                                 queue->getPacket(&pkt);
+                                 av_packet_unref(&pkt);
+                             }
+                         });
+    for (int i = 0; i < packets; ++i)
+    {
+        AVPacket pkt;
+        av_init_packet(&pkt);
+        pkt.data = NULL;
+        pkt.size = 1024 + (i % 64) * 16;
+        pkt.duration = 1;
+        queue->pushPacket(&pkt);
+        if (batch > 0 && (i + 1) % batch == 0)
+        {
+            std::this_thread::yield();
+        }
+    }
+    consumer.join();
+    return (av_gettime_relative() - start) * 1000.0 / packets;
+}
+
+int main(int argc, char **argv)
+{
+    int packets = argc > 1 ? atoi(argv[1]) : 1000000;
+    int batch = argc > 2 ? atoi(argv[2]) : 32;
+    if (packets <= 0)
+    {
+        fprintf(stderr, "usage: %s [packets] [batch]\n", argv[0]);
+        return 1;
+    }
+
+    LegacyPacketQueue *legacyQueue = new LegacyPacketQueue();
+    double legacyTime = runBench(legacyQueue, packets, batch);
+    printf("legacy queue:  %8.1f ns/packet, remain %d packets %d bytes\n",
+           legacyTime, legacyQueue->getPacketSize(), legacyQueue->getSize());
+    int failures = checkEmpty("legacy queue", legacyQueue);
+    delete legacyQueue;
+
+    PacketQueue *packetQueue = new PacketQueue();
+    double pooledTime = runBench(packetQueue, packets, batch);
+    printf("pooled queue:  %8.1f ns/packet, remain %d packets %d bytes %lld duration, %d nodes\n",
+           pooledTime, packetQueue->getPacketSize(), packetQueue->getSize(),
+           (long long) packetQueue->getDuration(), packetQueue->getNodeCount());
+    failures += checkEmpty("pooled queue", packetQueue);
+    delete packetQueue;
+
+    printf("speedup:       %.2fx\n", pooledTime > 0 ? legacyTime / pooledTime : 0);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,218 @@
+/**
+ * 像素格式转换内核的一致性检查以及吞吐量基准程序
+ * 先检查各指令集的实现与标量参考实现的输出逐字节一致，再统计每个内核处理1080p一帧数据的吞吐量
+ * 只依赖内核源文件，不需要FFmpeg
+ *
+ * 用法: pixel_kernel_bench [iterations]
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <vector>
+#include <convertor/PixelKernels.h>
+
+#define BENCH_WIDTH 1920
+#define BENCH_HEIGHT 1080
+
+static const uint32_t extensions[] = {
+        PIXEL_SUPPORT_SSE2,
+        PIXEL_SUPPORT_AVX2
+};
+
+static void fillRandom(uint8_t *data, int size)
+{
+    for (int i = 0; i < size; ++i)
+    {
+        data[i] = (uint8_t) (rand() & 0xFF);
+    }
+}
+
+static int compare(const char *kernel, const char *name, const uint8_t *expected,
+                   const uint8_t *actual, int size, int width)
+{
+    if (memcmp(expected, actual, (size_t) size) != 0)
+    {
+        for (int i = 0; i < size; ++i)
+        {
+            if (expected[i] != actual[i])
+            {
+                fprintf(stderr, "%s/%s mismatch at width %d byte %d: expected %d got %d\n",
+                        name, kernel, width, i, expected[i], actual[i]);
+                break;
+            }
+        }
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * 检查一组内核与标量实现是否一致，覆盖各种宽度的尾部处理以及全部的输入取值
+ * @param ref
+ * @param kernels
+ * @return 不一致的次数
+ */
+static int checkKernels(const PixelKernels *ref, const PixelKernels *kernels)
+{
+    int failures = 0;
+    const int maxWidth = 4 * 256;
+    std::vector<uint8_t> src0(maxWidth * 4), src1(maxWidth * 4);
+    std::vector<uint16_t> src16(maxWidth);
+    std::vector<uint8_t> expected0(maxWidth * 4), expected1(maxWidth * 4);
+    std::vector<uint8_t> actual0(maxWidth * 4), actual1(maxWidth * 4);
+
+    // 不同的宽度，覆盖向量主循环以及尾部
+    for (int width = 1; width <= 300; ++width)
+    {
+        fillRandom(src0.data(), maxWidth * 4);
+        fillRandom(src1.data(), maxWidth * 4);
+        for (int i = 0; i < width; ++i)
+        {
+            src16[i] = (uint16_t) ((src0[2 * i] << 8) | src1[2 * i]);
+        }
+
+        ref->deinterleaveUV(src0.data(), expected0.data(), expected1.data(), width);
+        kernels->deinterleaveUV(src0.data(), actual0.data(), actual1.data(), width);
+        failures += compare(kernels->name, "deinterleaveUV", expected0.data(), actual0.data(),
+                            width, width);
+        failures += compare(kernels->name, "deinterleaveUV", expected1.data(), actual1.data(),
+                            width, width);
+
+        for (int shift = 1; shift <= 15; ++shift)
+        {
+            ref->narrow16(src16.data(), expected0.data(), width, shift);
+            kernels->narrow16(src16.data(), actual0.data(), width, shift);
+            failures += compare(kernels->name, "narrow16", expected0.data(), actual0.data(),
+                                width, width);
+        }
+
+        ref->averageRows(src0.data(), src1.data(), expected0.data(), width);
+        kernels->averageRows(src0.data(), src1.data(), actual0.data(), width);
+        failures += compare(kernels->name, "averageRows", expected0.data(), actual0.data(),
+                            width, width);
+    }
+
+    // 16位的全部取值
+    std::vector<uint16_t> all16(65536);
+    std::vector<uint8_t> expected16(65536), actual16(65536);
+    for (int i = 0; i < 65536; ++i)
+    {
+        all16[i] = (uint16_t) i;
+    }
+    for (int shift = 1; shift <= 15; ++shift)
+    {
+        ref->narrow16(all16.data(), expected16.data(), 65536, shift);
+        kernels->narrow16(all16.data(), actual16.data(), 65536, shift);
+        failures += compare(kernels->name, "narrow16", expected16.data(), actual16.data(),
+                            65536, 65536);
+    }
+
+    return failures;
+}
+
+template<typename Func>
+static double measure(int iterations, Func func)
+{
+    func();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+    {
+        func();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / iterations;
+}
+
+/**
+ * 按照1080p一帧的数据量统计每个内核的耗时，吞吐量以输入数据计算
+ * @param kernels
+ * @param iterations
+ */
+static void benchKernels(const PixelKernels *kernels, int iterations)
+{
+    const int width = BENCH_WIDTH;
+    const int height = BENCH_HEIGHT;
+    const int chromaWidth = width / 2;
+    const int chromaHeight = height / 2;
+    std::vector<uint8_t> luma(width * height), chroma(width * chromaHeight);
+    std::vector<uint8_t> planeU(chromaWidth * height), planeV(chromaWidth * height);
+    std::vector<uint16_t> luma16(width * height);
+    fillRandom(luma.data(), width * height);
+    fillRandom(chroma.data(), width * chromaHeight);
+    fillRandom(planeU.data(), chromaWidth * height);
+    fillRandom(planeV.data(), chromaWidth * height);
+    for (int i = 0; i < width * height; ++i)
+    {
+        luma16[i] = (uint16_t) (luma[i] << 8);
+    }
+
+    double seconds = measure(iterations, [&]()
+    {
+        for (int row = 0; row < chromaHeight; ++row)
+        {
+            kernels->deinterleaveUV(chroma.data() + row * width, planeU.data() + row * chromaWidth,
+                                    planeV.data() + row * chromaWidth, chromaWidth);
+        }
+    });
+    printf("%-6s deinterleaveUV  %8.3f ms/frame %8.1f MB/s\n", kernels->name, seconds * 1000,
+           width * chromaHeight / seconds / 1e6);
+
+    seconds = measure(iterations, [&]()
+    {
+        for (int row = 0; row < height; ++row)
+        {
+            kernels->narrow16(luma16.data() + row * width, luma.data() + row * width, width, 8);
+        }
+    });
+    printf("%-6s narrow16        %8.3f ms/frame %8.1f MB/s\n", kernels->name, seconds * 1000,
+           width * height * 2 / seconds / 1e6);
+
+    seconds = measure(iterations, [&]()
+    {
+        for (int row = 0; row < chromaHeight; ++row)
+        {
+            kernels->averageRows(planeU.data() + 2 * row * chromaWidth,
+                                 planeU.data() + (2 * row + 1) * chromaWidth,
+                                 chroma.data() + row * chromaWidth, chromaWidth);
+        }
+    });
+    printf("%-6s averageRows     %8.3f ms/frame %8.1f MB/s\n", kernels->name, seconds * 1000,
+           chromaWidth * height / seconds / 1e6);
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 100;
+    if (iterations <= 0)
+    {
+        fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    const PixelKernels *ref = getPixelKernels(0);
+    printf("dispatch: %s\n", getPixelKernels()->name);
+
+    int failures = 0;
+    std::vector<const PixelKernels *> available;
+    available.push_back(ref);
+    for (size_t i = 0; i < sizeof(extensions) / sizeof(extensions[0]); ++i)
+    {
+        const PixelKernels *kernels = getPixelKernels(extensions[i]);
+        if (kernels == NULL)
+        {
+            continue;
+        }
+        int ret = checkKernels(ref, kernels);
+        printf("%-6s bit-exact check: %s\n", kernels->name, ret == 0 ? "ok" : "FAILED");
+        failures += ret;
+        available.push_back(kernels);
+    }
+
+    for (size_t i = 0; i < available.size(); ++i)
+    {
+        benchKernels(available[i], iterations);
+    }
+
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,394 @@
+/**
+ * 桌面端无头播放基准程序
+ * 使用空音视频输出设备播放文件，统计起播时延、解码帧率、丢帧数以及音视频同步偏差
+ *
+ * 用法: player_bench <url> [-t seconds] [-an] [-vn] [-sync audio|video|ext] [-faststart]
+ *                     [-trace file] [-scrub count] [-accurate] [-indexscan] [-serialdecode]
+ *                     [-seekabort count]
+ * -faststart 开启快速起播，用于对比起播各阶段的耗时
+ * -serialdecode 音视频解码共用一把锁，复现原来的全局解码锁，与默认的并行解码对比等锁时长和解码耗时
+ * -accurate 开启精确定位，统计每次定位从关键帧追赶到目标位置的耗时和帧数
+ * -indexscan 没有索引的格式(例如mpegts)在后台扫描补全关键帧索引
+ * -scrub 开始播放之后模拟拖动进度条，每隔30毫秒更新一次拖动位置，共count次，松开时精确定位，
+ *        统计定位到送显的耗时
+ * -seekabort 第一帧送显之后每隔1毫秒连续定位count次，最后一次定位到90%的位置，后面的请求会中断还在执行的定位，
+ *            之后必须能正常播放到结尾，否则返回失败，网络流或者没有索引的格式定位较慢，更容易触发中断
+ * -trace 把播放过程的事件跟踪导出成 Chrome trace event 格式的JSON文件
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+#include <player/MediaPlayerEx.h>
+
+// 模拟拖动进度条时两次定位的间隔(微秒)
+#define SCRUB_INTERVAL (30 * 1000)
+
+// 连续定位时两次定位的间隔(微秒)，短于定位本身的耗时，新的请求会中断正在执行的定位
+#define SEEK_ABORT_INTERVAL 1000
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s <url> [-t seconds] [-an] [-vn] [-sync audio|video|ext] "
+                    "[-faststart] [-trace file] [-scrub count] [-accurate] "
+                    "[-indexscan] [-serialdecode] [-seekabort count]\n", name);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    const char *url = argv[1];
+    double limit = 0;
+    const char *tracePath = NULL;
+    int scrubCount = 0;
+    int seekAbortCount = 0;
+    MediaPlayerEx *mediaPlayer = new MediaPlayerEx();
+    NullVideoDevice *videoDevice = new NullVideoDevice();
+    PlayerState *playerState = mediaPlayer->getPlayerState();
+
+    for (int i = 2; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "-t") && i + 1 < argc)
+        {
+            limit = atof(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "-an"))
+        {
+            playerState->setOptionLong(OPT_CATEGORY_PLAYER, "an", 1);
+        }
+        else if (!strcmp(argv[i], "-vn"))
+        {
+            playerState->setOptionLong(OPT_CATEGORY_PLAYER, "vn", 1);
+        }
+        else if (!strcmp(argv[i], "-sync") && i + 1 < argc)
+        {
+            playerState->setOption(OPT_CATEGORY_PLAYER, "sync", argv[++i]);
+        }
+        else if (!strcmp(argv[i], "-faststart"))
+        {
+            playerState->setOptionLong(OPT_CATEGORY_PLAYER, "faststart", 1);
+        }
+        else if (!strcmp(argv[i], "-accurate"))
+        {
+            playerState->setOptionLong(OPT_CATEGORY_PLAYER, "accurateseek", 1);
+        }
+        else if (!strcmp(argv[i], "-serialdecode"))
+        {
+            playerState->setOptionLong(OPT_CATEGORY_PLAYER, "serialdecode", 1);
+        }
+        else if (!strcmp(argv[i], "-indexscan"))
+        {
+            playerState->setOptionLong(OPT_CATEGORY_PLAYER, "indexscan", 1);
+        }
+        else if (!strcmp(argv[i], "-scrub") && i + 1 < argc)
+        {
+            scrubCount = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "-seekabort") && i + 1 < argc)
+        {
+            seekAbortCount = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "-trace") && i + 1 < argc)
+        {
+            tracePath = argv[++i];
+            playerState->setOptionLong(OPT_CATEGORY_PLAYER, "trace", TRACE_DEFAULT_CAPACITY);
+        }
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    playerState->setOptionLong(OPT_CATEGORY_PLAYER, "autoexit", 1);
+    mediaPlayer->setLooping(0);
+    mediaPlayer->setDataSource(url);
+    mediaPlayer->setVideoDevice(videoDevice);
+
+    int64_t prepareTime = av_gettime_relative();
+    int64_t preparedTime = AV_NOPTS_VALUE;
+    int64_t startTime = AV_NOPTS_VALUE;
+    int64_t endTime = AV_NOPTS_VALUE;
+    int64_t levelCount = 0;
+    int64_t levelSum = 0;
+    int levelMin = INT_MAX;
+    int64_t driftCount = 0;
+    double driftSum = 0;
+    double driftMax = 0;
+    int error = 0;
+    int64_t snapshotReads = 0;
+    int64_t snapshotMaxTime = 0;
+    int scrubIndex = 0;
+    int64_t lastScrubTime = 0;
+    int seekAbortDone = 0;
+
+    if (mediaPlayer->prepare() != NO_ERROR)
+    {
+        fprintf(stderr, "failed to prepare %s\n", url);
+        return 1;
+    }
+
+    AVMessageQueue *messageQueue = mediaPlayer->getMessageQueue();
+    int64_t messageCount = 0;
+    while (endTime == AV_NOPTS_VALUE)
+    {
+        AVMessage msg;
+        int ret = messageQueue->getMessage(&msg, 0);
+        if (ret < 0)
+        {
+            // 消息队列在读包线程退出时停止
+            endTime = av_gettime_relative();
+            break;
+        }
+        if (ret == 0)
+        {
+            // 读取播放状态快照的耗时，准备阶段也不应该被阻塞
+            PlaybackSnapshot snapshot;
+            int64_t readStart = av_gettime_relative();
+            mediaPlayer->getPlaybackSnapshot(&snapshot);
+            snapshotMaxTime = FFMAX(snapshotMaxTime, av_gettime_relative() - readStart);
+            snapshotReads++;
+            // 第一帧送显之后从10%拖动到90%的位置，不等待上一次定位完成
+            if (scrubIndex < scrubCount && snapshot.duration > 0
+                && videoDevice->getRenderedFrames() > 0
+                && av_gettime_relative() - lastScrubTime >= SCRUB_INTERVAL)
+            {
+                double ratio = 0.1 + 0.8 * scrubIndex / FFMAX(scrubCount - 1, 1);
+                if (scrubIndex == 0)
+                {
+                    mediaPlayer->beginScrub();
+                }
+                mediaPlayer->updateScrub((float) (snapshot.duration * ratio));
+                lastScrubTime = av_gettime_relative();
+                scrubIndex++;
+                if (scrubIndex == scrubCount)
+                {
+                    mediaPlayer->endScrub();
+                }
+            }
+            // 第一帧送显之后连续定位，每次请求都不等待上一次完成，最后停在90%的位置播放到结尾
+            if (seekAbortCount > 0 && !seekAbortDone && snapshot.duration > 0
+                && videoDevice->getRenderedFrames() > 0)
+            {
+                for (int i = 0; i < seekAbortCount; ++i)
+                {
+                    double ratio = i == seekAbortCount - 1
+                                   ? 0.9 : 0.1 + 0.7 * i / FFMAX(seekAbortCount - 1, 1);
+                    mediaPlayer->seekTo((float) (snapshot.duration * ratio));
+                    av_usleep(SEEK_ABORT_INTERVAL);
+                }
+                seekAbortDone = 1;
+            }
+            // 没有消息时采样音视频同步偏差
+            if (startTime != AV_NOPTS_VALUE && videoDevice->getRenderedFrames() > 0)
+            {
+                double diff = mediaPlayer->getAVDiff();
+                if (!isnan(diff) && fabs(diff) < AV_NOSYNC_THRESHOLD)
+                {
+                    driftSum += fabs(diff);
+                    driftMax = FFMAX(driftMax, fabs(diff));
+                    driftCount++;
+                }
+            }
+            // 采样音频PCM缓冲时长
+            if (startTime != AV_NOPTS_VALUE && !playerState->audioDisable)
+            {
+                int level = playerState->audioBufferLevel;
+                levelSum += level;
+                levelMin = FFMIN(levelMin, level);
+                levelCount++;
+            }
+            if (limit > 0 && startTime != AV_NOPTS_VALUE
+                && av_gettime_relative() - startTime > (int64_t) (limit * 1000000))
+            {
+                endTime = av_gettime_relative();
+                break;
+            }
+            av_usleep(10 * 1000);
+            continue;
+        }
+
+        messageCount++;
+        switch (msg.what)
+        {
+            case MSG_PREPARED:
+            {
+                preparedTime = av_gettime_relative();
+                startTime = preparedTime;
+                mediaPlayer->start();
+                break;
+            }
+            case MSG_ERROR:
+            {
+                error = 1;
+                endTime = av_gettime_relative();
+                break;
+            }
+            case MSG_COMPLETED:
+            {
+                endTime = av_gettime_relative();
+                break;
+            }
+            default:
+            {
+                break;
+            }
+        }
+        message_free_resouce(&msg);
+    }
+
+    PlaybackSnapshot snapshot;
+    mediaPlayer->getPlaybackSnapshot(&snapshot);
+
+    int64_t decodedFrames = playerState->decodedFrames;
+    int64_t droppedFrames = playerState->droppedFrames;
+    int64_t firstRenderTime = videoDevice->getFirstRenderTime();
+    double playTime = (startTime != AV_NOPTS_VALUE && endTime != AV_NOPTS_VALUE)
+                      ? (endTime - startTime) / 1000000.0 : 0;
+
+    printf("url:              %s\n", url);
+    if (preparedTime != AV_NOPTS_VALUE)
+    {
+        printf("prepare latency:  %.2f ms\n", (preparedTime - prepareTime) / 1000.0);
+    }
+    if (firstRenderTime != AV_NOPTS_VALUE)
+    {
+        printf("first frame:      %.2f ms\n", (firstRenderTime - prepareTime) / 1000.0);
+    }
+    printf("play time:        %.2f s\n", playTime);
+    printf("playback:         state %d, position %lld ms, buffered %lld ms, duration %lld ms\n",
+           snapshot.state, (long long) snapshot.position, (long long) snapshot.bufferedPosition,
+           (long long) snapshot.duration);
+    printf("snapshot reads:   %lld, max %lld us\n", (long long) snapshotReads,
+           (long long) snapshotMaxTime);
+    printf("decoded frames:   %lld (%.2f fps)\n", (long long) decodedFrames,
+           playTime > 0 ? decodedFrames / playTime : 0);
+    printf("rendered frames:  %lld\n", (long long) videoDevice->getRenderedFrames());
+    printf("dropped frames:   %lld\n", (long long) droppedFrames);
+    printf("messages:         %lld delivered, %lld coalesced, %lld heap allocated\n",
+           (long long) messageCount, (long long) messageQueue->getCoalescedCount(),
+           (long long) messageQueue->getAllocatedCount());
+    printf("frame pacing:     %lld presented, %lld repeated, %lld skipped\n",
+           (long long) playerState->presentError.getTotal(),
+           (long long) playerState->repeatedFrames, (long long) playerState->skippedFrames);
+    printf("present error:    p50 < %.2f ms, p99 < %.2f ms, max %.2f ms\n",
+           playerState->presentError.getPercentile(50) / 1000.0,
+           playerState->presentError.getPercentile(99) / 1000.0,
+           playerState->presentError.getMax() / 1000.0);
+    printf("demux blocked:    %lld times, %.2f ms\n", (long long) playerState->readBlockedCount,
+           playerState->readBlockedTime / 1000.0);
+    printf("codec lock wait:  %.2f ms (%s decode)\n", playerState->codecLockWaitTime / 1000.0,
+           playerState->serialDecode ? "serial" : "parallel");
+    printf("audio underruns:  %lld\n", (long long) playerState->audioUnderruns);
+    printf("converted frames: %lld (%.2f ms/frame)\n", (long long) playerState->convertedFrames,
+           playerState->convertedFrames > 0
+           ? playerState->convertTime / 1000.0 / playerState->convertedFrames : 0);
+    printf("frame pool:       %lld hits, %lld misses, peak %.2f MB\n",
+           (long long) playerState->framePoolHits, (long long) playerState->framePoolMisses,
+           playerState->framePoolPeakBytes / (1024.0 * 1024.0));
+    printf("seeks:            %lld cached, %lld demuxer, packet cache %.2f MB\n",
+           (long long) playerState->cachedSeeks, (long long) playerState->demuxerSeeks,
+           playerState->packetCacheBytes / (1024.0 * 1024.0));
+    if (levelCount > 0)
+    {
+        printf("audio buffer:     avg %.2f ms, min %d ms\n", (double) levelSum / levelCount,
+               levelMin);
+    }
+    if (driftCount > 0)
+    {
+        printf("A-V drift:        avg %.2f ms, max %.2f ms\n",
+               driftSum / driftCount * 1000, driftMax * 1000);
+    }
+
+    PlayerStats stats;
+    mediaPlayer->getStats(&stats);
+    printf("seek requests:    %lld coalesced, %lld aborted\n", (long long) stats.coalescedSeeks,
+           (long long) stats.abortedSeeks);
+    // 被中断的定位不能影响之后的读取，必须正常播放到结尾
+    if (seekAbortDone && snapshot.state != PLAYBACK_COMPLETED)
+    {
+        fprintf(stderr, "playback did not complete after %d back-to-back seeks (state %d)\n",
+                seekAbortCount, snapshot.state);
+        error = 1;
+    }
+    if (stats.seekLatency.count > 0)
+    {
+        printf("seek latency:     %lld presented, avg %.2f ms, p50 < %.0f ms, p99 < %.0f ms, "
+               "max %.2f ms\n", (long long) stats.seekLatency.count,
+               stats.seekLatency.totalTime / 1000.0 / stats.seekLatency.count,
+               stats.seekLatency.p50 / 1000.0, stats.seekLatency.p99 / 1000.0,
+               stats.seekLatency.maxTime / 1000.0);
+    }
+    if (stats.ioReadBytes > 0)
+    {
+        printf("read-ahead I/O:   %.2f MB read, %.2f MB/s, %.2f MB buffered, %lld stalls "
+               "(%.2f ms), %lld buffer seeks, %lld io seeks\n",
+               stats.ioReadBytes / (1024.0 * 1024.0),
+               stats.ioReadTime > 0
+               ? stats.ioReadBytes / (1024.0 * 1024.0) / (stats.ioReadTime / 1000000.0) : 0,
+               stats.ioBufferedBytes / (1024.0 * 1024.0), (long long) stats.ioStalls,
+               stats.ioStallTime / 1000.0, (long long) stats.ioBufferSeeks,
+               (long long) stats.ioSeeks);
+    }
+    if (stats.seekIndexEntries > 0)
+    {
+        printf("seek index:       %lld entries, %lld indexed seeks\n",
+               (long long) stats.seekIndexEntries, (long long) stats.indexSeeks);
+    }
+    if (stats.accurateSeeks > 0)
+    {
+        printf("seek catch-up:    %lld seeks, avg %.1f frames, avg %.2f ms, p99 < %.0f ms, "
+               "max %.2f ms\n", (long long) stats.accurateSeeks,
+               (double) stats.catchupFrames / stats.accurateSeeks,
+               stats.catchupTime.totalTime / 1000.0 / stats.catchupTime.count,
+               stats.catchupTime.p99 / 1000.0, stats.catchupTime.maxTime / 1000.0);
+    }
+    printf("stage             count      avg(us)   p50(us)   p99(us)   max(us)\n");
+    for (int i = 0; i < STAGE_COUNT; ++i)
+    {
+        const StageStats *stage = &stats.stages[i];
+        if (stage->count == 0)
+        {
+            continue;
+        }
+        printf("  %-15s %-10lld %-9lld <%-8lld <%-8lld %lld\n", getPipelineStageName(i),
+               (long long) stage->count, (long long) (stage->totalTime / stage->count),
+               (long long) stage->p50, (long long) stage->p99, (long long) stage->maxTime);
+    }
+    printf("startup           done(ms)   phase(ms)\n");
+    int64_t lastPhaseTime = 0;
+    for (int i = 0; i < STARTUP_PHASE_COUNT; ++i)
+    {
+        if (stats.startupTime[i] == 0)
+        {
+            printf("  %-15s -\n", getStartupPhaseName(i));
+            continue;
+        }
+        printf("  %-15s %-10.2f %.2f\n", getStartupPhaseName(i), stats.startupTime[i] / 1000.0,
+               (stats.startupTime[i] - lastPhaseTime) / 1000.0);
+        lastPhaseTime = stats.startupTime[i];
+    }
+
+    mediaPlayer->reset();
+    // 所有线程退出之后再导出，保证事件完整
+    if (tracePath != NULL)
+    {
+        int events = mediaPlayer->dumpTrace(tracePath);
+        if (events < 0)
+        {
+            fprintf(stderr, "failed to write trace to %s\n", tracePath);
+        }
+        else
+        {
+            printf("trace:            %d events written to %s\n", events, tracePath);
+        }
+    }
+    delete mediaPlayer;
+    delete videoDevice;
+
+    return error ? 1 : 0;
+}
@@ -0,0 +1,173 @@
+/**
+ * 媒体流探测结果缓存基准程序
+ * 对每个文件分别在没有缓存(冷)和已有缓存(热)的情况下多次打开，统计从prepare到准备完成的时间
+ * 每个文件先不使用缓存打开一次，让系统的文件缓存预热，冷热两种情况只差在探测结果缓存上
+ *
+ * 用法: probe_cache_bench <cache dir> <url>... [-n runs]
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <player/MediaPlayerEx.h>
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s <cache dir> <url>... [-n runs]\n", name);
+}
+
+/**
+ * 打开一次文件，返回从prepare到准备完成的时间(微秒)，失败返回负数
+ * @param url
+ * @param cacheDir      探测结果缓存目录，NULL表示不使用缓存
+ * @param probeTime     探测媒体流信息完成的时间(微秒)
+ * @return
+ */
+static int64_t openOnce(const char *url, const char *cacheDir, int64_t *probeTime)
+{
+    MediaPlayerEx *mediaPlayer = new MediaPlayerEx();
+    NullVideoDevice *videoDevice = new NullVideoDevice();
+    PlayerState *playerState = mediaPlayer->getPlayerState();
+    if (cacheDir != NULL)
+    {
+        playerState->setOption(OPT_CATEGORY_PLAYER, "probecache", cacheDir);
+    }
+    mediaPlayer->setLooping(0);
+    mediaPlayer->setDataSource(url);
+    mediaPlayer->setVideoDevice(videoDevice);
+
+    int64_t prepareTime = av_gettime_relative();
+    int64_t result = -1;
+    if (mediaPlayer->prepare() == NO_ERROR)
+    {
+        AVMessageQueue *messageQueue = mediaPlayer->getMessageQueue();
+        bool done = false;
+        while (!done)
+        {
+            AVMessage msg;
+            if (messageQueue->getMessage(&msg) < 0)
+            {
+                break;
+            }
+            if (msg.what == MSG_PREPARED)
+            {
+                result = av_gettime_relative() - prepareTime;
+                done = true;
+            }
+            else if (msg.what == MSG_ERROR)
+            {
+                done = true;
+            }
+            message_free_resouce(&msg);
+        }
+    }
+
+    PlayerStats stats;
+    mediaPlayer->getStats(&stats);
+    *probeTime = stats.startupTime[STARTUP_PROBE];
+
+    mediaPlayer->reset();
+    delete mediaPlayer;
+    delete videoDevice;
+    return result;
+}
+
+/**
+ * 删除文件对应的缓存，下一次打开就是冷启动
+ * @param cacheDir
+ * @param url
+ */
+static void removeCache(const char *cacheDir, const char *url)
+{
+    ProbeCache probeCache(cacheDir, url);
+    probeCache.remove();
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    const char *cacheDir = argv[1];
+    int runs = 5;
+    std::vector<const char *> urls;
+    for (int i = 2; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc)
+        {
+            runs = atoi(argv[++i]);
+        }
+        else
+        {
+            urls.push_back(argv[i]);
+        }
+    }
+    if (urls.empty() || runs <= 0)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    int64_t coldTotal = 0;
+    int64_t warmTotal = 0;
+    int64_t count = 0;
+    int failed = 0;
+
+    printf("%-40s %-12s %-12s %-12s %-12s\n", "url", "cold(ms)", "warm(ms)", "cold probe",
+           "warm probe");
+    for (size_t i = 0; i < urls.size(); ++i)
+    {
+        const char *url = urls[i];
+        int64_t probeTime;
+        if (openOnce(url, NULL, &probeTime) < 0)
+        {
+            fprintf(stderr, "failed to open %s\n", url);
+            failed = 1;
+            continue;
+        }
+
+        int64_t coldSum = 0, warmSum = 0, coldProbeSum = 0, warmProbeSum = 0;
+        int valid = 1;
+        for (int run = 0; run < runs && valid; ++run)
+        {
+            int64_t coldProbe, warmProbe;
+            removeCache(cacheDir, url);
+            int64_t cold = openOnce(url, cacheDir, &coldProbe);
+            int64_t warm = openOnce(url, cacheDir, &warmProbe);
+            if (cold < 0 || warm < 0)
+            {
+                valid = 0;
+                break;
+            }
+            coldSum += cold;
+            warmSum += warm;
+            coldProbeSum += coldProbe;
+            warmProbeSum += warmProbe;
+        }
+        if (!valid)
+        {
+            fprintf(stderr, "failed to open %s\n", url);
+            failed = 1;
+            continue;
+        }
+
+        const char *name = strrchr(url, '/') ? strrchr(url, '/') + 1 : url;
+        printf("%-40.40s %-12.2f %-12.2f %-12.2f %-12.2f\n", name,
+               coldSum / 1000.0 / runs, warmSum / 1000.0 / runs,
+               coldProbeSum / 1000.0 / runs, warmProbeSum / 1000.0 / runs);
+        coldTotal += coldSum;
+        warmTotal += warmSum;
+        count += runs;
+    }
+
+    if (count > 0)
+    {
+        printf("average: cold %.2f ms, warm %.2f ms, saved %.1f%%\n",
+               coldTotal / 1000.0 / count, warmTotal / 1000.0 / count,
+               coldTotal > 0 ? (coldTotal - warmTotal) * 100.0 / coldTotal : 0);
+    }
+    return failed ? 1 : 0;
+}
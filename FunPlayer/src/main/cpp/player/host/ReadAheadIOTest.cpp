@@ -0,0 +1,422 @@
+/**
+ * 预读I/O层检查程序
+ * 生成一个内容由文件偏移决定的临时文件，通过file:协议打开，
+ * 经由解复用器使用的AVIOContext读取并逐字节校验，
+ * 检查环形缓冲区回绕时的拷贝、缓冲区内定位与底层定位、读取过程中定位时丢弃旧数据、
+ * 小容量缓冲区中读位置越过预读位置、以及结尾和出错的传递
+ *
+ * 用法: read_ahead_io_test [temp dir]
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <common/ReadAheadIO.h>
+#include "HostTest.h"
+
+extern "C" {
+#include <libavutil/time.h>
+};
+
+// 临时文件大小，不是块大小的整数倍，最后一次读取不满一块
+#define FIXTURE_SIZE (4 * 1024 * 1024 + 12345)
+
+// 每项检查以及等待I/O线程的超时(微秒)
+#define WAIT_TIMEOUT (5 * 1000000LL)
+
+// 每项检查的截止时间，解复用器等待数据超过这个时间时中断读取，检查失败而不是卡住
+static int64_t deadline = 0;
+
+static int interruptCallback(void *opaque)
+{
+    return av_gettime_relative() > deadline;
+}
+
+static const AVIOInterruptCB interrupt = {interruptCallback, NULL};
+
+/**
+ * 文件偏移处的字节，相邻偏移以及相差块大小的偏移内容都不同
+ * @param pos
+ * @return
+ */
+static uint8_t patternAt(int64_t pos)
+{
+    return (uint8_t) (((uint64_t) pos * 2654435761U) >> 13);
+}
+
+/**
+ * 可以暂停读取、在指定位置模拟出错的预读I/O层
+ */
+class TestReadAheadIO : public ReadAheadIO
+{
+public:
+    TestReadAheadIO(int bufferSize) : ReadAheadIO(bufferSize)
+    {
+        position = 0;
+        holdReads = 0;
+        holding = 0;
+        failPos = -1;
+    }
+
+    virtual ~TestReadAheadIO()
+    {
+        // I/O线程调用子类的读取，必须在子类析构之前停止
+        close();
+    }
+
+    // 之后的底层读取在读出数据之后暂停，直到release
+    void hold()
+    {
+        Mutex::Autolock lock(mMutex);
+        holdReads = 1;
+    }
+
+    // 等待I/O线程暂停在一次读取中
+    bool waitHolding()
+    {
+        Mutex::Autolock lock(mMutex);
+        int64_t start = av_gettime_relative();
+        while (!holding && av_gettime_relative() - start < WAIT_TIMEOUT)
+        {
+            mCondition.waitRelative(mMutex, 10 * 1000000LL);
+        }
+        return holding != 0;
+    }
+
+    void release()
+    {
+        Mutex::Autolock lock(mMutex);
+        holdReads = 0;
+        mCondition.broadcast();
+    }
+
+    // 底层读到pos时返回EIO，-1表示不出错
+    void failAt(int64_t pos)
+    {
+        Mutex::Autolock lock(mMutex);
+        failPos = pos;
+    }
+
+protected:
+    int readSource(uint8_t *buf, int size) override
+    {
+        int64_t fail;
+        {
+            Mutex::Autolock lock(mMutex);
+            fail = failPos;
+        }
+        if (fail >= 0 && position + size > fail)
+        {
+            if (position >= fail)
+            {
+                return AVERROR(EIO);
+            }
+            size = (int) (fail - position);
+        }
+        int ret = ReadAheadIO::readSource(buf, size);
+
+        Mutex::Autolock lock(mMutex);
+        if (holdReads)
+        {
+            holding = 1;
+            mCondition.broadcast();
+            while (holdReads)
+            {
+                mCondition.wait(mMutex);
+            }
+            holding = 0;
+        }
+        if (ret > 0)
+        {
+            position += ret;
+        }
+        return ret;
+    }
+
+    int64_t seekSource(int64_t pos) override
+    {
+        int64_t ret = ReadAheadIO::seekSource(pos);
+        if (ret >= 0)
+        {
+            position = ret;
+        }
+        return ret;
+    }
+
+private:
+    Mutex mMutex;
+    Condition mCondition;
+    int64_t position;       // 底层的读位置，只在I/O线程中使用
+    int holdReads;
+    int holding;
+    int64_t failPos;
+};
+
+/**
+ * 从当前位置读取size字节并校验内容
+ * @param pb
+ * @param pos   当前位置
+ * @param size
+ * @return 读出并且校验通过的字节数，读不到数据时返回avio_read的结果
+ */
+static int readAndCheck(AVIOContext *pb, int64_t pos, int size)
+{
+    uint8_t *buf = (uint8_t *) malloc((size_t) size);
+    int total = 0;
+    int ret = 0;
+    while (total < size)
+    {
+        ret = avio_read(pb, buf + total, size - total);
+        if (ret <= 0)
+        {
+            break;
+        }
+        total += ret;
+    }
+    for (int i = 0; i < total; ++i)
+    {
+        if (buf[i] != patternAt(pos + i))
+        {
+            CHECK(false, "byte at %lld is %d, expected %d", (long long) (pos + i), buf[i],
+                  patternAt(pos + i));
+            total = i;
+            break;
+        }
+    }
+    free(buf);
+    return total > 0 ? total : ret;
+}
+
+/**
+ * 轮询统计直到预读的数据量达到bytes
+ * @param io
+ * @param bytes
+ * @return
+ */
+static bool waitBuffered(ReadAheadIO *io, int64_t bytes)
+{
+    int64_t start = av_gettime_relative();
+    ReadAheadStats stats;
+    io->getStats(&stats);
+    while (stats.bufferedBytes < bytes && av_gettime_relative() - start < WAIT_TIMEOUT)
+    {
+        av_usleep(1000);
+        io->getStats(&stats);
+    }
+    return stats.bufferedBytes >= bytes;
+}
+
+/**
+ * 最小容量的缓冲区顺序读完整个文件，读取大小与块大小互质，每次回绕都跨过缓冲区末尾分两段拷贝
+ * @param url
+ */
+static void checkSequential(const char *url)
+{
+    deadline = av_gettime_relative() + WAIT_TIMEOUT;
+    TestReadAheadIO io(READ_AHEAD_CHUNK_SIZE);
+    CHECK(io.open(url, &interrupt, NULL) == 0, "open %s", url);
+    AVIOContext *pb = io.getContext();
+    if (!pb)
+    {
+        return;
+    }
+    CHECK(avio_size(pb) == FIXTURE_SIZE, "size %lld", (long long) avio_size(pb));
+
+    int64_t pos = 0;
+    int ret;
+    while ((ret = readAndCheck(pb, pos, 10007)) > 0)
+    {
+        pos += ret;
+    }
+    CHECK(pos == FIXTURE_SIZE, "sequential read stopped at %lld", (long long) pos);
+    CHECK(ret == AVERROR_EOF, "read at end returned %d", ret);
+
+    ReadAheadStats stats;
+    io.getStats(&stats);
+    printf("sequential:   %lld bytes through %d KB ring, %lld stalls\n",
+           (long long) stats.readBytes, 2 * READ_AHEAD_CHUNK_SIZE / 1024,
+           (long long) stats.stalls);
+    CHECK(stats.readBytes == FIXTURE_SIZE, "read bytes %lld", (long long) stats.readBytes);
+    CHECK(stats.bufferSeeks == 0 && stats.ioSeeks == 0, "seeks %lld/%lld",
+          (long long) stats.bufferSeeks, (long long) stats.ioSeeks);
+    io.close();
+}
+
+/**
+ * 向回定位到保留的数据内只移动读位置，远超预读位置的定位交给底层
+ * @param url
+ */
+static void checkSeek(const char *url)
+{
+    deadline = av_gettime_relative() + WAIT_TIMEOUT;
+    TestReadAheadIO io(2 * 1024 * 1024);
+    CHECK(io.open(url, &interrupt, NULL) == 0, "open %s", url);
+    AVIOContext *pb = io.getContext();
+    if (!pb)
+    {
+        return;
+    }
+    CHECK(readAndCheck(pb, 0, 300 * 1024) == 300 * 1024, "read head");
+
+    // 缓冲区2MB时保留读位置之前256KB，100KB必定还在缓冲区内
+    ReadAheadStats stats;
+    CHECK(avio_seek(pb, 100 * 1024, SEEK_SET) == 100 * 1024, "seek back");
+    io.getStats(&stats);
+    CHECK(stats.bufferSeeks == 1 && stats.ioSeeks == 0, "seek back: buffer %lld, io %lld",
+          (long long) stats.bufferSeeks, (long long) stats.ioSeeks);
+    CHECK(readAndCheck(pb, 100 * 1024, 64 * 1024) == 64 * 1024, "read after seek back");
+
+    int64_t target = FIXTURE_SIZE - 512 * 1024;
+    CHECK(avio_seek(pb, target, SEEK_SET) == target, "seek forward");
+    io.getStats(&stats);
+    CHECK(stats.bufferSeeks == 1 && stats.ioSeeks == 1, "seek forward: buffer %lld, io %lld",
+          (long long) stats.bufferSeeks, (long long) stats.ioSeeks);
+    CHECK(readAndCheck(pb, target, 512 * 1024) == 512 * 1024, "read after seek forward");
+    CHECK(readAndCheck(pb, FIXTURE_SIZE, 1) == AVERROR_EOF, "no EOF after seek forward");
+    printf("seek:         %lld in buffer, %lld to protocol\n", (long long) stats.bufferSeeks,
+           (long long) stats.ioSeeks);
+    io.close();
+}
+
+/**
+ * I/O线程读取文件开头时定位到别处，读出的旧数据必须丢弃，读位置之后的内容来自新的位置
+ * @param url
+ */
+static void checkSeekDuringRead(const char *url)
+{
+    deadline = av_gettime_relative() + WAIT_TIMEOUT;
+    TestReadAheadIO io(2 * 1024 * 1024);
+    io.hold();
+    CHECK(io.open(url, &interrupt, NULL) == 0, "open %s", url);
+    AVIOContext *pb = io.getContext();
+    if (!pb)
+    {
+        return;
+    }
+    CHECK(io.waitHolding(), "read not started");
+
+    int64_t target = 1024 * 1024 + 777;
+    CHECK(avio_seek(pb, target, SEEK_SET) == target, "seek during read");
+    io.release();
+    CHECK(readAndCheck(pb, target, 256 * 1024) == 256 * 1024, "read after seek during read");
+
+    ReadAheadStats stats;
+    io.getStats(&stats);
+    printf("in-flight:    %lld io seeks, %lld bytes kept\n", (long long) stats.ioSeeks,
+           (long long) stats.readBytes);
+    CHECK(stats.ioSeeks == 1, "io seeks %lld", (long long) stats.ioSeeks);
+    io.close();
+}
+
+/**
+ * 最小容量时保留的数据比一块少，缓冲区满时向前定位到预读位置之后不到一块的地方，
+ * 丢弃旧数据时最早数据的位置会越过预读位置，之后的预读仍然要从预读位置接着写入
+ * @param url
+ */
+static void checkSmallCapacity(const char *url)
+{
+    deadline = av_gettime_relative() + WAIT_TIMEOUT;
+    TestReadAheadIO io(READ_AHEAD_CHUNK_SIZE);
+    CHECK(io.open(url, &interrupt, NULL) == 0, "open %s", url);
+    AVIOContext *pb = io.getContext();
+    if (!pb)
+    {
+        return;
+    }
+    int capacity = 2 * READ_AHEAD_CHUNK_SIZE;
+    CHECK(waitBuffered(&io, capacity), "ring not filled");
+
+    int64_t target = capacity + READ_AHEAD_CHUNK_SIZE - 1000;
+    CHECK(avio_seek(pb, target, SEEK_SET) == target, "seek past read-ahead");
+    CHECK(readAndCheck(pb, target, 1024 * 1024) == 1024 * 1024, "read past read-ahead");
+
+    ReadAheadStats stats;
+    io.getStats(&stats);
+    printf("small ring:   %lld in buffer, %lld to protocol\n", (long long) stats.bufferSeeks,
+           (long long) stats.ioSeeks);
+    CHECK(stats.bufferSeeks == 1 && stats.ioSeeks == 0, "small ring: buffer %lld, io %lld",
+          (long long) stats.bufferSeeks, (long long) stats.ioSeeks);
+    io.close();
+}
+
+/**
+ * 底层出错时先交出出错位置之前的数据再返回错误，定位之后清除错误重新预读
+ * @param url
+ */
+static void checkError(const char *url)
+{
+    deadline = av_gettime_relative() + WAIT_TIMEOUT;
+    TestReadAheadIO io(2 * 1024 * 1024);
+    int64_t failPos = 1024 * 1024 + 1000;
+    io.failAt(failPos);
+    CHECK(io.open(url, &interrupt, NULL) == 0, "open %s", url);
+    AVIOContext *pb = io.getContext();
+    if (!pb)
+    {
+        return;
+    }
+
+    int64_t pos = 0;
+    int ret;
+    while ((ret = readAndCheck(pb, pos, 10007)) > 0)
+    {
+        pos += ret;
+    }
+    CHECK(pos == failPos, "read stopped at %lld, expected %lld", (long long) pos,
+          (long long) failPos);
+    CHECK(ret == AVERROR(EIO), "read error %d", ret);
+
+    // 出错之后即使目标在缓冲区内也要交给底层重新定位
+    io.failAt(-1);
+    CHECK(avio_seek(pb, 4096, SEEK_SET) == 4096, "seek after error");
+    pb->error = 0;
+    CHECK(readAndCheck(pb, 4096, 64 * 1024) == 64 * 1024, "read after error");
+
+    ReadAheadStats stats;
+    io.getStats(&stats);
+    printf("error:        stopped at %lld, %lld io seeks to recover\n", (long long) pos,
+           (long long) stats.ioSeeks);
+    CHECK(stats.ioSeeks == 1 && stats.bufferSeeks == 0, "error: buffer %lld, io %lld",
+          (long long) stats.bufferSeeks, (long long) stats.ioSeeks);
+    io.close();
+}
+
+int main(int argc, char **argv)
+{
+    const char *dir = argc > 1 ? argv[1] : "/tmp";
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/read_ahead_io_XXXXXX", dir);
+    int fd = mkstemp(path);
+    if (fd < 0)
+    {
+        fprintf(stderr, "cannot create %s\n", path);
+        return 1;
+    }
+    uint8_t *data = (uint8_t *) malloc(FIXTURE_SIZE);
+    for (int64_t i = 0; i < FIXTURE_SIZE; ++i)
+    {
+        data[i] = patternAt(i);
+    }
+    bool written = write(fd, data, FIXTURE_SIZE) == FIXTURE_SIZE;
+    free(data);
+    ::close(fd);
+    if (!written)
+    {
+        fprintf(stderr, "cannot write %s\n", path);
+        unlink(path);
+        return 1;
+    }
+
+    av_register_all();
+    char url[1100];
+    snprintf(url, sizeof(url), "file:%s", path);
+    checkSequential(url);
+    checkSeek(url);
+    checkSeekDuringRead(url);
+    checkSmallCapacity(url);
+    checkError(url);
+    unlink(path);
+
+    printf("%s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,144 @@
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <atomic>
+#include <stdint.h>
+
+// 每个2的幂次区间再均分成的子桶数，相对误差不超过1/LATENCY_HISTOGRAM_SUB_BUCKETS
+#define LATENCY_HISTOGRAM_SUB_BITS 2
+#define LATENCY_HISTOGRAM_SUB_BUCKETS (1 << LATENCY_HISTOGRAM_SUB_BITS)
+
+// 最后一个有上界的区间是[2^(N-1), 2^N)微秒，约33秒，更大的耗时都落在最后一个桶
+#define LATENCY_HISTOGRAM_MAX_BITS 25
+
+// 直方图桶数，小于LATENCY_HISTOGRAM_SUB_BUCKETS微秒的耗时每微秒一个桶，之后每个2的幂次区间分成若干子桶
+#define LATENCY_HISTOGRAM_BUCKETS \
+    (LATENCY_HISTOGRAM_SUB_BUCKETS * (LATENCY_HISTOGRAM_MAX_BITS - LATENCY_HISTOGRAM_SUB_BITS + 1) + 1)
+
+/**
+ * 耗时直方图，以微秒为单位按对数-线性分桶，从1微秒到几十秒都保持相同的相对精度
+ * 解复用、重采样、上传等阶段通常不到1毫秒，需要微秒级的桶才能区分
+ * 只使用relaxed原子操作，记录线程和读取线程都不加锁，读取时各个桶之间不保证是同一时刻的值
+ */
+class LatencyHistogram
+{
+public:
+    LatencyHistogram()
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; ++i)
+        {
+            buckets[i].store(0, std::memory_order_relaxed);
+        }
+        sum.store(0, std::memory_order_relaxed);
+        max.store(0, std::memory_order_relaxed);
+    }
+
+    // 记录一次耗时(微秒)
+    void add(int64_t us)
+    {
+        if (us < 0)
+        {
+            us = 0;
+        }
+        buckets[getBucket(us)].fetch_add(1, std::memory_order_relaxed);
+        sum.fetch_add(us, std::memory_order_relaxed);
+        // 只有一个记录线程时不会有竞争，多个记录线程时用CAS保证最大值
+        int64_t current = max.load(std::memory_order_relaxed);
+        while (us > current
+               && !max.compare_exchange_weak(current, us, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    // 获取第bucket个桶的次数
+    int64_t getCount(int bucket) const
+    {
+        return buckets[bucket].load(std::memory_order_relaxed);
+    }
+
+    // 获取总次数
+    int64_t getTotal() const
+    {
+        int64_t total = 0;
+        for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; ++i)
+        {
+            total += buckets[i].load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    // 获取总耗时(微秒)
+    int64_t getSum() const
+    {
+        return sum.load(std::memory_order_relaxed);
+    }
+
+    // 获取最大耗时(微秒)
+    int64_t getMax() const
+    {
+        return max.load(std::memory_order_relaxed);
+    }
+
+    // 估算百分位数(0 ~ 100)，返回所在桶的上界(微秒)，落在最后一个桶时返回最大值
+    int64_t getPercentile(double percent) const
+    {
+        int64_t total = getTotal();
+        if (total == 0)
+        {
+            return 0;
+        }
+        int64_t target = (int64_t) (total * percent / 100.0 + 0.5);
+        int64_t count = 0;
+        for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS - 1; ++i)
+        {
+            count += getCount(i);
+            if (count >= target)
+            {
+                return getBucketLimit(i);
+            }
+        }
+        return getMax();
+    }
+
+    // 耗时(微秒)所在的桶
+    static int getBucket(int64_t us)
+    {
+        if (us < LATENCY_HISTOGRAM_SUB_BUCKETS)
+        {
+            return (int) us;
+        }
+        int bits = 63 - __builtin_clzll((uint64_t) us);
+        if (bits >= LATENCY_HISTOGRAM_MAX_BITS)
+        {
+            return LATENCY_HISTOGRAM_BUCKETS - 1;
+        }
+        // 最高位之后的LATENCY_HISTOGRAM_SUB_BITS位是区间内的子桶
+        int shift = bits - LATENCY_HISTOGRAM_SUB_BITS;
+        int sub = (int) (us >> shift) & (LATENCY_HISTOGRAM_SUB_BUCKETS - 1);
+        return LATENCY_HISTOGRAM_SUB_BUCKETS * (shift + 1) + sub;
+    }
+
+    // 第bucket个桶的上界(微秒)，不包含上界本身，最后一个桶没有上界
+    static int64_t getBucketLimit(int bucket)
+    {
+        if (bucket < LATENCY_HISTOGRAM_SUB_BUCKETS)
+        {
+            return bucket + 1;
+        }
+        int shift = bucket / LATENCY_HISTOGRAM_SUB_BUCKETS - 1;
+        int sub = bucket % LATENCY_HISTOGRAM_SUB_BUCKETS;
+        return (int64_t) (LATENCY_HISTOGRAM_SUB_BUCKETS + sub + 1) << shift;
+    }
+
+private:
+    std::atomic<int64_t> buckets[LATENCY_HISTOGRAM_BUCKETS];
+    std::atomic<int64_t> sum;
+    std::atomic<int64_t> max;
+};
+
+#endif //LATENCYHISTOGRAM_H
@@ -0,0 +1,49 @@
+#include "PipelineStats.h"
+
+const char *getPipelineStageName(int stage)
+{
+    static const char *names[STAGE_COUNT] = {
+            "demux",
+            "audio decode",
+            "video decode",
+            "audio resample",
+            "video convert",
+            "video upload",
+            "video render"
+    };
+    if (stage < 0 || stage >= STAGE_COUNT)
+    {
+        return "unknown";
+    }
+    return names[stage];
+}
+
+const char *getStartupPhaseName(int phase)
+{
+    static const char *names[STARTUP_PHASE_COUNT] = {
+            "open",
+            "probe",
+            "codec open",
+            "first packet",
+            "first frame"
+    };
+    if (phase < 0 || phase >= STARTUP_PHASE_COUNT)
+    {
+        return "unknown";
+    }
+    return names[phase];
+}
+
+void getStageStats(const LatencyHistogram *histogram, StageStats *stats)
+{
+    stats->count = 0;
+    for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; ++i)
+    {
+        stats->buckets[i] = histogram->getCount(i);
+        stats->count += stats->buckets[i];
+    }
+    stats->totalTime = histogram->getSum();
+    stats->maxTime = histogram->getMax();
+    stats->p50 = histogram->getPercentile(50);
+    stats->p99 = histogram->getPercentile(99);
+}
@@ -0,0 +1,124 @@
+#ifndef PIPELINESTATS_H
+#define PIPELINESTATS_H
+
+#include <common/LatencyHistogram.h>
+
+extern "C" {
+#include <libavutil/time.h>
+};
+
+// 流水线耗时统计开关，编译时定义为0则统计代码全部去掉
+#ifndef PLAYER_STATS
+#define PLAYER_STATS 1
+#endif
+
+/**
+ * 流水线阶段
+ */
+enum PipelineStage
+{
+    STAGE_DEMUX = 0,            // 读取数据包，av_read_frame
+    STAGE_AUDIO_DECODE,         // 音频解码，avcodec_send_packet + avcodec_receive_frame
+    STAGE_VIDEO_DECODE,         // 视频解码，avcodec_send_packet + avcodec_receive_frame
+    STAGE_AUDIO_RESAMPLE,       // 音频重采样，swr_convert
+    STAGE_VIDEO_CONVERT,        // 视频格式转换，解码线程的转换以及渲染时的软件转换
+    STAGE_VIDEO_UPLOAD,         // 纹理上传
+    STAGE_VIDEO_RENDER,         // 绘制并交换缓冲区
+    STAGE_COUNT
+};
+
+/**
+ * 起播阶段，记录的是各阶段完成的时间
+ */
+enum StartupPhase
+{
+    STARTUP_OPEN = 0,           // 打开文件，avformat_open_input
+    STARTUP_PROBE,              // 查找媒体流信息，avformat_find_stream_info
+    STARTUP_CODEC_OPEN,         // 打开解码器
+    STARTUP_FIRST_PACKET,       // 读出第一个数据包
+    STARTUP_FIRST_FRAME,        // 第一帧画面送显，没有视频时为第一次输出音频
+    STARTUP_PHASE_COUNT
+};
+
+/**
+ * 单个阶段的耗时统计，时间单位为微秒
+ */
+typedef struct StageStats
+{
+    int64_t count;              // 次数
+    int64_t totalTime;          // 总耗时
+    int64_t maxTime;            // 最大耗时
+    int64_t p50;                // 中位数所在桶的上界
+    int64_t p99;                // 99分位数所在桶的上界
+    int64_t buckets[LATENCY_HISTOGRAM_BUCKETS];
+} StageStats;
+
+/**
+ * 播放器统计快照
+ */
+typedef struct PlayerStats
+{
+    StageStats stages[STAGE_COUNT];
+
+    // 队列深度
+    int audioPackets;           // 音频数据包队列的包数
+    int videoPackets;           // 视频数据包队列的包数
+    int audioQueueBytes;        // 音频数据包队列占用的内存
+    int videoQueueBytes;        // 视频数据包队列占用的内存
+    int videoFrames;            // 视频帧队列中待显示的帧数
+    int audioBufferBytes;       // PCM缓冲区中待播放的数据
+
+    // 帧计数
+    int64_t decodedFrames;      // 解码的视频帧数
+    int64_t droppedFrames;      // 丢弃的视频帧数
+    int64_t presentedFrames;    // 送显的视频帧数
+    int64_t repeatedFrames;     // 重复显示的视频帧数
+    int64_t skippedFrames;      // 同步线程跳过的视频帧数
+
+    // 定位
+    int64_t cachedSeeks;        // 在数据包缓存中完成的定位次数
+    int64_t demuxerSeeks;       // 需要解复用器定位的次数
+    int64_t indexSeeks;         // 按关键帧索引以字节定位的次数
+    int64_t seekIndexEntries;   // 关键帧索引的项数
+    int64_t packetCacheBytes;   // 数据包缓存占用的内存
+    int64_t coalescedSeeks;     // 还没有执行就被新的请求替换的定位次数
+    int64_t abortedSeeks;       // 执行过程中被新的请求中断的定位次数
+    StageStats seekLatency;     // 从请求定位到第一次输出画面或者声音的耗时
+    int64_t accurateSeeks;      // 完成追赶的精确定位次数
+    int64_t catchupFrames;      // 精确定位追赶过程中解码后丢弃的帧数
+    StageStats catchupTime;     // 精确定位从关键帧追赶到目标位置的耗时
+
+    // 预读I/O
+    int64_t ioBufferedBytes;    // 读位置之后已经预读的数据量
+    int64_t ioReadBytes;        // I/O线程读取的总数据量
+    int64_t ioReadTime;         // I/O线程阻塞在读取上的总时长(微秒)
+    int64_t ioStalls;           // 解复用器读数据时缓冲区为空的次数
+    int64_t ioStallTime;        // 解复用器等待数据的总时长(微秒)
+    int64_t ioBufferSeeks;      // 目标在预读缓冲区内的定位次数
+    int64_t ioSeeks;            // 需要底层重新定位的次数
+
+    // 起播各阶段完成的时间，从开始准备算起(微秒)，0表示还没有完成
+    int64_t startupTime[STARTUP_PHASE_COUNT];
+} PlayerStats;
+
+// 获取阶段名称
+const char *getPipelineStageName(int stage);
+
+// 获取起播阶段名称
+const char *getStartupPhaseName(int phase);
+
+// 从直方图中读取统计值
+void getStageStats(const LatencyHistogram *histogram, StageStats *stats);
+
+#if PLAYER_STATS
+// 开始计时
+#define STATS_BEGIN(name) int64_t name = av_gettime_relative()
+// 结束计时，记录到播放器状态对应阶段的直方图中
+#define STATS_END(state, stage, name) \
+    (state)->stageLatency[stage].add(av_gettime_relative() - (name))
+#else
+#define STATS_BEGIN(name)
+#define STATS_END(state, stage, name)
+#endif
+
+#endif //PIPELINESTATS_H
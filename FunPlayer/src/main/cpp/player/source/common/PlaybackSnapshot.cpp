@@ -0,0 +1,110 @@
+#include <math.h>
+#include "PlaybackSnapshot.h"
+
+PlaybackSnapshotPublisher::PlaybackSnapshotPublisher()
+{
+    reset();
+}
+
+void PlaybackSnapshotPublisher::reset()
+{
+    snapshot.write([](PlaybackSnapshot &value)
+                   {
+                       value.position = 0;
+                       value.duration = -1;
+                       value.bufferedPosition = 0;
+                       value.videoWidth = 0;
+                       value.videoHeight = 0;
+                       value.rotation = 0;
+                       value.state = PLAYBACK_IDLE;
+                       value.seeking = 0;
+                       value.avDiff = NAN;
+                   });
+}
+
+/**
+ * 读取最近发布的快照，不会等待正在进行的更新
+ * @param snapshot
+ */
+void PlaybackSnapshotPublisher::getSnapshot(PlaybackSnapshot *snapshot) const
+{
+    this->snapshot.read(snapshot);
+}
+
+int PlaybackSnapshotPublisher::getState() const
+{
+    PlaybackSnapshot value;
+    snapshot.read(&value);
+    return value.state;
+}
+
+void PlaybackSnapshotPublisher::setPosition(int64_t position)
+{
+    snapshot.write([position](PlaybackSnapshot &value)
+                   {
+                       if (!value.seeking)
+                       {
+                           value.position = position;
+                       }
+                   });
+}
+
+void PlaybackSnapshotPublisher::setAVDiff(double diff)
+{
+    snapshot.write([diff](PlaybackSnapshot &value)
+                   {
+                       value.avDiff = diff;
+                   });
+}
+
+void PlaybackSnapshotPublisher::setBufferedPosition(int64_t position)
+{
+    snapshot.write([position](PlaybackSnapshot &value)
+                   {
+                       value.bufferedPosition = position;
+                   });
+}
+
+void PlaybackSnapshotPublisher::setDuration(int64_t duration)
+{
+    snapshot.write([duration](PlaybackSnapshot &value)
+                   {
+                       value.duration = duration;
+                   });
+}
+
+void PlaybackSnapshotPublisher::setVideoSize(int width, int height, int rotation)
+{
+    snapshot.write([width, height, rotation](PlaybackSnapshot &value)
+                   {
+                       value.videoWidth = width;
+                       value.videoHeight = height;
+                       value.rotation = rotation;
+                   });
+}
+
+void PlaybackSnapshotPublisher::setState(int state)
+{
+    snapshot.write([state](PlaybackSnapshot &value)
+                   {
+                       value.state = state;
+                   });
+}
+
+void PlaybackSnapshotPublisher::beginSeek(int64_t position)
+{
+    snapshot.write([position](PlaybackSnapshot &value)
+                   {
+                       value.position = position;
+                       value.bufferedPosition = position;
+                       value.seeking = 1;
+                   });
+}
+
+void PlaybackSnapshotPublisher::endSeek()
+{
+    snapshot.write([](PlaybackSnapshot &value)
+                   {
+                       value.seeking = 0;
+                   });
+}
@@ -0,0 +1,88 @@
+#ifndef PLAYBACKSNAPSHOT_H
+#define PLAYBACKSNAPSHOT_H
+
+#include <stdint.h>
+#include <common/SeqLock.h>
+
+/**
+ * 播放状态
+ */
+enum PlaybackStatus
+{
+    PLAYBACK_IDLE = 0,          // 未开始准备
+    PLAYBACK_PREPARING,         // 正在打开文件、查找媒体流信息
+    PLAYBACK_PREPARED,          // 准备完成，等待开始
+    PLAYBACK_PLAYING,           // 正在播放
+    PLAYBACK_PAUSED,            // 暂停
+    PLAYBACK_COMPLETED,         // 播放完成
+    PLAYBACK_STOPPED,           // 已停止
+    PLAYBACK_ERROR,             // 出错
+};
+
+/**
+ * 播放状态快照，时间单位为毫秒
+ */
+typedef struct PlaybackSnapshot
+{
+    int64_t position;           // 播放位置
+    int64_t duration;           // 时长，-1表示未知或者实时流
+    int64_t bufferedPosition;   // 已读取到的位置，各个媒体流中最小的一个
+    int videoWidth;             // 视频宽度
+    int videoHeight;            // 视频高度
+    int rotation;               // 视频旋转角度
+    int state;                  // 播放状态，PlaybackStatus
+    int seeking;                // 是否正在定位
+    double avDiff;              // 视频时钟减去音频时钟，单位为秒，缺少音频或者视频时为NAN
+    int64_t droppedFrames;      // 丢弃的视频帧数
+    int64_t stallCount;         // 音频输出数据不足的次数，即卡顿次数
+} PlaybackSnapshot;
+
+/**
+ * 播放状态快照的发布者，各个线程各自更新负责的字段，任意线程不加锁读取一致的快照
+ * 与MediaClock一样使用双缓冲顺序锁，读取时返回最近发布的一份，不等待正在进行的更新，
+ * 也不会被打开文件、查找媒体流信息等耗时操作阻塞
+ * 计数器由各自的原子变量维护，读取时直接复制，不参与顺序锁
+ */
+class PlaybackSnapshotPublisher
+{
+public:
+    PlaybackSnapshotPublisher();
+
+    // 恢复到初始状态
+    void reset();
+
+    // 读取快照，计数器字段为0，由调用方填写
+    void getSnapshot(PlaybackSnapshot *snapshot) const;
+
+    // 获取播放状态
+    int getState() const;
+
+    // 更新播放位置，正在定位时忽略，避免定位完成前显示旧的位置
+    void setPosition(int64_t position);
+
+    // 更新音视频时钟差值
+    void setAVDiff(double diff);
+
+    // 更新已读取到的位置
+    void setBufferedPosition(int64_t position);
+
+    // 更新时长
+    void setDuration(int64_t duration);
+
+    // 更新视频尺寸和旋转角度
+    void setVideoSize(int width, int height, int rotation);
+
+    // 更新播放状态
+    void setState(int state);
+
+    // 开始定位，播放位置直接更新为定位的目标位置
+    void beginSeek(int64_t position);
+
+    // 结束定位
+    void endSeek();
+
+private:
+    SeqLock<PlaybackSnapshot> snapshot;     // 播放状态，计数器字段不使用
+};
+
+#endif //PLAYBACKSNAPSHOT_H
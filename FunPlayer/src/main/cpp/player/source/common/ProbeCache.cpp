@@ -0,0 +1,490 @@
+#include "ProbeCache.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <inttypes.h>
+
+extern "C" {
+#include <libavutil/avstring.h>
+#include <libavutil/mem.h>
+};
+
+/**
+ * FNV-1a 64位哈希，用于生成缓存文件名
+ * @param str
+ * @return
+ */
+static uint64_t hashString(const char *str)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    while (*str)
+    {
+        hash ^= (uint8_t) *str++;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+char *getCacheFilePath(const char *cacheDir, const char *url, const char *ext)
+{
+    return av_asprintf("%s/%016" PRIx64 ".%s", cacheDir, hashString(url), ext);
+}
+
+/**
+ * 本地文件取修改时间，网络文件只有 avio_size 得到的长度
+ * @param ic
+ * @param url
+ * @param size
+ * @param mtime
+ */
+void getCacheSignature(AVFormatContext *ic, const char *url, int64_t *size, int64_t *mtime)
+{
+    *size = ic->pb ? avio_size(ic->pb) : -1;
+    *mtime = 0;
+
+    const char *localPath = url;
+    av_strstart(url, "file:", &localPath);
+    if (!strstr(localPath, "://"))
+    {
+        struct stat st;
+        if (stat(localPath, &st) == 0)
+        {
+            *mtime = (int64_t) st.st_mtime;
+        }
+    }
+}
+
+void makeCacheDir(const char *path)
+{
+    char *dir = av_strdup(path);
+    char *slash = dir ? strrchr(dir, '/') : NULL;
+    if (slash && slash != dir)
+    {
+        *slash = '\0';
+        mkdir(dir, 0755);
+    }
+    av_free(dir);
+}
+
+ProbeCache::ProbeCache(const char *cacheDir, const char *url)
+{
+    this->url = av_strdup(url);
+    path = getCacheFilePath(cacheDir, url, "probe");
+    cachedUrl = NULL;
+    streamCount = 0;
+    clear();
+}
+
+ProbeCache::~ProbeCache()
+{
+    clear();
+    av_freep(&path);
+    av_freep(&url);
+}
+
+void ProbeCache::clear()
+{
+    av_freep(&cachedUrl);
+    for (int i = 0; i < streamCount; ++i)
+    {
+        avcodec_parameters_free(&streams[i].codecpar);
+    }
+    version = 0;
+    fileSize = -1;
+    modifyTime = 0;
+    duration = AV_NOPTS_VALUE;
+    startTime = AV_NOPTS_VALUE;
+    seekByBytes = 0;
+    audioIndex = -1;
+    videoIndex = -1;
+    nbStreams = 0;
+    streamCount = 0;
+}
+
+static int hexValue(char c)
+{
+    if (c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f')
+    {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+int ProbeCache::parseLine(char *line)
+{
+    char *value = strchr(line, '=');
+    if (!value)
+    {
+        return -1;
+    }
+    *value++ = '\0';
+
+    if (!strcmp(line, "version"))
+    {
+        version = atoi(value);
+    }
+    else if (!strcmp(line, "url"))
+    {
+        av_freep(&cachedUrl);
+        cachedUrl = av_strdup(value);
+    }
+    else if (!strcmp(line, "size"))
+    {
+        fileSize = strtoll(value, NULL, 10);
+    }
+    else if (!strcmp(line, "mtime"))
+    {
+        modifyTime = strtoll(value, NULL, 10);
+    }
+    else if (!strcmp(line, "duration"))
+    {
+        duration = strtoll(value, NULL, 10);
+    }
+    else if (!strcmp(line, "start_time"))
+    {
+        startTime = strtoll(value, NULL, 10);
+    }
+    else if (!strcmp(line, "seek_by_bytes"))
+    {
+        seekByBytes = atoi(value);
+    }
+    else if (!strcmp(line, "audio_index"))
+    {
+        audioIndex = atoi(value);
+    }
+    else if (!strcmp(line, "video_index"))
+    {
+        videoIndex = atoi(value);
+    }
+    else if (!strcmp(line, "nb_streams"))
+    {
+        nbStreams = atoi(value);
+    }
+    else if (!strcmp(line, "stream"))
+    {
+        if (streamCount >= PROBE_CACHE_MAX_STREAMS)
+        {
+            return -1;
+        }
+        AVCodecParameters *par = avcodec_parameters_alloc();
+        if (!par)
+        {
+            return AVERROR(ENOMEM);
+        }
+        ProbeCacheStream *stream = &streams[streamCount++];
+        stream->codecpar = par;
+
+        int codecType, codecId, extradataSize, offset = 0;
+        unsigned int codecTag;
+        long long bitRate;
+        unsigned long long channelLayout;
+        if (sscanf(value, "%d %d %u %d %lld %d %d %d %d %d %d %llu %d %d %d %d %d %d %d %d %n",
+                   &codecType, &codecId, &codecTag, &par->format, &bitRate,
+                   &par->width, &par->height,
+                   &par->sample_aspect_ratio.num, &par->sample_aspect_ratio.den,
+                   &par->sample_rate, &par->channels, &channelLayout, &par->frame_size,
+                   &par->profile, &par->level,
+                   &stream->frameRate.num, &stream->frameRate.den,
+                   &stream->avgFrameRate.num, &stream->avgFrameRate.den,
+                   &extradataSize, &offset) < 20 || offset == 0)
+        {
+            return -1;
+        }
+        par->codec_type = (enum AVMediaType) codecType;
+        par->codec_id = (enum AVCodecID) codecId;
+        par->codec_tag = codecTag;
+        par->bit_rate = bitRate;
+        par->channel_layout = channelLayout;
+
+        // extradata 以十六进制保存
+        if (extradataSize > 0)
+        {
+            const char *hex = value + offset;
+            if ((int) strlen(hex) < extradataSize * 2)
+            {
+                return -1;
+            }
+            par->extradata = (uint8_t *) av_mallocz(extradataSize + AV_INPUT_BUFFER_PADDING_SIZE);
+            if (!par->extradata)
+            {
+                return AVERROR(ENOMEM);
+            }
+            par->extradata_size = extradataSize;
+            for (int i = 0; i < extradataSize; ++i)
+            {
+                int high = hexValue(hex[2 * i]);
+                int low = hexValue(hex[2 * i + 1]);
+                if (high < 0 || low < 0)
+                {
+                    return -1;
+                }
+                par->extradata[i] = (uint8_t) ((high << 4) | low);
+            }
+        }
+    }
+    return 0;
+}
+
+int ProbeCache::load(AVFormatContext *ic)
+{
+    clear();
+
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+    {
+        return -1;
+    }
+    int ret = -1;
+    char *buffer = NULL;
+    do
+    {
+        if (fseek(fp, 0, SEEK_END) != 0)
+        {
+            break;
+        }
+        long length = ftell(fp);
+        if (length <= 0 || length > PROBE_CACHE_MAX_FILE_SIZE || fseek(fp, 0, SEEK_SET) != 0)
+        {
+            break;
+        }
+        buffer = (char *) av_malloc((size_t) length + 1);
+        if (!buffer || fread(buffer, 1, (size_t) length, fp) != (size_t) length)
+        {
+            break;
+        }
+        buffer[length] = '\0';
+
+        ret = 0;
+        char *line = buffer;
+        while (line && *line && ret == 0)
+        {
+            char *next = strchr(line, '\n');
+            if (next)
+            {
+                *next++ = '\0';
+            }
+            ret = parseLine(line);
+            line = next;
+        }
+    } while (false);
+    av_free(buffer);
+    fclose(fp);
+
+    // 校验缓存
+    int64_t size, mtime;
+    getCacheSignature(ic, url, &size, &mtime);
+    if (ret < 0 || version != PROBE_CACHE_VERSION || !cachedUrl || strcmp(cachedUrl, url)
+        || size <= 0 || size != fileSize || mtime != modifyTime || streamCount != nbStreams)
+    {
+        av_log(NULL, AV_LOG_INFO, "probe cache miss: %s\n", url);
+        if (ret == 0)
+        {
+            remove();
+        }
+        clear();
+        return -1;
+    }
+    return 0;
+}
+
+int ProbeCache::match(AVFormatContext *ic)
+{
+    if ((int) ic->nb_streams != streamCount)
+    {
+        return 0;
+    }
+    for (int i = 0; i < streamCount; ++i)
+    {
+        AVCodecParameters *par = ic->streams[i]->codecpar;
+        if (par->codec_type != streams[i].codecpar->codec_type
+            || par->codec_id != streams[i].codecpar->codec_id)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * 只填充文件头中没有的字段，文件头中已有的参数以文件头为准
+ * @param ic
+ */
+void ProbeCache::apply(AVFormatContext *ic)
+{
+    for (int i = 0; i < streamCount && i < (int) ic->nb_streams; ++i)
+    {
+        AVStream *st = ic->streams[i];
+        AVCodecParameters *par = st->codecpar;
+        const AVCodecParameters *cached = streams[i].codecpar;
+
+        if (!par->codec_tag)
+        {
+            par->codec_tag = cached->codec_tag;
+        }
+        if (par->format < 0)
+        {
+            par->format = cached->format;
+        }
+        if (!par->bit_rate)
+        {
+            par->bit_rate = cached->bit_rate;
+        }
+        if (!par->width || !par->height)
+        {
+            par->width = cached->width;
+            par->height = cached->height;
+        }
+        if (!par->sample_aspect_ratio.num)
+        {
+            par->sample_aspect_ratio = cached->sample_aspect_ratio;
+        }
+        if (!par->sample_rate)
+        {
+            par->sample_rate = cached->sample_rate;
+        }
+        if (!par->channels)
+        {
+            par->channels = cached->channels;
+        }
+        if (!par->channel_layout)
+        {
+            par->channel_layout = cached->channel_layout;
+        }
+        if (!par->frame_size)
+        {
+            par->frame_size = cached->frame_size;
+        }
+        if (par->profile == FF_PROFILE_UNKNOWN)
+        {
+            par->profile = cached->profile;
+        }
+        if (par->level == FF_LEVEL_UNKNOWN)
+        {
+            par->level = cached->level;
+        }
+        if (!par->extradata_size && cached->extradata_size > 0)
+        {
+            par->extradata = (uint8_t *) av_mallocz(
+                    cached->extradata_size + AV_INPUT_BUFFER_PADDING_SIZE);
+            if (par->extradata)
+            {
+                memcpy(par->extradata, cached->extradata, (size_t) cached->extradata_size);
+                par->extradata_size = cached->extradata_size;
+            }
+        }
+        if (!st->r_frame_rate.num)
+        {
+            st->r_frame_rate = streams[i].frameRate;
+        }
+        if (!st->avg_frame_rate.num)
+        {
+            st->avg_frame_rate = streams[i].avgFrameRate;
+        }
+    }
+    if (ic->duration == AV_NOPTS_VALUE)
+    {
+        ic->duration = duration;
+    }
+    if (ic->start_time == AV_NOPTS_VALUE)
+    {
+        ic->start_time = startTime;
+    }
+}
+
+/**
+ * 先写入临时文件再重命名，其他播放器不会读到写了一半的缓存
+ */
+int ProbeCache::save(AVFormatContext *ic, int audioIndex, int videoIndex, int seekByBytes)
+{
+    int64_t size, mtime;
+    getCacheSignature(ic, url, &size, &mtime);
+    if (size <= 0 || ic->nb_streams > PROBE_CACHE_MAX_STREAMS)
+    {
+        return -1;
+    }
+    // 缓存目录不存在时创建，只创建最后一级
+    makeCacheDir(path);
+
+    char *tmpPath = av_asprintf("%s.%d.tmp", path, (int) getpid());
+    if (!tmpPath)
+    {
+        return AVERROR(ENOMEM);
+    }
+    FILE *fp = fopen(tmpPath, "wb");
+    if (!fp)
+    {
+        av_free(tmpPath);
+        return -1;
+    }
+
+    fprintf(fp, "version=%d\n", PROBE_CACHE_VERSION);
+    fprintf(fp, "url=%s\n", url);
+    fprintf(fp, "size=%" PRId64 "\n", size);
+    fprintf(fp, "mtime=%" PRId64 "\n", mtime);
+    fprintf(fp, "duration=%" PRId64 "\n", ic->duration);
+    fprintf(fp, "start_time=%" PRId64 "\n", ic->start_time);
+    fprintf(fp, "seek_by_bytes=%d\n", seekByBytes);
+    fprintf(fp, "audio_index=%d\n", audioIndex);
+    fprintf(fp, "video_index=%d\n", videoIndex);
+    fprintf(fp, "nb_streams=%d\n", (int) ic->nb_streams);
+    for (int i = 0; i < (int) ic->nb_streams; ++i)
+    {
+        AVStream *st = ic->streams[i];
+        AVCodecParameters *par = st->codecpar;
+        fprintf(fp, "stream=%d %d %u %d %lld %d %d %d %d %d %d %llu %d %d %d %d %d %d %d %d ",
+                (int) par->codec_type, (int) par->codec_id, par->codec_tag, par->format,
+                (long long) par->bit_rate, par->width, par->height,
+                par->sample_aspect_ratio.num, par->sample_aspect_ratio.den,
+                par->sample_rate, par->channels, (unsigned long long) par->channel_layout,
+                par->frame_size, par->profile, par->level,
+                st->r_frame_rate.num, st->r_frame_rate.den,
+                st->avg_frame_rate.num, st->avg_frame_rate.den, par->extradata_size);
+        for (int j = 0; j < par->extradata_size; ++j)
+        {
+            fprintf(fp, "%02x", par->extradata[j]);
+        }
+        fprintf(fp, "\n");
+    }
+
+    int ret = ferror(fp) ? -1 : 0;
+    if (fclose(fp) != 0)
+    {
+        ret = -1;
+    }
+    if (ret == 0 && rename(tmpPath, path) != 0)
+    {
+        ret = -1;
+    }
+    if (ret < 0)
+    {
+        unlink(tmpPath);
+    }
+    av_free(tmpPath);
+    return ret;
+}
+
+void ProbeCache::remove()
+{
+    unlink(path);
+}
+
+int ProbeCache::getAudioIndex() const
+{
+    return audioIndex;
+}
+
+int ProbeCache::getVideoIndex() const
+{
+    return videoIndex;
+}
+
+int ProbeCache::getSeekByBytes() const
+{
+    return seekByBytes;
+}
@@ -0,0 +1,120 @@
+#ifndef PROBECACHE_H
+#define PROBECACHE_H
+
+#include <stdint.h>
+
+extern "C" {
+#include <libavformat/avformat.h>
+};
+
+// 缓存文件格式版本，格式变化时增加，旧版本的缓存直接丢弃
+#define PROBE_CACHE_VERSION 1
+
+// 缓存的最大媒体流数，超过时不缓存
+#define PROBE_CACHE_MAX_STREAMS 32
+
+// 缓存文件的最大长度，主要是extradata
+#define PROBE_CACHE_MAX_FILE_SIZE (1024 * 1024)
+
+// 读包时才出现媒体流的格式(例如mpegts)，命中缓存时探测的数据量(字节)和时长(微秒)上限
+// 时长为0时 avformat_find_stream_info 会使用默认值，所以这里取一个很小的正数
+#define PROBE_CACHE_PROBE_SIZE (32 * 1024)
+#define PROBE_CACHE_ANALYZE_DURATION 100000
+
+// 根据url生成缓存目录下的文件路径，文件名为url的哈希值，ext为扩展名，返回值由调用者释放
+char *getCacheFilePath(const char *cacheDir, const char *url, const char *ext);
+
+// 获取文件大小以及本地文件的修改时间，用于校验缓存
+void getCacheSignature(AVFormatContext *ic, const char *url, int64_t *size, int64_t *mtime);
+
+// 创建缓存文件所在的目录，只创建最后一级
+void makeCacheDir(const char *path);
+
+/**
+ * 缓存的媒体流参数
+ */
+typedef struct ProbeCacheStream
+{
+    AVCodecParameters *codecpar;    // 解码参数
+    AVRational frameRate;           // r_frame_rate
+    AVRational avgFrameRate;        // avg_frame_rate
+} ProbeCacheStream;
+
+/**
+ * 媒体流探测结果的磁盘缓存，每个url一个文件，文件名为url的哈希值
+ * 缓存以url、文件大小以及本地文件的修改时间为准，打开文件之后任何一项不一致或者媒体流数量、编码类型
+ * 与文件头不一致时缓存失效并删除，网络文件没有修改时间，以Content-Length作为文件大小校验
+ * 命中时把缓存的解码参数填到解复用上下文中还没有确定的字段，跳过 avformat_find_stream_info
+ */
+class ProbeCache
+{
+public:
+    ProbeCache(const char *cacheDir, const char *url);
+
+    virtual ~ProbeCache();
+
+    /**
+     * 读取并校验缓存，需要在 avformat_open_input 之后调用
+     * @param ic
+     * @return 0表示缓存有效，小于0表示没有缓存或者缓存已失效
+     */
+    int load(AVFormatContext *ic);
+
+    /**
+     * 检查缓存的媒体流与解复用上下文中的媒体流是否一致
+     * @param ic
+     * @return 1表示一致
+     */
+    int match(AVFormatContext *ic);
+
+    /**
+     * 用缓存的参数填充解复用上下文中还没有确定的字段
+     * @param ic
+     */
+    void apply(AVFormatContext *ic);
+
+    /**
+     * 保存探测结果
+     * @param ic
+     * @param audioIndex 选中的音频流
+     * @param videoIndex 选中的视频流
+     * @param seekByBytes 是否以字节定位
+     * @return 0表示成功
+     */
+    int save(AVFormatContext *ic, int audioIndex, int videoIndex, int seekByBytes);
+
+    // 删除缓存文件
+    void remove();
+
+    int getAudioIndex() const;
+
+    int getVideoIndex() const;
+
+    int getSeekByBytes() const;
+
+private:
+    // 释放读取的缓存内容
+    void clear();
+
+    // 解析缓存文件的一行
+    int parseLine(char *line);
+
+private:
+    char *path;                     // 缓存文件路径
+    char *url;                      // 文件路径
+
+    char *cachedUrl;
+    int version;
+    int64_t fileSize;
+    int64_t modifyTime;
+    int64_t duration;
+    int64_t startTime;
+    int seekByBytes;
+    int audioIndex;
+    int videoIndex;
+    int nbStreams;
+    int streamCount;                // 已解析的媒体流数
+    ProbeCacheStream streams[PROBE_CACHE_MAX_STREAMS];
+};
+
+#endif //PROBECACHE_H
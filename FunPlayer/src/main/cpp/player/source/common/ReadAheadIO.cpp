@@ -0,0 +1,358 @@
+#include "ReadAheadIO.h"
+#include "TraceRecorder.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+extern "C" {
+#include <libavutil/avstring.h>
+#include <libavutil/mem.h>
+#include <libavutil/time.h>
+};
+
+ReadAheadIO::ReadAheadIO(int bufferSize)
+{
+    abortRequest = 0;
+    started = 0;
+    outerInterrupt.callback = NULL;
+    outerInterrupt.opaque = NULL;
+    innerContext = NULL;
+    ioContext = NULL;
+    fileSize = -1;
+    ring = NULL;
+    // 按64位计算，接近INT_MAX的大小向上取整时不会溢出
+    capacity = FFMAX(((int64_t) bufferSize + READ_AHEAD_CHUNK_SIZE - 1) / READ_AHEAD_CHUNK_SIZE, 2)
+               * READ_AHEAD_CHUNK_SIZE;
+    backSize = capacity / 8;
+    bufferPos = 0;
+    readPos = 0;
+    writePos = 0;
+    seekTarget = -1;
+    generation = 0;
+    eof = 0;
+    error = 0;
+    memset(&stats, 0, sizeof(stats));
+}
+
+ReadAheadIO::~ReadAheadIO()
+{
+    close();
+}
+
+int ReadAheadIO::isSupported(const char *url)
+{
+    if (!url || strstr(url, ".m3u8"))
+    {
+        return 0;
+    }
+    return !strstr(url, "://") || av_strstart(url, "file:", NULL)
+           || av_stristart(url, "http://", NULL) || av_stristart(url, "https://", NULL);
+}
+
+int ReadAheadIO::open(const char *url, const AVIOInterruptCB *interruptCallback,
+                      AVDictionary **options)
+{
+    if (interruptCallback)
+    {
+        outerInterrupt = *interruptCallback;
+    }
+    AVIOInterruptCB innerInterrupt = {ReadAheadIO::interruptCallback, this};
+    int ret = avio_open2(&innerContext, url, AVIO_FLAG_READ, &innerInterrupt, options);
+    if (ret < 0)
+    {
+        return ret;
+    }
+    fileSize = avio_size(innerContext);
+
+    void *buffer = NULL;
+    if (posix_memalign(&buffer, READ_AHEAD_ALIGNMENT, (size_t) capacity) != 0)
+    {
+        close();
+        return AVERROR(ENOMEM);
+    }
+    ring = (uint8_t *) buffer;
+
+    uint8_t *ioBuffer = (uint8_t *) av_malloc(READ_AHEAD_IO_BUFFER_SIZE);
+    if (ioBuffer)
+    {
+        ioContext = avio_alloc_context(ioBuffer, READ_AHEAD_IO_BUFFER_SIZE, 0, this,
+                                       readPacket, NULL, seekPacket);
+    }
+    if (!ioContext)
+    {
+        av_free(ioBuffer);
+        close();
+        return AVERROR(ENOMEM);
+    }
+    ioContext->seekable = innerContext->seekable;
+
+    started = 1;
+    ioThread = std::thread(&ReadAheadIO::run, this);
+    return 0;
+}
+
+void ReadAheadIO::close()
+{
+    mMutex.lock();
+    abortRequest = 1;
+    mSpaceCondition.signal();
+    mDataCondition.signal();
+    mMutex.unlock();
+    if (ioThread.joinable())
+    {
+        ioThread.join();
+    }
+    started = 0;
+    if (innerContext)
+    {
+        avio_closep(&innerContext);
+    }
+    if (ioContext)
+    {
+        av_freep(&ioContext->buffer);
+        av_freep(&ioContext);
+    }
+    if (ring)
+    {
+        free(ring);
+        ring = NULL;
+    }
+}
+
+AVIOContext *ReadAheadIO::getContext()
+{
+    return ioContext;
+}
+
+void ReadAheadIO::getStats(ReadAheadStats *stats)
+{
+    Mutex::Autolock lock(mMutex);
+    *stats = this->stats;
+    stats->bufferedBytes = FFMAX(writePos - readPos, 0);
+}
+
+int ReadAheadIO::readSource(uint8_t *buf, int size)
+{
+    return avio_read(innerContext, buf, size);
+}
+
+int64_t ReadAheadIO::seekSource(int64_t pos)
+{
+    return avio_seek(innerContext, pos, SEEK_SET);
+}
+
+int ReadAheadIO::interruptCallback(void *ctx)
+{
+    ReadAheadIO *io = (ReadAheadIO *) ctx;
+    if (io->abortRequest)
+    {
+        return AVERROR_EXIT;
+    }
+    // I/O线程启动之后不跟随解复用上下文，解复用器定位被中断时预读继续
+    if (!io->started && io->outerInterrupt.callback)
+    {
+        return io->outerInterrupt.callback(io->outerInterrupt.opaque);
+    }
+    return 0;
+}
+
+int ReadAheadIO::readPacket(void *opaque, uint8_t *buf, int size)
+{
+    return ((ReadAheadIO *) opaque)->read(buf, size);
+}
+
+int64_t ReadAheadIO::seekPacket(void *opaque, int64_t offset, int whence)
+{
+    return ((ReadAheadIO *) opaque)->seek(offset, whence);
+}
+
+/**
+ * 从缓冲区中拷贝数据，缓冲区为空时等待I/O线程，等待期间检查解复用上下文的中断
+ * @param buf
+ * @param size
+ * @return 读出的字节数，结尾时返回AVERROR_EOF
+ */
+int ReadAheadIO::read(uint8_t *buf, int size)
+{
+    Mutex::Autolock lock(mMutex);
+    if (writePos <= readPos && !eof && !error)
+    {
+        TRACE_SCOPE("io_stall");
+        int64_t start = av_gettime_relative();
+        stats.stalls++;
+        while (writePos <= readPos && !eof && !error && !abortRequest)
+        {
+            if (outerInterrupt.callback && outerInterrupt.callback(outerInterrupt.opaque))
+            {
+                stats.stallTime += av_gettime_relative() - start;
+                return AVERROR_EXIT;
+            }
+            mDataCondition.waitRelative(mMutex, READ_AHEAD_WAIT_TIMEOUT * 1000000LL);
+        }
+        stats.stallTime += av_gettime_relative() - start;
+    }
+    if (writePos <= readPos)
+    {
+        if (error)
+        {
+            return error;
+        }
+        return abortRequest ? AVERROR_EXIT : AVERROR_EOF;
+    }
+
+    // 数据可能跨过环形缓冲区的末尾，分两段拷贝
+    int length = (int) FFMIN(size, writePos - readPos);
+    int64_t index = readPos % capacity;
+    int first = (int) FFMIN(length, capacity - index);
+    memcpy(buf, ring + index, (size_t) first);
+    if (length > first)
+    {
+        memcpy(buf + first, ring, (size_t) (length - first));
+    }
+    readPos += length;
+    mSpaceCondition.signal();
+    return length;
+}
+
+/**
+ * 目标在缓冲区范围内时只移动读位置，稍微超过预读位置时等待预读追上，否则清空缓冲区交给I/O线程定位
+ * @param offset
+ * @param whence
+ * @return 新的读位置
+ */
+int64_t ReadAheadIO::seek(int64_t offset, int whence)
+{
+    Mutex::Autolock lock(mMutex);
+    if (whence & AVSEEK_SIZE)
+    {
+        return fileSize >= 0 ? fileSize : AVERROR(ENOSYS);
+    }
+    int64_t target;
+    switch (whence & ~AVSEEK_FORCE)
+    {
+        case SEEK_SET:
+            target = offset;
+            break;
+
+        case SEEK_CUR:
+            target = readPos + offset;
+            break;
+
+        case SEEK_END:
+            if (fileSize < 0)
+            {
+                return AVERROR(ENOSYS);
+            }
+            target = fileSize + offset;
+            break;
+
+        default:
+            return AVERROR(EINVAL);
+    }
+    if (target < 0)
+    {
+        return AVERROR(EINVAL);
+    }
+
+    if (target >= bufferPos && target <= writePos + READ_AHEAD_CHUNK_SIZE && !error)
+    {
+        stats.bufferSeeks++;
+        readPos = target;
+        // 缓冲区满时I/O线程在等待空间，读位置前移之后可以丢弃更多旧数据
+        mSpaceCondition.signal();
+        return target;
+    }
+    if (!ioContext->seekable)
+    {
+        return AVERROR(ENOSYS);
+    }
+    stats.ioSeeks++;
+    generation++;
+    bufferPos = readPos = writePos = target;
+    seekTarget = target;
+    eof = 0;
+    error = 0;
+    mSpaceCondition.signal();
+    return target;
+}
+
+/**
+ * I/O线程，按块顺序读取，读取时不持有锁，读完之后如果缓冲区已经被清空则丢弃读出的数据
+ * 每次读取对齐到块大小的文件偏移，解复用器快要追上时改为小块读取，尽快交出数据
+ */
+void ReadAheadIO::run()
+{
+    TRACE_THREAD("read_ahead");
+    mMutex.lock();
+    while (!abortRequest)
+    {
+        // 执行底层定位
+        if (seekTarget >= 0)
+        {
+            int64_t target = seekTarget;
+            int currentGeneration = generation;
+            mMutex.unlock();
+            int64_t ret = seekSource(target);
+            mMutex.lock();
+            if (currentGeneration != generation)
+            {
+                continue;
+            }
+            seekTarget = -1;
+            if (ret < 0)
+            {
+                error = (int) ret;
+                mDataCondition.signal();
+            }
+            continue;
+        }
+
+        // 缓冲区满时丢弃读位置之前超出保留范围的数据
+        if (writePos - bufferPos >= capacity && readPos - backSize > bufferPos)
+        {
+            bufferPos = readPos - backSize;
+        }
+        int64_t space = capacity - (writePos - bufferPos);
+        if (eof || error || space <= 0)
+        {
+            mSpaceCondition.wait(mMutex);
+            continue;
+        }
+
+        int64_t chunk = writePos - readPos < READ_AHEAD_CHUNK_SIZE
+                        ? READ_AHEAD_SMALL_CHUNK_SIZE : READ_AHEAD_CHUNK_SIZE;
+        int length = (int) FFMIN(FFMIN(space, chunk - writePos % chunk),
+                                 capacity - writePos % capacity);
+        uint8_t *dst = ring + writePos % capacity;
+        int currentGeneration = generation;
+        mMutex.unlock();
+
+        TRACE_BEGIN("io_read");
+        int64_t start = av_gettime_relative();
+        int ret = readSource(dst, length);
+        int64_t elapsed = av_gettime_relative() - start;
+        TRACE_END("io_read");
+
+        mMutex.lock();
+        stats.readTime += elapsed;
+        if (currentGeneration != generation)
+        {
+            continue;
+        }
+        if (ret > 0)
+        {
+            writePos += ret;
+            stats.readBytes += ret;
+        }
+        else if (ret == 0 || ret == AVERROR_EOF)
+        {
+            eof = 1;
+        }
+        else if (ret != AVERROR_EXIT)
+        {
+            error = ret;
+        }
+        mDataCondition.signal();
+    }
+    mMutex.unlock();
+}
@@ -0,0 +1,140 @@
+#ifndef READAHEADIO_H
+#define READAHEADIO_H
+
+#include <stdint.h>
+#include <thread>
+#include <atomic>
+
+#include <Mutex.h>
+#include <Condition.h>
+
+extern "C" {
+#include <libavformat/avformat.h>
+};
+
+// 每次从文件或者网络读取的数据量，预读按这个大小对齐到文件偏移
+#define READ_AHEAD_CHUNK_SIZE (256 * 1024)
+
+// 消费者快要追上预读位置时每次读取的数据量，网络慢时尽快交出数据
+#define READ_AHEAD_SMALL_CHUNK_SIZE (32 * 1024)
+
+// 环形缓冲区的对齐
+#define READ_AHEAD_ALIGNMENT 4096
+
+// 解复用器使用的AVIOContext自身的缓冲大小
+#define READ_AHEAD_IO_BUFFER_SIZE (32 * 1024)
+
+// 消费者等待数据时检查中断的间隔(毫秒)
+#define READ_AHEAD_WAIT_TIMEOUT 10
+
+/**
+ * 预读统计
+ */
+typedef struct ReadAheadStats
+{
+    int64_t bufferedBytes;      // 读位置之后已经预读的数据量
+    int64_t readBytes;          // I/O线程读取的总数据量
+    int64_t readTime;           // I/O线程阻塞在读取上的总时长(微秒)
+    int64_t stalls;             // 解复用器读数据时缓冲区为空的次数
+    int64_t stallTime;          // 解复用器等待数据的总时长(微秒)
+    int64_t bufferSeeks;        // 目标在缓冲区内、不需要重新读取的定位次数
+    int64_t ioSeeks;            // 需要底层重新定位的次数
+} ReadAheadStats;
+
+/**
+ * 预读I/O层，替换解复用器默认的AVIOContext
+ * 专门的I/O线程按大块顺序读取，填充对齐分配的大环形缓冲区，解复用器的读操作只从缓冲区拷贝数据，
+ * 稳定播放时不会因为文件或者网络的阻塞而停止送包
+ * 环形缓冲区以文件偏移对容量取模作为下标，读位置之前保留一部分已经读过的数据，
+ * 目标在缓冲区范围内的定位只移动读位置，否则清空缓冲区，由I/O线程在底层定位之后重新预读
+ */
+class ReadAheadIO
+{
+public:
+    ReadAheadIO(int bufferSize);
+
+    virtual ~ReadAheadIO();
+
+    // 是否支持预读，只用于本地文件以及http渐进式下载，实时流和分片流不预读
+    static int isSupported(const char *url);
+
+    /**
+     * 打开底层的AVIOContext并启动I/O线程
+     * @param url
+     * @param interruptCallback 解复用上下文的中断回调，解复用器等待数据以及打开过程中检查
+     * @param options 协议参数，用过的参数会被移除
+     * @return 0表示成功
+     */
+    int open(const char *url, const AVIOInterruptCB *interruptCallback, AVDictionary **options);
+
+    // 停止I/O线程并关闭底层的AVIOContext
+    void close();
+
+    // 交给解复用上下文使用的AVIOContext，由本对象释放
+    AVIOContext *getContext();
+
+    // 获取预读统计
+    void getStats(ReadAheadStats *stats);
+
+protected:
+    /**
+     * 从底层读取数据，在I/O线程中不持有锁调用，子类可以替换以模拟慢速或者出错的数据源
+     * 子类必须在析构之前调用close()停止I/O线程
+     * @param buf
+     * @param size
+     * @return 读出的字节数，结尾时返回0或者AVERROR_EOF，出错返回负数
+     */
+    virtual int readSource(uint8_t *buf, int size);
+
+    /**
+     * 底层定位，在I/O线程中不持有锁调用
+     * @param pos 文件偏移
+     * @return 新的位置，出错返回负数
+     */
+    virtual int64_t seekSource(int64_t pos);
+
+private:
+    // I/O线程，按块读取数据填充缓冲区
+    void run();
+
+    // 解复用器读取数据
+    int read(uint8_t *buf, int size);
+
+    // 解复用器定位
+    int64_t seek(int64_t offset, int whence);
+
+    static int readPacket(void *opaque, uint8_t *buf, int size);
+
+    static int64_t seekPacket(void *opaque, int64_t offset, int whence);
+
+    // 底层AVIOContext的中断回调，打开过程中跟随解复用上下文，之后只在关闭时中断
+    static int interruptCallback(void *ctx);
+
+private:
+    Mutex mMutex;
+    Condition mDataCondition;           // 有新数据、读到结尾或者出错时唤醒解复用器
+    Condition mSpaceCondition;          // 有空闲空间或者定位时唤醒I/O线程
+    std::thread ioThread;               // I/O线程
+    std::atomic<int> abortRequest;      // 停止标志
+    std::atomic<int> started;           // I/O线程是否已经启动
+    AVIOInterruptCB outerInterrupt;     // 解复用上下文的中断回调
+
+    AVIOContext *innerContext;          // 底层的AVIOContext，启动之后只在I/O线程中使用
+    AVIOContext *ioContext;             // 交给解复用器的AVIOContext
+    int64_t fileSize;                   // 文件大小，未知时小于0
+
+    uint8_t *ring;                      // 环形缓冲区
+    int64_t capacity;                   // 环形缓冲区容量，读取块大小的整数倍
+    int64_t backSize;                   // 读位置之前保留的数据量
+    int64_t bufferPos;                  // 缓冲区中最早数据的文件偏移
+    int64_t readPos;                    // 解复用器的读位置
+    int64_t writePos;                   // 预读到的位置
+    int64_t seekTarget;                 // 等待I/O线程执行的底层定位，-1表示没有
+    int generation;                     // 每次清空缓冲区时递增，I/O线程丢弃清空之前读出的数据
+    int eof;                            // 预读到结尾
+    int error;                          // 底层读取或者定位出错
+
+    ReadAheadStats stats;
+};
+
+#endif //READAHEADIO_H
@@ -0,0 +1,501 @@
+#include "SeekIndex.h"
+#include "ProbeCache.h"
+#include "TraceRecorder.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+extern "C" {
+#include <libavutil/avstring.h>
+#include <libavutil/mem.h>
+#include <libavutil/time.h>
+};
+
+// 索引文件头的标识
+static const uint8_t SEEK_INDEX_MAGIC[4] = {'F', 'P', 'S', 'I'};
+
+/**
+ * 索引文件由变长整数组成，每个字节低7位为数据，最高位表示后面还有字节
+ * 时间戳的差值可能为负，先做zigzag编码
+ */
+static void writeVarint(std::vector<uint8_t> &buffer, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        buffer.push_back((uint8_t) (value | 0x80));
+        value >>= 7;
+    }
+    buffer.push_back((uint8_t) value);
+}
+
+static void writeSigned(std::vector<uint8_t> &buffer, int64_t value)
+{
+    writeVarint(buffer, ((uint64_t) value << 1) ^ (uint64_t) (value >> 63));
+}
+
+/**
+ * 读取变长整数
+ * @param data
+ * @param end
+ * @param value
+ * @return 0表示成功，小于0表示数据不完整
+ */
+static int readVarint(const uint8_t **data, const uint8_t *end, uint64_t *value)
+{
+    uint64_t result = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        if (*data >= end)
+        {
+            return -1;
+        }
+        uint8_t byte = *(*data)++;
+        result |= (uint64_t) (byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+        {
+            *value = result;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int readSigned(const uint8_t **data, const uint8_t *end, int64_t *value)
+{
+    uint64_t result;
+    if (readVarint(data, end, &result) < 0)
+    {
+        return -1;
+    }
+    *value = (int64_t) (result >> 1) ^ -(int64_t) (result & 1);
+    return 0;
+}
+
+SeekIndex::SeekIndex()
+{
+    streamIndex = -1;
+    codecId = AV_CODEC_ID_NONE;
+    timeBase = (AVRational) {1, AV_TIME_BASE};
+    minInterval = 0;
+    dirty = 0;
+    scanAbort = 0;
+    scanUrl = NULL;
+    scanFormat = NULL;
+}
+
+SeekIndex::~SeekIndex()
+{
+    close();
+}
+
+void SeekIndex::open(int streamIndex, AVStream *stream)
+{
+    close();
+    std::lock_guard<std::mutex> lock(mMutex);
+    this->streamIndex = streamIndex;
+    codecId = stream->codecpar->codec_id;
+    timeBase = stream->time_base;
+    minInterval = av_rescale_q(SEEK_INDEX_MIN_INTERVAL, AV_TIME_BASE_Q, timeBase);
+}
+
+void SeekIndex::close()
+{
+    stopScan();
+    std::lock_guard<std::mutex> lock(mMutex);
+    entries.clear();
+    streamIndex = -1;
+    dirty = 0;
+}
+
+int SeekIndex::isEnabled()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return streamIndex >= 0;
+}
+
+int SeekIndex::load(const char *path, const char *url, int64_t size, int64_t mtime)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+    {
+        return -1;
+    }
+    std::vector<uint8_t> buffer;
+    int ret = -1;
+    if (fseek(fp, 0, SEEK_END) == 0)
+    {
+        long length = ftell(fp);
+        if (length > 0 && length <= SEEK_INDEX_MAX_FILE_SIZE && fseek(fp, 0, SEEK_SET) == 0)
+        {
+            buffer.resize((size_t) length);
+            ret = fread(buffer.data(), 1, buffer.size(), fp) == buffer.size() ? 0 : -1;
+        }
+    }
+    fclose(fp);
+    if (ret < 0)
+    {
+        return -1;
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    const uint8_t *data = buffer.data();
+    const uint8_t *end = data + buffer.size();
+    uint64_t version, urlLength, codec, num, den, count;
+    int64_t fileSize, modifyTime;
+    std::vector<SeekIndexEntry> loaded;
+    do
+    {
+        ret = -1;
+        if (streamIndex < 0 || buffer.size() < sizeof(SEEK_INDEX_MAGIC)
+            || memcmp(data, SEEK_INDEX_MAGIC, sizeof(SEEK_INDEX_MAGIC)))
+        {
+            break;
+        }
+        data += sizeof(SEEK_INDEX_MAGIC);
+        if (readVarint(&data, end, &version) < 0 || version != SEEK_INDEX_VERSION
+            || readVarint(&data, end, &urlLength) < 0 || urlLength > (uint64_t) (end - data))
+        {
+            break;
+        }
+        // 文件名是url的哈希值，比较url排除哈希冲突
+        if (urlLength != strlen(url) || memcmp(data, url, (size_t) urlLength))
+        {
+            break;
+        }
+        data += urlLength;
+        if (readSigned(&data, end, &fileSize) < 0 || readSigned(&data, end, &modifyTime) < 0
+            || fileSize <= 0 || fileSize != size || modifyTime != mtime)
+        {
+            break;
+        }
+        if (readVarint(&data, end, &codec) < 0 || readVarint(&data, end, &num) < 0
+            || readVarint(&data, end, &den) < 0 || readVarint(&data, end, &count) < 0
+            || codec != (uint64_t) codecId || num != (uint64_t) timeBase.num
+            || den != (uint64_t) timeBase.den || count > SEEK_INDEX_MAX_ENTRIES)
+        {
+            break;
+        }
+        // 时间戳和位置都以与前一项的差值保存，位置差值的最低位是连续标志
+        loaded.reserve((size_t) count);
+        int64_t pts = 0;
+        int64_t pos = 0;
+        ret = 0;
+        for (uint64_t i = 0; i < count; ++i)
+        {
+            int64_t ptsDelta;
+            uint64_t posDelta;
+            if (readSigned(&data, end, &ptsDelta) < 0 || readVarint(&data, end, &posDelta) < 0)
+            {
+                ret = -1;
+                break;
+            }
+            SeekIndexEntry entry;
+            entry.pts = pts + ptsDelta;
+            entry.pos = pos + (int64_t) (posDelta >> 1);
+            entry.contiguous = (int) (posDelta & 1);
+            // 时间戳和位置必须同时递增
+            if (i > 0 && (entry.pts <= pts || entry.pos <= pos))
+            {
+                ret = -1;
+                break;
+            }
+            loaded.push_back(entry);
+            pts = entry.pts;
+            pos = entry.pos;
+        }
+    } while (false);
+
+    if (ret < 0 || data != end)
+    {
+        av_log(NULL, AV_LOG_INFO, "seek index miss: %s\n", url);
+        unlink(path);
+        return -1;
+    }
+    entries.swap(loaded);
+    dirty = 0;
+    av_log(NULL, AV_LOG_INFO, "seek index loaded: %d entries\n", (int) entries.size());
+    return 0;
+}
+
+/**
+ * 先写入临时文件再重命名，其他播放器不会读到写了一半的索引
+ */
+int SeekIndex::save(const char *path, const char *url, int64_t size, int64_t mtime)
+{
+    std::vector<uint8_t> buffer;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (streamIndex < 0 || !dirty || entries.empty() || size <= 0)
+        {
+            return -1;
+        }
+        buffer.insert(buffer.end(), SEEK_INDEX_MAGIC, SEEK_INDEX_MAGIC + sizeof(SEEK_INDEX_MAGIC));
+        writeVarint(buffer, SEEK_INDEX_VERSION);
+        size_t urlLength = strlen(url);
+        writeVarint(buffer, urlLength);
+        buffer.insert(buffer.end(), url, url + urlLength);
+        writeSigned(buffer, size);
+        writeSigned(buffer, mtime);
+        writeVarint(buffer, (uint64_t) codecId);
+        writeVarint(buffer, (uint64_t) timeBase.num);
+        writeVarint(buffer, (uint64_t) timeBase.den);
+        writeVarint(buffer, entries.size());
+        int64_t pts = 0;
+        int64_t pos = 0;
+        for (size_t i = 0; i < entries.size(); ++i)
+        {
+            writeSigned(buffer, entries[i].pts - pts);
+            writeVarint(buffer, ((uint64_t) (entries[i].pos - pos) << 1)
+                                | (entries[i].contiguous ? 1 : 0));
+            pts = entries[i].pts;
+            pos = entries[i].pos;
+        }
+        dirty = 0;
+    }
+
+    makeCacheDir(path);
+    char *tmpPath = av_asprintf("%s.%d.tmp", path, (int) getpid());
+    if (!tmpPath)
+    {
+        return AVERROR(ENOMEM);
+    }
+    FILE *fp = fopen(tmpPath, "wb");
+    if (!fp)
+    {
+        av_free(tmpPath);
+        return -1;
+    }
+    int ret = fwrite(buffer.data(), 1, buffer.size(), fp) == buffer.size() ? 0 : -1;
+    if (fclose(fp) != 0)
+    {
+        ret = -1;
+    }
+    if (ret == 0 && rename(tmpPath, path) != 0)
+    {
+        ret = -1;
+    }
+    if (ret < 0)
+    {
+        unlink(tmpPath);
+    }
+    av_free(tmpPath);
+    return ret;
+}
+
+void SeekIndex::addPacket(const AVPacket *pkt, int64_t *cursor)
+{
+    int64_t pts = pkt->pts == AV_NOPTS_VALUE ? pkt->dts : pkt->pts;
+    if (!(pkt->flags & AV_PKT_FLAG_KEY) || pkt->pos < 0 || pts == AV_NOPTS_VALUE)
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (pkt->stream_index == streamIndex)
+    {
+        insertEntry(pts, pkt->pos, cursor);
+    }
+}
+
+/**
+ * 按时间戳插入索引项，正常播放时总是追加在末尾或者命中已有的项
+ * 时间戳与字节位置的先后顺序不一致时(时间戳跳变)，不记录并且中断连续
+ * @param pts
+ * @param pos
+ * @param cursor
+ */
+void SeekIndex::insertEntry(int64_t pts, int64_t pos, int64_t *cursor)
+{
+    // 最后一个时间戳不大于pts的索引项
+    size_t count = entries.size();
+    size_t low = 0, high = count;
+    while (low < high)
+    {
+        size_t mid = (low + high) / 2;
+        if (entries[mid].pts <= pts)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    long prev = (long) low - 1;
+    int follows = *cursor != AV_NOPTS_VALUE && prev >= 0 && entries[prev].pts == *cursor;
+
+    // 已经记录过
+    if (prev >= 0 && entries[prev].pts == pts && entries[prev].pos == pos)
+    {
+        if (*cursor != AV_NOPTS_VALUE && prev > 0 && entries[prev - 1].pts == *cursor
+            && !entries[prev].contiguous)
+        {
+            entries[prev].contiguous = 1;
+            dirty = 1;
+        }
+        *cursor = pts;
+        return;
+    }
+    if ((prev >= 0 && entries[prev].pos >= pos) || (low < count && entries[low].pos <= pos))
+    {
+        *cursor = AV_NOPTS_VALUE;
+        return;
+    }
+    // 离前一项太近时不记录，前一项仍然是这里之前最近的索引点，连续状态不变
+    if (prev >= 0 && pts - entries[prev].pts < minInterval)
+    {
+        return;
+    }
+    if (count >= SEEK_INDEX_MAX_ENTRIES)
+    {
+        return;
+    }
+    SeekIndexEntry entry;
+    entry.pts = pts;
+    entry.pos = pos;
+    entry.contiguous = follows;
+    entries.insert(entries.begin() + low, entry);
+    dirty = 1;
+    *cursor = pts;
+}
+
+int SeekIndex::lookup(int64_t target, int64_t *pos, int64_t *time)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (streamIndex < 0 || entries.size() < 2)
+    {
+        return -1;
+    }
+    int64_t pts = av_rescale_q(target, AV_TIME_BASE_Q, timeBase);
+    size_t low = 0, high = entries.size();
+    while (low < high)
+    {
+        size_t mid = (low + high) / 2;
+        if (entries[mid].pts <= pts)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    // 目标必须落在两个连续读出的索引项之间，否则两者之间可能还有没有记录的关键帧
+    if (low == 0 || low >= entries.size() || !entries[low].contiguous)
+    {
+        return -1;
+    }
+    *pos = entries[low - 1].pos;
+    *time = av_rescale_q(entries[low - 1].pts, timeBase, AV_TIME_BASE_Q);
+    return 0;
+}
+
+int SeekIndex::getEntryCount()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return (int) entries.size();
+}
+
+void SeekIndex::startScan(const char *url, AVInputFormat *iformat)
+{
+    stopScan();
+    if (!isEnabled())
+    {
+        return;
+    }
+    scanUrl = av_strdup(url);
+    scanFormat = iformat;
+    scanAbort = 0;
+    scanThread = std::thread(&SeekIndex::scan, this);
+}
+
+void SeekIndex::stopScan()
+{
+    scanAbort = 1;
+    if (scanThread.joinable())
+    {
+        scanThread.join();
+    }
+    av_freep(&scanUrl);
+    scanFormat = NULL;
+}
+
+int SeekIndex::interruptCallback(void *ctx)
+{
+    SeekIndex *index = (SeekIndex *) ctx;
+    return index->scanAbort ? AVERROR_EXIT : 0;
+}
+
+/**
+ * 后台扫描，用单独的解复用上下文从索引最后一项的位置读到文件结尾
+ * 只解析索引媒体流，其他媒体流丢弃，线程降低优先级，定期让出CPU，不影响播放
+ */
+void SeekIndex::scan()
+{
+    TRACE_THREAD("index_scan");
+    setpriority(PRIO_PROCESS, 0, SEEK_INDEX_SCAN_NICE);
+
+    int64_t startPos = 0;
+    int index;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!entries.empty())
+        {
+            startPos = entries.back().pos;
+        }
+        index = streamIndex;
+    }
+
+    AVFormatContext *ic = avformat_alloc_context();
+    if (!ic)
+    {
+        return;
+    }
+    ic->interrupt_callback.callback = interruptCallback;
+    ic->interrupt_callback.opaque = this;
+    if (avformat_open_input(&ic, scanUrl, scanFormat, NULL) < 0)
+    {
+        return;
+    }
+    if (startPos > 0)
+    {
+        avformat_seek_file(ic, -1, INT64_MIN, startPos, INT64_MAX, AVSEEK_FLAG_BYTE);
+    }
+
+    int64_t startTime = av_gettime_relative();
+    int64_t cursor = AV_NOPTS_VALUE;
+    int packets = 0;
+    AVPacket pkt;
+    av_init_packet(&pkt);
+    while (!scanAbort)
+    {
+        if (av_read_frame(ic, &pkt) < 0)
+        {
+            break;
+        }
+        // 读包时才出现媒体流的格式，扫描时的媒体流需要与播放时的媒体流一致
+        AVStream *st = ic->streams[pkt.stream_index];
+        if (pkt.stream_index == index)
+        {
+            if (st->codecpar->codec_id != codecId || av_cmp_q(st->time_base, timeBase))
+            {
+                av_packet_unref(&pkt);
+                break;
+            }
+            addPacket(&pkt, &cursor);
+        }
+        else
+        {
+            st->discard = AVDISCARD_ALL;
+        }
+        av_packet_unref(&pkt);
+        if (++packets % SEEK_INDEX_SCAN_BATCH == 0)
+        {
+            av_usleep(SEEK_INDEX_SCAN_SLEEP);
+        }
+    }
+    avformat_close_input(&ic);
+    av_log(NULL, AV_LOG_INFO, "seek index scan: %d entries, %.2f s\n", getEntryCount(),
+           (av_gettime_relative() - startTime) / 1000000.0);
+}
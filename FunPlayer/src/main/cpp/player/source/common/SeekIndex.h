@@ -0,0 +1,143 @@
+#ifndef SEEKINDEX_H
+#define SEEKINDEX_H
+
+#include <stdint.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+
+extern "C" {
+#include <libavformat/avformat.h>
+};
+
+// 索引文件格式版本，格式变化时增加，旧版本的索引直接丢弃
+#define SEEK_INDEX_VERSION 1
+
+// 相邻两个索引项的最小时间间隔(微秒)，间隔更小的关键帧不记录，控制索引的大小
+#define SEEK_INDEX_MIN_INTERVAL 500000
+
+// 索引项的最大数量，超过时不再记录
+#define SEEK_INDEX_MAX_ENTRIES (1 << 20)
+
+// 索引文件的最大长度
+#define SEEK_INDEX_MAX_FILE_SIZE (16 * 1024 * 1024)
+
+// 后台扫描线程的nice值，只在空闲时占用CPU和IO
+#define SEEK_INDEX_SCAN_NICE 10
+
+// 后台扫描每读出这么多数据包让出一次CPU
+#define SEEK_INDEX_SCAN_BATCH 256
+
+// 后台扫描让出CPU的时长(微秒)
+#define SEEK_INDEX_SCAN_SLEEP 2000
+
+/**
+ * 索引项
+ */
+typedef struct SeekIndexEntry
+{
+    int64_t pts;        // 关键帧的时间戳(媒体流的时间基)
+    int64_t pos;        // 关键帧数据包在文件中的字节位置
+    int contiguous;     // 与前一项之间的数据是否连续读出过，即两者之间没有别的关键帧
+} SeekIndexEntry;
+
+/**
+ * 关键帧索引，用于mpegts等没有索引、按时间定位又慢又不准的格式
+ * 读包线程把读出的关键帧的时间戳和字节位置按时间顺序记录下来，可选的后台线程用另外的解复用上下文
+ * 从已经记录的最后位置向后扫描补全索引
+ * 每一项记录与前一项之间是否连续读出过，定位目标落在两个连续的索引项之间时，前一项就是目标之前最近的关键帧，
+ * 以字节方式定位到它的位置，二分查找，不需要解复用器按时间戳逐步逼近
+ * 索引以紧凑的二进制格式保存在探测结果缓存的目录中，再次打开同一个文件时直接使用
+ * 读包线程和扫描线程同时访问，加锁
+ */
+class SeekIndex
+{
+public:
+    SeekIndex();
+
+    virtual ~SeekIndex();
+
+    /**
+     * 开始为媒体流建立索引，清空之前的索引
+     * @param streamIndex 记录关键帧的媒体流，有视频流时为视频流，否则为音频流
+     * @param stream
+     */
+    void open(int streamIndex, AVStream *stream);
+
+    // 停止扫描并清空索引
+    void close();
+
+    // 是否开启索引
+    int isEnabled();
+
+    /**
+     * 读取索引文件，需要在open之后调用，文件与当前文件或者媒体流不一致时删除
+     * @param path 索引文件路径
+     * @param url 文件路径
+     * @param size 文件大小
+     * @param mtime 本地文件的修改时间
+     * @return 0表示成功
+     */
+    int load(const char *path, const char *url, int64_t size, int64_t mtime);
+
+    /**
+     * 保存索引文件，索引没有变化时不保存
+     * @return 0表示成功
+     */
+    int save(const char *path, const char *url, int64_t size, int64_t mtime);
+
+    /**
+     * 记录读出的数据包，只记录索引媒体流中带时间戳和字节位置的关键帧
+     * @param pkt
+     * @param cursor 调用者连续读出的最后一个索引项的时间戳，解复用器定位之后置为AV_NOPTS_VALUE
+     */
+    void addPacket(const AVPacket *pkt, int64_t *cursor);
+
+    /**
+     * 查找目标之前最近的关键帧
+     * @param target 定位目标(AV_TIME_BASE)
+     * @param pos 关键帧的字节位置
+     * @param time 关键帧的时间(AV_TIME_BASE)
+     * @return 0表示找到，小于0表示目标不在索引连续覆盖的范围内
+     */
+    int lookup(int64_t target, int64_t *pos, int64_t *time);
+
+    // 索引项的数量
+    int getEntryCount();
+
+    /**
+     * 启动后台扫描线程，从索引中最后一项的位置开始扫描到文件结尾
+     * @param url 文件路径
+     * @param iformat 解复用器，跳过格式探测
+     */
+    void startScan(const char *url, AVInputFormat *iformat);
+
+    // 停止后台扫描线程
+    void stopScan();
+
+private:
+    // 后台扫描线程
+    void scan();
+
+    // 插入索引项，需要持有锁
+    void insertEntry(int64_t pts, int64_t pos, int64_t *cursor);
+
+    static int interruptCallback(void *ctx);
+
+private:
+    std::mutex mMutex;
+    std::vector<SeekIndexEntry> entries;
+    int streamIndex;                // 记录关键帧的媒体流，-1表示不记录
+    enum AVCodecID codecId;         // 媒体流的编码类型，校验索引文件和扫描时的媒体流
+    AVRational timeBase;            // 媒体流的时间基
+    int64_t minInterval;            // 相邻索引项的最小间隔(媒体流的时间基)
+    int dirty;                      // 索引是否有变化，需要保存
+
+    std::thread scanThread;         // 后台扫描线程
+    std::atomic<int> scanAbort;     // 停止扫描
+    char *scanUrl;
+    AVInputFormat *scanFormat;
+};
+
+#endif //SEEKINDEX_H
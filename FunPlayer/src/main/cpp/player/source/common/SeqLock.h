@@ -0,0 +1,121 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <atomic>
+#include <thread>
+#include <string.h>
+#include <stdint.h>
+
+/**
+ * 双缓冲顺序锁，发布可以平凡复制的状态结构体，任意线程不加锁读取一致的快照
+ * 状态保存两份，更新总是写入当前没有发布的一份，写完之后切换发布的下标，
+ * 读取方只读已经发布的一份，不会等待正在进行的更新
+ * 只有读取期间完成了一次更新并且又开始了下一次更新，读到的那一份才会被覆盖，此时按顺序号检测出来重新读取
+ * 更新之间通过标志互斥，每次更新只有几次赋值
+ * 数据按机器字以relaxed原子操作复制，读写并发时没有数据竞争
+ */
+template<typename T>
+class SeqLock
+{
+public:
+    SeqLock()
+    {
+        writing.clear();
+        current.store(0, std::memory_order_relaxed);
+        T value;
+        memset(&value, 0, sizeof(T));
+        for (int i = 0; i < 2; ++i)
+        {
+            slots[i].sequence.store(0, std::memory_order_relaxed);
+            slots[i].store(&value);
+        }
+    }
+
+    /**
+     * 读取最近发布的状态
+     * @param value
+     */
+    void read(T *value) const
+    {
+        for (;;)
+        {
+            const Slot *slot = &slots[current.load(std::memory_order_acquire)];
+            unsigned int begin = slot->sequence.load(std::memory_order_acquire);
+            if (begin & 1)
+            {
+                // 读取下标之后又完成了一次更新，这一份正在被覆盖，最新的一份已经发布
+                continue;
+            }
+            slot->load(value);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot->sequence.load(std::memory_order_relaxed) == begin)
+            {
+                return;
+            }
+        }
+    }
+
+    /**
+     * 以当前发布的状态为基础更新，update在持有更新标志时调用，参数是可以直接修改的状态副本
+     * @param update
+     */
+    template<typename Update>
+    void write(Update update)
+    {
+        while (writing.test_and_set(std::memory_order_acquire))
+        {
+            std::this_thread::yield();
+        }
+        int index = current.load(std::memory_order_relaxed);
+        T value;
+        slots[index].load(&value);
+        update(value);
+
+        // 写入没有发布的一份，顺序号为奇数期间读取方不会使用它
+        Slot *slot = &slots[index ^ 1];
+        unsigned int seq = slot->sequence.load(std::memory_order_relaxed);
+        slot->sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot->store(&value);
+        slot->sequence.store(seq + 2, std::memory_order_release);
+        current.store(index ^ 1, std::memory_order_release);
+
+        writing.clear(std::memory_order_release);
+    }
+
+private:
+    // 状态占用的机器字数
+    static const int WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    struct Slot
+    {
+        std::atomic<unsigned int> sequence;     // 顺序号，奇数表示正在写入
+        std::atomic<uint64_t> words[WORDS];
+
+        void load(T *value) const
+        {
+            uint64_t buffer[WORDS];
+            for (int i = 0; i < WORDS; ++i)
+            {
+                buffer[i] = words[i].load(std::memory_order_relaxed);
+            }
+            memcpy(value, buffer, sizeof(T));
+        }
+
+        void store(const T *value)
+        {
+            uint64_t buffer[WORDS] = {0};
+            memcpy(buffer, value, sizeof(T));
+            for (int i = 0; i < WORDS; ++i)
+            {
+                words[i].store(buffer[i], std::memory_order_relaxed);
+            }
+        }
+    };
+
+    Slot slots[2];
+    std::atomic<int> current;       // 已经发布的一份的下标
+    std::atomic_flag writing;       // 更新标志，更新之间互斥
+};
+
+#endif //SEQLOCK_H
@@ -0,0 +1,263 @@
+#include "TraceRecorder.h"
+
+#include <stdio.h>
+#include <unistd.h>
+#include <Mutex.h>
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
+extern "C" {
+#include <libavutil/time.h>
+};
+
+/**
+ * 跟踪事件，字段使用relaxed原子操作，导出线程读取时不会与写入线程产生数据竞争
+ */
+typedef struct TraceEvent
+{
+    std::atomic<const char *> name;
+    std::atomic<int64_t> timestamp;
+    std::atomic<int64_t> arg;
+    std::atomic<char> phase;
+} TraceEvent;
+
+/**
+ * 线程的事件缓冲区，只有所属线程写入
+ */
+typedef struct TraceBuffer
+{
+    TraceEvent *events;
+    uint32_t capacity;
+    std::atomic<uint32_t> writeIndex;       // 已写入的事件总数
+    std::atomic<const char *> threadName;   // 线程名称
+    int tid;                                // 线程id
+    int inUse;                              // 是否被存活的线程占用，由bufferMutex保护
+    TraceBuffer *next;
+} TraceBuffer;
+
+/**
+ * 线程退出时释放缓冲区的占用，缓冲区本身保留给之后的线程复用
+ */
+class TraceBufferHolder
+{
+public:
+    TraceBufferHolder() : buffer(NULL), threadName(NULL)
+    {
+    }
+
+    ~TraceBufferHolder();
+
+    TraceBuffer *buffer;
+    const char *threadName;
+};
+
+std::atomic<bool> TraceRecorder::enabled(false);
+
+static Mutex bufferMutex;
+static TraceBuffer *bufferList = NULL;
+static int bufferCapacity = TRACE_DEFAULT_CAPACITY;
+static int startCount = 0;
+static std::atomic<int64_t> traceStartTime(0);
+static thread_local TraceBufferHolder threadBuffer;
+
+TraceBufferHolder::~TraceBufferHolder()
+{
+    if (buffer != NULL)
+    {
+        Mutex::Autolock lock(bufferMutex);
+        buffer->inUse = 0;
+    }
+}
+
+static int getThreadId()
+{
+#if defined(__linux__)
+    return (int) syscall(SYS_gettid);
+#else
+    static std::atomic<int> nextId(1);
+    return nextId++;
+#endif
+}
+
+/**
+ * 获取当前线程的缓冲区，优先复用已退出线程的缓冲区
+ * @return
+ */
+static TraceBuffer *acquireBuffer()
+{
+    Mutex::Autolock lock(bufferMutex);
+    TraceBuffer *buffer = bufferList;
+    while (buffer != NULL && (buffer->inUse || buffer->capacity != (uint32_t) bufferCapacity))
+    {
+        buffer = buffer->next;
+    }
+    if (buffer == NULL)
+    {
+        buffer = new TraceBuffer();
+        buffer->capacity = (uint32_t) bufferCapacity;
+        buffer->events = new TraceEvent[buffer->capacity];
+        buffer->next = bufferList;
+        bufferList = buffer;
+    }
+    buffer->writeIndex.store(0, std::memory_order_relaxed);
+    buffer->threadName.store(threadBuffer.threadName, std::memory_order_relaxed);
+    buffer->tid = getThreadId();
+    buffer->inUse = 1;
+    return buffer;
+}
+
+/**
+ * 开始记录，第一个使用者开始时记录起始时间，之后的使用者不影响已经记录的事件
+ * @param capacity
+ */
+void TraceRecorder::start(int capacity)
+{
+    Mutex::Autolock lock(bufferMutex);
+    bufferCapacity = capacity > 0 ? capacity : TRACE_DEFAULT_CAPACITY;
+    if (startCount++ == 0)
+    {
+        traceStartTime.store(av_gettime_relative(), std::memory_order_relaxed);
+        enabled.store(true, std::memory_order_release);
+    }
+}
+
+/**
+ * 停止记录，最后一个使用者停止时释放没有被存活线程占用的缓冲区
+ * 存活线程的缓冲区仍然由线程持有，线程退出之后留到下一次开始时复用
+ */
+void TraceRecorder::stop()
+{
+    Mutex::Autolock lock(bufferMutex);
+    if (startCount == 0 || --startCount > 0)
+    {
+        return;
+    }
+    enabled.store(false, std::memory_order_release);
+    TraceBuffer **link = &bufferList;
+    while (*link != NULL)
+    {
+        TraceBuffer *buffer = *link;
+        if (buffer->inUse)
+        {
+            link = &buffer->next;
+            continue;
+        }
+        *link = buffer->next;
+        delete[] buffer->events;
+        delete buffer;
+    }
+}
+
+void TraceRecorder::setThreadName(const char *name)
+{
+    threadBuffer.threadName = name;
+    if (threadBuffer.buffer != NULL)
+    {
+        threadBuffer.buffer->threadName.store(name, std::memory_order_relaxed);
+    }
+}
+
+void TraceRecorder::addEvent(char phase, const char *name, int64_t arg)
+{
+    TraceBuffer *buffer = threadBuffer.buffer;
+    if (buffer == NULL)
+    {
+        buffer = threadBuffer.buffer = acquireBuffer();
+    }
+    uint32_t index = buffer->writeIndex.load(std::memory_order_relaxed);
+    TraceEvent *event = &buffer->events[index % buffer->capacity];
+    event->name.store(name, std::memory_order_relaxed);
+    event->timestamp.store(av_gettime_relative(), std::memory_order_relaxed);
+    event->arg.store(arg, std::memory_order_relaxed);
+    event->phase.store(phase, std::memory_order_relaxed);
+    buffer->writeIndex.store(index + 1, std::memory_order_release);
+}
+
+/**
+ * 导出一个线程的事件，导出过程中被写入线程覆盖的事件会丢弃
+ * @param fp
+ * @param buffer
+ * @param pid
+ * @param startTime
+ * @param first 是否是第一个事件，用于输出分隔符
+ * @return 导出的事件数
+ */
+static int dumpBuffer(FILE *fp, TraceBuffer *buffer, int pid, int64_t startTime, bool *first)
+{
+    uint32_t end = buffer->writeIndex.load(std::memory_order_acquire);
+    uint32_t begin = end > buffer->capacity ? end - buffer->capacity : 0;
+    int count = 0;
+
+    const char *threadName = buffer->threadName.load(std::memory_order_relaxed);
+    if (threadName != NULL)
+    {
+        fprintf(fp, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+                    "\"args\":{\"name\":\"%s\"}}", *first ? "" : ",", pid, buffer->tid, threadName);
+        *first = false;
+    }
+
+    for (uint32_t i = begin; i != end; ++i)
+    {
+        TraceEvent *event = &buffer->events[i % buffer->capacity];
+        const char *name = event->name.load(std::memory_order_relaxed);
+        int64_t timestamp = event->timestamp.load(std::memory_order_relaxed);
+        int64_t arg = event->arg.load(std::memory_order_relaxed);
+        char phase = event->phase.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        // 读取期间写入线程已经绕回覆盖了这个位置，写入计数等于i + capacity时正在写入这个位置
+        uint32_t current = buffer->writeIndex.load(std::memory_order_relaxed);
+        if (current - i >= buffer->capacity)
+        {
+            continue;
+        }
+        if (timestamp < startTime)
+        {
+            continue;
+        }
+        fprintf(fp, "%s\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%lld,\"pid\":%d,\"tid\":%d",
+                *first ? "" : ",", name, phase, (long long) (timestamp - startTime), pid,
+                buffer->tid);
+        if (phase == 'i')
+        {
+            fprintf(fp, ",\"s\":\"t\"");
+        }
+        if (arg != TRACE_NO_ARG)
+        {
+            fprintf(fp, ",\"args\":{\"value\":%lld}", (long long) arg);
+        }
+        fprintf(fp, "}");
+        *first = false;
+        count++;
+    }
+    return count;
+}
+
+int TraceRecorder::dump(const char *path)
+{
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL)
+    {
+        return -1;
+    }
+    int pid = (int) getpid();
+    int64_t startTime = traceStartTime.load(std::memory_order_relaxed);
+    int count = 0;
+    bool first = true;
+
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    bufferMutex.lock();
+    for (TraceBuffer *buffer = bufferList; buffer != NULL; buffer = buffer->next)
+    {
+        count += dumpBuffer(fp, buffer, pid, startTime, &first);
+    }
+    bufferMutex.unlock();
+    fprintf(fp, "\n]}\n");
+
+    if (fclose(fp) != 0)
+    {
+        return -1;
+    }
+    return count;
+}
@@ -0,0 +1,110 @@
+#ifndef TRACERECORDER_H
+#define TRACERECORDER_H
+
+#include <atomic>
+#include <stdint.h>
+
+// 事件跟踪开关，编译时定义为0则跟踪代码全部去掉
+#ifndef PLAYER_TRACE
+#define PLAYER_TRACE 1
+#endif
+
+// 每个线程默认缓存的事件数
+#define TRACE_DEFAULT_CAPACITY 16384
+
+// 没有参数的事件
+#define TRACE_NO_ARG INT64_MIN
+
+/**
+ * 事件跟踪记录器，输出 Chrome trace event 格式的JSON文件，可以用 chrome://tracing 或者 Perfetto 打开
+ * 每个线程第一次记录时分配一个只有本线程写入的环形缓冲区，写入不加锁，缓冲区满时覆盖最旧的事件
+ * 线程退出后缓冲区保留到下一个新线程复用，导出时包含已退出线程的事件
+ * 事件名称必须是字符串常量，记录时只保存指针
+ * 记录器是进程全局的，多个播放器实例的事件写入同一份跟踪数据，开始和停止按引用计数配对，
+ * 最后一个使用者停止时关闭记录，并释放已退出线程的缓冲区
+ */
+class TraceRecorder
+{
+public:
+    // 开始记录，capacity为每个线程缓存的事件数，只对之后新分配的缓冲区生效，需要与stop配对调用
+    static void start(int capacity = TRACE_DEFAULT_CAPACITY);
+
+    // 停止记录，最后一个使用者停止时关闭记录，已退出线程的事件随缓冲区一起释放
+    static void stop();
+
+    // 是否正在记录
+    static bool isEnabled()
+    {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    // 设置当前线程的名称，在导出的文件中显示为线程名
+    static void setThreadName(const char *name);
+
+    // 记录一个事件，phase为'B'开始、'E'结束、'i'瞬时事件
+    static void addEvent(char phase, const char *name, int64_t arg = TRACE_NO_ARG);
+
+    // 把开始记录以来的事件导出到文件，返回导出的事件数，失败返回负数
+    static int dump(const char *path);
+
+private:
+    static std::atomic<bool> enabled;
+};
+
+/**
+ * 作用域跟踪，构造时记录开始事件，析构时记录结束事件
+ */
+class TraceScope
+{
+public:
+    TraceScope(const char *name, int64_t arg = TRACE_NO_ARG)
+    {
+        this->name = name;
+        recording = TraceRecorder::isEnabled();
+        if (recording)
+        {
+            TraceRecorder::addEvent('B', name, arg);
+        }
+    }
+
+    ~TraceScope()
+    {
+        if (recording)
+        {
+            TraceRecorder::addEvent('E', name);
+        }
+    }
+
+private:
+    const char *name;
+    bool recording;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+#if PLAYER_TRACE
+// 设置线程名称
+#define TRACE_THREAD(name) TraceRecorder::setThreadName(name)
+// 跟踪当前作用域
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+// 跟踪当前作用域，附带一个整数参数
+#define TRACE_SCOPE_ARG(name, arg) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name, arg)
+// 瞬时事件
+#define TRACE_INSTANT(name, arg) \
+    do { if (TraceRecorder::isEnabled()) TraceRecorder::addEvent('i', name, arg); } while (0)
+// 开始、结束事件，用于不能用作用域表示的区间
+#define TRACE_BEGIN(name) \
+    do { if (TraceRecorder::isEnabled()) TraceRecorder::addEvent('B', name); } while (0)
+#define TRACE_END(name) \
+    do { if (TraceRecorder::isEnabled()) TraceRecorder::addEvent('E', name); } while (0)
+#else
+#define TRACE_BEGIN(name)
+#define TRACE_END(name)
+#define TRACE_THREAD(name)
+#define TRACE_SCOPE(name)
+#define TRACE_SCOPE_ARG(name, arg)
+#define TRACE_INSTANT(name, arg)
+#endif
+
+#endif //TRACERECORDER_H
@@ -14,10 +14,20 @@ AudioResampler::AudioResampler(PlayerState *playerState, AudioDecoder *audioDeco
     memset(audioState, 0, sizeof(AudioState));
     soundTouchWrapper = new SoundTouchWrapper();
     frame = av_frame_alloc();
+    abortRequest = true;
+    ringBuffer = NULL;
+    targetSize = 0;
+    clockBase.write([](AudioClockBase &clock)
+                    {
+                        clock.base = NAN;
+                        clock.lastBase = NAN;
+                    });
+    underrun = true;
 }
 
 AudioResampler::~AudioResampler()
 {
+    stop();
     playerState = NULL;
     audioDecoder = NULL;
     mediaSync = NULL;
@@ -40,6 +50,11 @@ AudioResampler::~AudioResampler()
         av_frame_free(&frame);
         frame = NULL;
     }
+    if (ringBuffer)
+    {
+        delete ringBuffer;
+        ringBuffer = NULL;
+    }
 }
 
 int AudioResampler::setResampleParams(AudioDeviceSpec *spec, int64_t wanted_channel_layout)
@@ -47,8 +62,6 @@ int AudioResampler::setResampleParams(AudioDeviceSpec *spec, int64_t wanted_chan
 
     audioState->audioParamsSrc = audioState->audioParamsTarget;
     audioState->audio_hw_buf_size = spec->size;
-    audioState->bufferSize = 0;
-    audioState->bufferIndex = 0;
     audioState->audio_diff_avg_coef = exp(log(0.01) / AUDIO_DIFF_AVG_NB);
     audioState->audio_diff_avg_count = 0;
     audioState->audio_diff_threshold =
@@ -75,67 +88,231 @@ int AudioResampler::setResampleParams(AudioDeviceSpec *spec, int64_t wanted_chan
         av_log(NULL, AV_LOG_ERROR, "av_samples_get_buffer_size failed\n");
         return -1;
     }
+
+    // 创建PCM环形缓冲区，容量为填充目标的两倍，保证解码一帧写入时不需要等待
+    int frameSize = audioState->audioParamsTarget.frame_size;
+    targetSize = (int) ((int64_t) audioState->audioParamsTarget.bytes_per_sec
+                        * FFMAX(playerState->audioBufferTime, AUDIO_MIN_BUFFER_TIME) / 1000);
+    targetSize = FFMAX(targetSize / frameSize, 1) * frameSize;
+    if (ringBuffer)
+    {
+        delete ringBuffer;
+    }
+    ringBuffer = new AudioRingBuffer(targetSize * 2);
+    // 新的缓冲区从0开始计数，之前的基准不再有效
+    clockBase.write([](AudioClockBase &clock)
+                    {
+                        clock.base = NAN;
+                        clock.start = 0;
+                        clock.lastBase = NAN;
+                        clock.lastStart = 0;
+                    });
     return 0;
 }
 
-void AudioResampler::pcmQueueCallback(uint8_t *stream, int len)
+void AudioResampler::start()
 {
-    int bufferSize, length;
-
-    // 没有音频解码器时，直接返回
-    if (!audioDecoder)
+    mMutex.lock();
+    if (!abortRequest || !ringBuffer)
     {
-        memset(stream, 0, len);
+        mMutex.unlock();
         return;
     }
+    abortRequest = false;
+    mMutex.unlock();
+    resampleThread = std::thread(&AudioResampler::run, this);
+}
 
-    audioState->audio_callback_time = av_gettime_relative();
-    while (len > 0)
+int AudioResampler::getBufferedSize()
+{
+    return ringBuffer ? ringBuffer->getSize() : 0;
+}
+
+void AudioResampler::stop()
+{
+    mMutex.lock();
+    abortRequest = true;
+    mCondition.signal();
+    mMutex.unlock();
+    if (resampleThread.joinable())
     {
-        if (audioState->bufferIndex >= audioState->bufferSize)
+        resampleThread.join();
+    }
+}
+
+/**
+ * 解码重采样线程，缓冲区的数据低于填充目标时解码重采样一帧音频写入缓冲区
+ */
+void AudioResampler::run()
+{
+    int lastSerial = -1;
+    int bufferSize;
+
+    TRACE_THREAD("audio_decode");
+    while (true)
+    {
+        // 暂停或者缓冲区达到填充目标时等待音频回调消耗数据
+        mMutex.lock();
+        while (!abortRequest && (playerState->abortRequest || playerState->pauseRequest
+                                 || ringBuffer->getSize() >= targetSize))
         {
-            bufferSize = audioFrameResample();
-            if (bufferSize < 0)
-            {
-                audioState->outputBuffer = NULL;
-                audioState->bufferSize = (unsigned int) (AUDIO_MIN_BUFFER_SIZE /
-                                                         audioState->audioParamsTarget.frame_size
-                                                         *
-                                                         audioState->audioParamsTarget.frame_size);
-            }
-            else
+            mCondition.waitRelative(mMutex, AUDIO_RESAMPLE_WAIT_TIMEOUT * 1000000LL);
+        }
+        if (abortRequest)
+        {
+            mMutex.unlock();
+            break;
+        }
+        mMutex.unlock();
+
+        int serial = audioDecoder->getPacketSerial();
+        bufferSize = audioFrameResample();
+        if (bufferSize < 0)
+        {
+            // 解码器已经停止，等待退出
+            mMutex.lock();
+            if (!abortRequest)
             {
-                audioState->bufferSize = bufferSize;
+                mCondition.waitRelative(mMutex, AUDIO_RESAMPLE_WAIT_TIMEOUT * 1000000LL);
             }
-            audioState->bufferIndex = 0;
+            mMutex.unlock();
+            continue;
         }
 
-        length = audioState->bufferSize - audioState->bufferIndex;
-        if (length > len)
+        // 解码过程中发生了定位，丢弃旧的数据
+        if (serial != audioDecoder->getPacketSerial())
+        {
+            continue;
+        }
+        // 更新缓冲区起点对应的时钟，回调时根据读位置计算正在播放的时钟
+        // audioClock是这一帧结束的时钟，对应这一帧写完之后的写入位置
+        int64_t writePos = ringBuffer->getWritePosition();
+        double base = NAN;
+        if (!isnan(audioState->audioClock))
+        {
+            base = audioState->audioClock - (double) (writePos + bufferSize)
+                                            / audioState->audioParamsTarget.bytes_per_sec;
+        }
+        // 定位之后的第一帧，从丢弃位置开始新的一段基准
+        bool discard = serial != lastSerial;
+        // 先发布基准再丢弃和写入，回调读到新数据时一定能看到对应的基准，读到旧数据时仍然使用旧的基准
+        clockBase.write([base, writePos, discard](AudioClockBase &clock)
+                        {
+                            if (discard)
+                            {
+                                clock.lastBase = clock.base;
+                                clock.lastStart = clock.start;
+                                clock.start = writePos;
+                            }
+                            clock.base = base;
+                        });
+
+        // 定位之后的第一帧，丢弃缓冲区中定位之前的数据
+        if (discard)
+        {
+            ringBuffer->discard();
+            lastSerial = serial;
+            playerState->markSeekPresented(serial, 1);
+        }
+
+        if (writeBuffer(audioState->outputBuffer, bufferSize) < 0)
+        {
+            break;
+        }
+    }
+}
+
+/**
+ * 将PCM数据写入环形缓冲区
+ * @param data
+ * @param size
+ * @return 写入的字节数，停止时返回-1
+ */
+int AudioResampler::writeBuffer(const uint8_t *data, int size)
+{
+    int written = 0;
+    while (written < size)
+    {
+        int length = ringBuffer->write(data + written, size - written);
+        written += length;
+        if (length == 0)
         {
-            length = len;
+            mMutex.lock();
+            if (abortRequest)
+            {
+                mMutex.unlock();
+                return -1;
+            }
+            mCondition.waitRelative(mMutex, AUDIO_RESAMPLE_WAIT_TIMEOUT * 1000000LL);
+            mMutex.unlock();
         }
-        // 复制经过转码输出的PCM数据到缓冲区中
-        if (audioState->outputBuffer != NULL && !playerState->mute)
+    }
+    return written;
+}
+
+/**
+ * 音频设备回调，只从环形缓冲区中拷贝数据，不做解码，避免解码耗时导致音频设备欠载
+ * @param stream
+ * @param len
+ */
+void AudioResampler::pcmQueueCallback(uint8_t *stream, int len)
+{
+    int size = 0;
+
+    // 没有音频解码器时，直接返回
+    if (!audioDecoder || !ringBuffer)
+    {
+        memset(stream, 0, len);
+        return;
+    }
+
+    audioState->audio_callback_time = av_gettime_relative();
+    if (!playerState->abortRequest && !playerState->pauseRequest)
+    {
+        size = ringBuffer->read(stream, len);
+        if (size < len)
         {
-            memcpy(stream, audioState->outputBuffer + audioState->bufferIndex, length);
+            // 缓冲区数据不足，连续欠载只统计一次
+            if (!underrun)
+            {
+                underrun = true;
+                playerState->audioUnderruns++;
+            }
         }
         else
         {
-            memset(stream, 0, length);
+            underrun = false;
         }
-        len -= length;
-        stream += length;
-        audioState->bufferIndex += length;
     }
-    audioState->writeBufferSize = audioState->bufferSize - audioState->bufferIndex;
+    // 静音时数据照常消耗
+    if (playerState->mute)
+    {
+        size = 0;
+    }
+    if (size < len)
+    {
+        memset(stream + size, 0, (size_t) (len - size));
+    }
 
-    if (!isnan(audioState->audioClock) && mediaSync)
+    // 唤醒解码重采样线程填充数据，这里不加锁，防止回调被阻塞，丢失的唤醒由解码线程的等待超时兜底
+    int bufferedSize = ringBuffer->getSize();
+    if (bufferedSize < targetSize)
     {
-        mediaSync->updateAudioClock(audioState->audioClock -
-                                    (double) (2 * audioState->audio_hw_buf_size +
-                                              audioState->writeBufferSize)
-                                    / audioState->audioParamsTarget.bytes_per_sec,
+        mCondition.signal();
+    }
+    playerState->audioBufferLevel = (int) ((int64_t) bufferedSize * 1000
+                                           / audioState->audioParamsTarget.bytes_per_sec);
+
+    // 按读位置所在的一段选择基准，读位置在上一段之前说明连续定位了多次，这次不更新时钟
+    AudioClockBase clock;
+    clockBase.read(&clock);
+    int64_t readPos = ringBuffer->getReadPosition();
+    double base = readPos >= clock.start ? clock.base
+                                         : readPos >= clock.lastStart ? clock.lastBase : NAN;
+    if (!isnan(base) && mediaSync)
+    {
+        mediaSync->updateAudioClock(base + (double) (readPos - 2 * audioState->audio_hw_buf_size)
+                                           / audioState->audioParamsTarget.bytes_per_sec,
                                     audioState->audio_callback_time / 1000000.0);
     }
 }
@@ -208,6 +385,23 @@ int AudioResampler::audioFrameResample()
             continue;
         }
 
+        // 精确定位追赶期间，丢弃目标之前的整帧，跨过目标的帧裁掉目标之前的采样
+        double seek_target = audioDecoder->getSeekTarget();
+        if (!isnan(seek_target) && frame->pts != AV_NOPTS_VALUE)
+        {
+            double pts = (double) frame->pts / frame->sample_rate;
+            if (audioDecoder->isBeforeSeekTarget(pts, (double) frame->nb_samples / frame->sample_rate))
+            {
+                av_frame_unref(frame);
+                continue;
+            }
+            int skip = (int) ((seek_target - pts) * frame->sample_rate);
+            if (skip > 0 && skip < frame->nb_samples)
+            {
+                trimFrameStart(frame, skip);
+            }
+        }
+
         data_size = av_samples_get_buffer_size(NULL, av_frame_get_channels(frame),
                                                frame->nb_samples,
                                                (AVSampleFormat) frame->format, 1);
@@ -287,7 +481,10 @@ int AudioResampler::audioFrameResample()
             {
                 return AVERROR(ENOMEM);
             }
+            TRACE_SCOPE("resample");
+            STATS_BEGIN(resampleStart);
             len2 = swr_convert(audioState->swr_ctx, out, out_count, in, frame->nb_samples);
+            STATS_END(playerState, STAGE_AUDIO_RESAMPLE, resampleStart);
             if (len2 < 0)
             {
                 av_log(NULL, AV_LOG_ERROR, "swr_convert() failed\n");
@@ -372,3 +569,27 @@ int AudioResampler::audioFrameResample()
 
     return resampled_data_size;
 }
+
+/**
+ * 丢弃音频帧开头的采样，只移动数据指针，帧的缓冲引用不变
+ * @param frame
+ * @param nbSamples 丢弃的采样数，必须小于帧的采样数
+ */
+void AudioResampler::trimFrameStart(AVFrame *frame, int nbSamples)
+{
+    AVSampleFormat format = (AVSampleFormat) frame->format;
+    int channels = av_frame_get_channels(frame);
+    int planar = av_sample_fmt_is_planar(format);
+    int offset = nbSamples * av_get_bytes_per_sample(format) * (planar ? 1 : channels);
+    int planes = planar ? channels : 1;
+    for (int i = 0; i < planes; ++i)
+    {
+        frame->extended_data[i] += offset;
+        if (i < AV_NUM_DATA_POINTERS)
+        {
+            frame->data[i] = frame->extended_data[i];
+        }
+    }
+    frame->nb_samples -= nbSamples;
+    frame->pts += nbSamples;
+}
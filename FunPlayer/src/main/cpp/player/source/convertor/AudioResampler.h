@@ -9,6 +9,8 @@
 #include <sync/MediaSync.h>
 #include <SoundTouchWrapper.h>
 #include <device/AudioDevice.h>
+#include <queue/AudioRingBuffer.h>
+#include <common/SeqLock.h>
 
 /**
  * 音频参数
@@ -37,17 +39,26 @@ typedef struct AudioState
     uint8_t *outputBuffer;                  // 输出缓冲大小
     uint8_t *resampleBuffer;                // 重采样大小
     short *soundTouchBuffer;                // SoundTouch缓冲
-    unsigned int bufferSize;                // 缓冲大小
     unsigned int resampleSize;              // 重采样大小
     unsigned int soundTouchBufferSize;      // SoundTouch处理后的缓冲大小大小
-    int bufferIndex;
-    int writeBufferSize;                    // 写入大小
     SwrContext *swr_ctx;                    // 音频转码上下文
     int64_t audio_callback_time;            // 音频回调时间
     AudioParams audioParamsSrc;             // 音频原始参数
     AudioParams audioParamsTarget;          // 音频目标参数
 } AudioState;
 
+/**
+ * 音频时钟基准，即PCM缓冲区写入位置为0时对应的音频时钟
+ * 定位丢弃数据时从丢弃位置开始新的一段，回调的读位置还没有越过丢弃位置时使用上一段的基准
+ */
+typedef struct AudioClockBase
+{
+    double base;                            // 当前一段的基准
+    int64_t start;                          // 当前一段在缓冲区中的起始写入位置
+    double lastBase;                        // 上一段的基准
+    int64_t lastStart;                      // 上一段的起始写入位置
+} AudioClockBase;
+
 /**
  * 音频重采样器
  */
@@ -60,13 +71,31 @@ public:
 
     int setResampleParams(AudioDeviceSpec *spec, int64_t wanted_channel_layout);
 
+    // 启动解码重采样线程
+    void start();
+
+    // 停止解码重采样线程
+    void stop();
+
     void pcmQueueCallback(uint8_t *stream, int len);
 
+    // 获取PCM缓冲区中待播放的数据大小
+    int getBufferedSize();
+
 private:
+    // 解码重采样线程，将PCM数据填充到环形缓冲区中
+    void run();
+
+    // 将PCM数据写入环形缓冲区，缓冲区满时等待
+    int writeBuffer(const uint8_t *data, int size);
+
     int audioSynchronize(int nbSamples);
 
     int audioFrameResample();
 
+    // 丢弃音频帧开头的采样
+    void trimFrameStart(AVFrame *frame, int nbSamples);
+
 private:
     PlayerState *playerState;
     MediaSync *mediaSync;
@@ -75,6 +104,15 @@ private:
     AudioDecoder *audioDecoder;             // 音频解码器
     AudioState *audioState;                 // 音频重采样状态
     SoundTouchWrapper *soundTouchWrapper;   // 变速变调处理
+
+    Mutex mMutex;
+    Condition mCondition;
+    std::thread resampleThread;             // 解码重采样线程
+    bool abortRequest;                      // 停止标志
+    AudioRingBuffer *ringBuffer;            // PCM环形缓冲区
+    int targetSize;                         // 缓冲区填充的目标大小
+    SeqLock<AudioClockBase> clockBase;      // 音频时钟基准，用于根据读位置计算时钟
+    bool underrun;                          // 是否处于欠载状态
 };
 
 
@@ -0,0 +1,145 @@
+#include "PixelKernels.h"
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#include <cpuid.h>
+
+#define bit_SSE2_EDX    (1 << 26)
+#define bit_OSXSAVE_ECX (1 << 27)
+#define bit_AVX_ECX     (1 << 28)
+#define bit_AVX2_EBX    (1 << 5)
+#endif
+
+// 禁用的指令集扩展
+static uint32_t disabledExtensions = 0;
+
+void disablePixelExtensions(uint32_t mask)
+{
+    disabledExtensions = mask;
+}
+
+/**
+ * 检测CPU支持的指令集扩展，AVX2还需要系统保存YMM寄存器的状态
+ * ARM上没有向量实现，使用标量实现，简单的循环由编译器自动向量化
+ * @return
+ */
+uint32_t detectPixelExtensions()
+{
+    uint32_t res = 0;
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    {
+        if (edx & bit_SSE2_EDX)
+        {
+            res |= PIXEL_SUPPORT_SSE2;
+        }
+        if ((ecx & bit_OSXSAVE_ECX) && (ecx & bit_AVX_ECX))
+        {
+            unsigned int xcr0_lo, xcr0_hi;
+            __asm__ volatile ("xgetbv" : "=a" (xcr0_lo), "=d" (xcr0_hi) : "c" (0));
+            if ((xcr0_lo & 0x6) == 0x6 && __get_cpuid_max(0, NULL) >= 7)
+            {
+                __cpuid_count(7, 0, eax, ebx, ecx, edx);
+                if (ebx & bit_AVX2_EBX)
+                {
+                    res |= PIXEL_SUPPORT_AVX2;
+                }
+            }
+        }
+    }
+#endif
+
+    return res & ~disabledExtensions;
+}
+
+const PixelKernels *getPixelKernels(uint32_t extension)
+{
+    static const PixelKernels scalarKernels = {
+            "c",
+            deinterleaveUV_C,
+            narrow16_C,
+            averageRows_C
+    };
+
+    if (extension == 0)
+    {
+        return &scalarKernels;
+    }
+    if (!(detectPixelExtensions() & extension))
+    {
+        return NULL;
+    }
+    switch (extension)
+    {
+        case PIXEL_SUPPORT_SSE2:
+        {
+            return getPixelKernelsSSE2();
+        }
+        case PIXEL_SUPPORT_AVX2:
+        {
+            return getPixelKernelsAVX2();
+        }
+        default:
+        {
+            return NULL;
+        }
+    }
+}
+
+/**
+ * 按照AVX2 > SSE2 > 标量的顺序选择内核
+ * @return
+ */
+static const PixelKernels *selectPixelKernels()
+{
+    const uint32_t order[] = {PIXEL_SUPPORT_AVX2, PIXEL_SUPPORT_SSE2};
+    for (int i = 0; i < (int) (sizeof(order) / sizeof(order[0])); ++i)
+    {
+        const PixelKernels *kernels = getPixelKernels(order[i]);
+        if (kernels != NULL)
+        {
+            return kernels;
+        }
+    }
+    return getPixelKernels(0);
+}
+
+const PixelKernels *getPixelKernels()
+{
+    static const PixelKernels *kernels = selectPixelKernels();
+    return kernels;
+}
+
+static inline uint8_t clampPixel(int value)
+{
+    return (uint8_t) (value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+void deinterleaveUV_C(const uint8_t *src, uint8_t *u, uint8_t *v, int count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        u[i] = src[2 * i];
+        v[i] = src[2 * i + 1];
+    }
+}
+
+void narrow16_C(const uint16_t *src, uint8_t *dst, int count, int shift)
+{
+    const int round = 1 << (shift - 1);
+    for (int i = 0; i < count; ++i)
+    {
+        // 加上舍入值之后饱和到16位，与向量实现的饱和加法一致
+        int value = src[i] + round;
+        dst[i] = clampPixel((value > 0xFFFF ? 0xFFFF : value) >> shift);
+    }
+}
+
+void averageRows_C(const uint8_t *src0, const uint8_t *src1, uint8_t *dst, int count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        dst[i] = (uint8_t) ((src0[i] + src1[i] + 1) >> 1);
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef PIXELKERNELS_H
+#define PIXELKERNELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 指令集扩展
+#define PIXEL_SUPPORT_SSE2      0x0001
+#define PIXEL_SUPPORT_AVX2      0x0002
+
+/**
+ * 像素格式转换内核，每个函数处理一行数据
+ * 各指令集的实现与标量参考实现逐字节一致，剩余不足一个向量的数据由标量实现处理
+ */
+typedef struct PixelKernels
+{
+    const char *name;
+
+    // 交织的UV行拆分成U、V两个平面，count是UV对的数量，NV21交换u、v即可
+    void (*deinterleaveUV)(const uint8_t *src, uint8_t *u, uint8_t *v, int count);
+
+    // 16位采样四舍五入右移shift(1 ~ 15)位并饱和到8位，舍入时饱和到16位，P010为8，低位对齐的10位格式为2
+    void (*narrow16)(const uint16_t *src, uint8_t *dst, int count, int shift);
+
+    // 两行求平均，(a + b + 1) >> 1，用于4:2:2色度垂直下采样
+    void (*averageRows)(const uint8_t *src0, const uint8_t *src1, uint8_t *dst, int count);
+} PixelKernels;
+
+/**
+ * 检测CPU支持的指令集扩展
+ * @return PIXEL_SUPPORT_... 的组合，已禁用的扩展不包含在内
+ */
+uint32_t detectPixelExtensions();
+
+/**
+ * 禁用指定的指令集扩展，用于调试以及对比测试，需要在getPixelKernels之前调用
+ * @param mask PIXEL_SUPPORT_... 的组合
+ */
+void disablePixelExtensions(uint32_t mask);
+
+/**
+ * 获取当前CPU上最快的一组内核，第一次调用时检测CPU并缓存结果
+ */
+const PixelKernels *getPixelKernels();
+
+/**
+ * 获取指定指令集的内核，没有编译或者CPU不支持时返回NULL，0表示标量参考实现
+ */
+const PixelKernels *getPixelKernels(uint32_t extension);
+
+// 标量参考实现，也用于处理各指令集实现剩余的尾部数据
+void deinterleaveUV_C(const uint8_t *src, uint8_t *u, uint8_t *v, int count);
+
+void narrow16_C(const uint16_t *src, uint8_t *dst, int count, int shift);
+
+void averageRows_C(const uint8_t *src0, const uint8_t *src1, uint8_t *dst, int count);
+
+// 各指令集的实现，没有编译时返回NULL
+const PixelKernels *getPixelKernelsSSE2();
+
+const PixelKernels *getPixelKernelsAVX2();
+
+#endif //PIXELKERNELS_H
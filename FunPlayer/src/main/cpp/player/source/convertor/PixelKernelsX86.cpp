@@ -0,0 +1,149 @@
+#include "PixelKernels.h"
+
+/**
+ * x86 SSE2/AVX2 实现
+ * AVX2函数通过target属性单独编译，不需要修改整个工程的编译选项，运行时根据CPU检测结果选择
+ */
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__)) && defined(__SSE2__)
+
+#include <immintrin.h>
+
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+//////////////////////////////////////////////////////////////////////////////
+// SSE2
+//////////////////////////////////////////////////////////////////////////////
+
+static void deinterleaveUV_SSE2(const uint8_t *src, uint8_t *u, uint8_t *v, int count)
+{
+    const __m128i mask = _mm_set1_epi16(0x00FF);
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *) (src + 2 * i));
+        __m128i b = _mm_loadu_si128((const __m128i *) (src + 2 * i + 16));
+        __m128i evens = _mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask));
+        __m128i odds = _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+        _mm_storeu_si128((__m128i *) (u + i), evens);
+        _mm_storeu_si128((__m128i *) (v + i), odds);
+    }
+    deinterleaveUV_C(src + 2 * i, u + i, v + i, count - i);
+}
+
+static void narrow16_SSE2(const uint16_t *src, uint8_t *dst, int count, int shift)
+{
+    const __m128i round = _mm_set1_epi16((short) (1 << (shift - 1)));
+    const __m128i bits = _mm_cvtsi32_si128(shift);
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *) (src + i));
+        __m128i b = _mm_loadu_si128((const __m128i *) (src + i + 8));
+        // 无符号饱和加法，右移之后最高位为0，可以按有符号数饱和打包
+        a = _mm_srl_epi16(_mm_adds_epu16(a, round), bits);
+        b = _mm_srl_epi16(_mm_adds_epu16(b, round), bits);
+        _mm_storeu_si128((__m128i *) (dst + i), _mm_packus_epi16(a, b));
+    }
+    narrow16_C(src + i, dst + i, count - i, shift);
+}
+
+static void averageRows_SSE2(const uint8_t *src0, const uint8_t *src1, uint8_t *dst, int count)
+{
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *) (src0 + i));
+        __m128i b = _mm_loadu_si128((const __m128i *) (src1 + i));
+        _mm_storeu_si128((__m128i *) (dst + i), _mm_avg_epu8(a, b));
+    }
+    averageRows_C(src0 + i, src1 + i, dst + i, count - i);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// AVX2
+// 256位的pack/unpack在两个128位通道内分别进行，需要用permute恢复顺序
+//////////////////////////////////////////////////////////////////////////////
+
+AVX2_TARGET
+static void deinterleaveUV_AVX2(const uint8_t *src, uint8_t *u, uint8_t *v, int count)
+{
+    const __m256i mask = _mm256_set1_epi16(0x00FF);
+    int i = 0;
+    for (; i + 32 <= count; i += 32)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i *) (src + 2 * i));
+        __m256i b = _mm256_loadu_si256((const __m256i *) (src + 2 * i + 32));
+        __m256i evens = _mm256_packus_epi16(_mm256_and_si256(a, mask), _mm256_and_si256(b, mask));
+        __m256i odds = _mm256_packus_epi16(_mm256_srli_epi16(a, 8), _mm256_srli_epi16(b, 8));
+        _mm256_storeu_si256((__m256i *) (u + i), _mm256_permute4x64_epi64(evens, 0xD8));
+        _mm256_storeu_si256((__m256i *) (v + i), _mm256_permute4x64_epi64(odds, 0xD8));
+    }
+    deinterleaveUV_SSE2(src + 2 * i, u + i, v + i, count - i);
+}
+
+AVX2_TARGET
+static void narrow16_AVX2(const uint16_t *src, uint8_t *dst, int count, int shift)
+{
+    const __m256i round = _mm256_set1_epi16((short) (1 << (shift - 1)));
+    const __m128i bits = _mm_cvtsi32_si128(shift);
+    int i = 0;
+    for (; i + 32 <= count; i += 32)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i *) (src + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *) (src + i + 16));
+        a = _mm256_srl_epi16(_mm256_adds_epu16(a, round), bits);
+        b = _mm256_srl_epi16(_mm256_adds_epu16(b, round), bits);
+        _mm256_storeu_si256((__m256i *) (dst + i),
+                            _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8));
+    }
+    narrow16_SSE2(src + i, dst + i, count - i, shift);
+}
+
+AVX2_TARGET
+static void averageRows_AVX2(const uint8_t *src0, const uint8_t *src1, uint8_t *dst, int count)
+{
+    int i = 0;
+    for (; i + 32 <= count; i += 32)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i *) (src0 + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *) (src1 + i));
+        _mm256_storeu_si256((__m256i *) (dst + i), _mm256_avg_epu8(a, b));
+    }
+    averageRows_SSE2(src0 + i, src1 + i, dst + i, count - i);
+}
+
+const PixelKernels *getPixelKernelsSSE2()
+{
+    static const PixelKernels kernels = {
+            "sse2",
+            deinterleaveUV_SSE2,
+            narrow16_SSE2,
+            averageRows_SSE2
+    };
+    return &kernels;
+}
+
+const PixelKernels *getPixelKernelsAVX2()
+{
+    static const PixelKernels kernels = {
+            "avx2",
+            deinterleaveUV_AVX2,
+            narrow16_AVX2,
+            averageRows_AVX2
+    };
+    return &kernels;
+}
+
+#else
+
+const PixelKernels *getPixelKernelsSSE2()
+{
+    return NULL;
+}
+
+const PixelKernels *getPixelKernelsAVX2()
+{
+    return NULL;
+}
+
+#endif
@@ -0,0 +1,499 @@
+#include "VideoConvertor.h"
+
+extern "C" {
+#include <libavutil/cpu.h>
+#include <libavutil/pixdesc.h>
+};
+
+// 条带高度的对齐行数，同时满足色度平面的垂直下采样
+#define SLICE_ALIGN 16
+// 小于这个高度的图像不切分条带，线程切换的开销比转换本身大
+#define SLICE_MIN_HEIGHT 64
+// 16位交织色度分块处理的采样对数，先降到8位再拆分
+#define CHROMA_CHUNK 512
+
+VideoConvertor::VideoConvertor(PlayerState *playerState)
+{
+    this->playerState = playerState;
+    kernels = getPixelKernels();
+    outputFormat = AV_PIX_FMT_NONE;
+    for (int i = 0; i < VIDEO_CONVERT_MAX_THREADS; ++i)
+    {
+        workers[i] = NULL;
+        sliceContext[i] = NULL;
+    }
+    memset(sliceY, 0, sizeof(sliceY));
+    memset(planeShift, 0, sizeof(planeShift));
+    workerCount = 0;
+    abortRequest = 0;
+    jobGeneration = 0;
+    pendingSlices = 0;
+    sliceCount = 0;
+    bufferPool = NULL;
+    format = AV_PIX_FMT_NONE;
+    width = 0;
+    height = 0;
+    memset(dstLinesize, 0, sizeof(dstLinesize));
+    memset(dstOffset, 0, sizeof(dstOffset));
+    dstPlanes = 0;
+    srcFrame = NULL;
+    dstFrame = NULL;
+}
+
+VideoConvertor::~VideoConvertor()
+{
+    stop();
+    playerState = NULL;
+}
+
+void VideoConvertor::stop()
+{
+    mMutex.lock();
+    abortRequest = 1;
+    mCondition.broadcast();
+    mMutex.unlock();
+    for (int i = 0; i < workerCount; ++i)
+    {
+        if (workers[i])
+        {
+            if (workers[i]->joinable())
+            {
+                workers[i]->join();
+            }
+            delete workers[i];
+            workers[i] = NULL;
+        }
+    }
+    workerCount = 0;
+    // 条带数量和工作线程数量对应，下一次转换时重新创建
+    freeContext();
+}
+
+int VideoConvertor::needConvert(int format)
+{
+    return format != AV_PIX_FMT_YUV420P && format != AV_PIX_FMT_YUVJ420P
+           && format != AV_PIX_FMT_BGRA;
+}
+
+void VideoConvertor::freeContext()
+{
+    for (int i = 0; i < VIDEO_CONVERT_MAX_THREADS; ++i)
+    {
+        if (sliceContext[i])
+        {
+            sws_freeContext(sliceContext[i]);
+            sliceContext[i] = NULL;
+        }
+    }
+    sliceCount = 0;
+    if (bufferPool)
+    {
+        // 还在帧队列中的缓冲归还之后缓冲池才会真正释放
+        av_buffer_pool_uninit(&bufferPool);
+        bufferPool = NULL;
+    }
+    format = AV_PIX_FMT_NONE;
+    width = 0;
+    height = 0;
+}
+
+/**
+ * 启动工作线程，只有真正需要转换时才创建，直接渲染的格式不占用线程
+ */
+void VideoConvertor::startWorkers()
+{
+    int threads = playerState->convertThreads;
+    if (threads <= 0)
+    {
+        threads = FFMIN(av_cpu_count(), VIDEO_CONVERT_MAX_THREADS);
+    }
+    mMutex.lock();
+    abortRequest = 0;
+    jobGeneration = 0;
+    mMutex.unlock();
+    // 转换线程自己负责第一个条带
+    for (int i = 1; i < threads; ++i)
+    {
+        workers[workerCount++] = new std::thread(&VideoConvertor::run, this, i);
+    }
+}
+
+/**
+ * 可以用PixelKernels直接转换成YUV420P的格式
+ * @param format
+ * @return 转换后的格式，不支持时返回AV_PIX_FMT_NONE
+ */
+static int kernelOutputFormat(int format)
+{
+    switch (format)
+    {
+        case AV_PIX_FMT_NV12:
+        case AV_PIX_FMT_NV21:
+        case AV_PIX_FMT_P010LE:
+        case AV_PIX_FMT_YUV420P10LE:
+        case AV_PIX_FMT_YUV422P:
+        case AV_PIX_FMT_YUV422P10LE:
+        {
+            return AV_PIX_FMT_YUV420P;
+        }
+        case AV_PIX_FMT_YUVJ422P:
+        {
+            return AV_PIX_FMT_YUVJ420P;
+        }
+        default:
+        {
+            return AV_PIX_FMT_NONE;
+        }
+    }
+}
+
+/**
+ * 选择缩放算法，源和目标大小相同，算法只影响色度上采样以及高位深的处理
+ * 8位YUV使用快速双线性，高位深使用双线性减少色带，RGB类格式只是重新排列像素，使用最近邻
+ * @param desc
+ * @return
+ */
+static int selectFilter(const AVPixFmtDescriptor *desc)
+{
+    if (desc->flags & AV_PIX_FMT_FLAG_RGB)
+    {
+        return SWS_POINT;
+    }
+    if (desc->comp[0].depth > 8)
+    {
+        return SWS_BILINEAR;
+    }
+    return SWS_FAST_BILINEAR;
+}
+
+int VideoConvertor::updateContext(AVFrame *src)
+{
+    if (sliceCount > 0 && format == src->format && width == src->width && height == src->height)
+    {
+        return 0;
+    }
+    freeContext();
+
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get((AVPixelFormat) src->format);
+    if (!desc || (desc->flags & AV_PIX_FMT_FLAG_HWACCEL))
+    {
+        return AVERROR(EINVAL);
+    }
+    if (workerCount == 0)
+    {
+        startWorkers();
+    }
+
+    // 调色板格式的第二个平面是调色板，不能按行偏移，不切分条带
+    int slices = workerCount + 1;
+    if ((desc->flags & (AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_PSEUDOPAL))
+        || src->height < SLICE_MIN_HEIGHT * slices)
+    {
+        slices = 1;
+    }
+    for (int i = 0; i < 4; ++i)
+    {
+        planeShift[i] = (i == 1 || i == 2) ? desc->log2_chroma_h : 0;
+    }
+
+    // 按照对齐的行数均分条带
+    int rows = FFALIGN((src->height + slices - 1) / slices, SLICE_ALIGN);
+    int filter = selectFilter(desc);
+    outputFormat = kernelOutputFormat(src->format);
+    if (outputFormat == AV_PIX_FMT_NONE)
+    {
+        outputFormat = AV_PIX_FMT_BGRA;
+    }
+    sliceCount = 0;
+    for (int i = 0; i < slices; ++i)
+    {
+        int y = FFMIN(i * rows, src->height);
+        int h = FFMIN(rows, src->height - y);
+        if (h <= 0)
+        {
+            break;
+        }
+        if (outputFormat == AV_PIX_FMT_BGRA)
+        {
+            sliceContext[i] = sws_getContext(src->width, h, (AVPixelFormat) src->format,
+                                             src->width, h, AV_PIX_FMT_BGRA,
+                                             filter, NULL, NULL, NULL);
+            if (!sliceContext[i])
+            {
+                freeContext();
+                return AVERROR(EINVAL);
+            }
+        }
+        sliceY[i] = y;
+        sliceY[i + 1] = y + h;
+        sliceCount++;
+    }
+
+    // YUV420P的色度linesize刚好是亮度的一半，与解码帧缓冲池的布局一致
+    int size;
+    memset(dstLinesize, 0, sizeof(dstLinesize));
+    memset(dstOffset, 0, sizeof(dstOffset));
+    if (outputFormat == AV_PIX_FMT_BGRA)
+    {
+        dstPlanes = 1;
+        dstLinesize[0] = FFALIGN(src->width * 4, 16);
+        size = dstLinesize[0] * src->height;
+    }
+    else
+    {
+        int chromaHeight = (src->height + 1) >> 1;
+        dstPlanes = 3;
+        dstLinesize[0] = FFALIGN(src->width, 32);
+        dstLinesize[1] = dstLinesize[0] / 2;
+        dstLinesize[2] = dstLinesize[0] / 2;
+        dstOffset[1] = dstLinesize[0] * src->height;
+        dstOffset[2] = dstOffset[1] + dstLinesize[1] * chromaHeight;
+        size = dstOffset[2] + dstLinesize[2] * chromaHeight;
+    }
+    bufferPool = av_buffer_pool_init(size, av_buffer_alloc);
+    if (!bufferPool)
+    {
+        freeContext();
+        return AVERROR(ENOMEM);
+    }
+    format = src->format;
+    width = src->width;
+    height = src->height;
+
+    av_log(NULL, AV_LOG_VERBOSE, "video convertor: %dx%d %s -> %s, %d slices, %s kernels\n",
+           width, height, desc->name, av_get_pix_fmt_name((AVPixelFormat) outputFormat),
+           sliceCount, kernels->name);
+    return 0;
+}
+
+void VideoConvertor::convertSlice(int index)
+{
+    if (index >= sliceCount)
+    {
+        return;
+    }
+    if (outputFormat != AV_PIX_FMT_BGRA)
+    {
+        convertRows(sliceY[index], sliceY[index + 1]);
+        return;
+    }
+    const uint8_t *srcData[4] = {NULL, NULL, NULL, NULL};
+    int y = sliceY[index];
+    for (int i = 0; i < 4; ++i)
+    {
+        if (srcFrame->data[i])
+        {
+            srcData[i] = srcFrame->data[i] + (y >> planeShift[i]) * srcFrame->linesize[i];
+        }
+    }
+    uint8_t *dstData[4] = {dstFrame->data[0] + y * dstFrame->linesize[0], NULL, NULL, NULL};
+    int lines[4] = {dstFrame->linesize[0], 0, 0, 0};
+    sws_scale(sliceContext[index], srcData, srcFrame->linesize, 0, sliceY[index + 1] - y,
+              dstData, lines);
+}
+
+void VideoConvertor::convertRows(int y0, int y1)
+{
+    const int format = srcFrame->format;
+    const int w = width;
+    const int cw = (width + 1) >> 1;
+    const int ch = (height + 1) >> 1;
+    const int shift = (format == AV_PIX_FMT_P010LE) ? 8 : 2;
+    const int deep = (format == AV_PIX_FMT_P010LE || format == AV_PIX_FMT_YUV420P10LE
+                      || format == AV_PIX_FMT_YUV422P10LE);
+    const int *srcLinesize = srcFrame->linesize;
+    uint8_t *dstY = dstFrame->data[0];
+    uint8_t *dstU = dstFrame->data[1];
+    uint8_t *dstV = dstFrame->data[2];
+
+    // 亮度平面
+    for (int y = y0; y < y1; ++y)
+    {
+        const uint8_t *src = srcFrame->data[0] + y * srcLinesize[0];
+        if (deep)
+        {
+            kernels->narrow16((const uint16_t *) src, dstY + y * dstLinesize[0], w, shift);
+        }
+        else
+        {
+            memcpy(dstY + y * dstLinesize[0], src, (size_t) w);
+        }
+    }
+
+    // 色度平面，条带起始行是偶数，色度行不会重叠
+    uint8_t temp0[CHROMA_CHUNK * 2];
+    uint8_t temp1[CHROMA_CHUNK * 2];
+    for (int c = y0 >> 1; c < FFMIN((y1 + 1) >> 1, ch); ++c)
+    {
+        uint8_t *u = dstU + c * dstLinesize[1];
+        uint8_t *v = dstV + c * dstLinesize[2];
+        switch (format)
+        {
+            case AV_PIX_FMT_NV12:
+            case AV_PIX_FMT_NV21:
+            {
+                const uint8_t *src = srcFrame->data[1] + c * srcLinesize[1];
+                if (format == AV_PIX_FMT_NV12)
+                {
+                    kernels->deinterleaveUV(src, u, v, cw);
+                }
+                else
+                {
+                    kernels->deinterleaveUV(src, v, u, cw);
+                }
+                break;
+            }
+
+            case AV_PIX_FMT_P010LE:
+            {
+                const uint16_t *src = (const uint16_t *) (srcFrame->data[1] + c * srcLinesize[1]);
+                for (int x = 0; x < cw; x += CHROMA_CHUNK)
+                {
+                    int count = FFMIN(CHROMA_CHUNK, cw - x);
+                    kernels->narrow16(src + 2 * x, temp0, count * 2, shift);
+                    kernels->deinterleaveUV(temp0, u + x, v + x, count);
+                }
+                break;
+            }
+
+            case AV_PIX_FMT_YUV420P10LE:
+            {
+                kernels->narrow16((const uint16_t *) (srcFrame->data[1] + c * srcLinesize[1]),
+                                  u, cw, shift);
+                kernels->narrow16((const uint16_t *) (srcFrame->data[2] + c * srcLinesize[2]),
+                                  v, cw, shift);
+                break;
+            }
+
+            // 4:2:2 的色度每两行求平均，高度为奇数时最后一行单独使用
+            case AV_PIX_FMT_YUV422P:
+            case AV_PIX_FMT_YUVJ422P:
+            case AV_PIX_FMT_YUV422P10LE:
+            {
+                int r0 = 2 * c;
+                int r1 = FFMIN(2 * c + 1, height - 1);
+                for (int plane = 1; plane <= 2; ++plane)
+                {
+                    const uint8_t *row0 = srcFrame->data[plane] + r0 * srcLinesize[plane];
+                    const uint8_t *row1 = srcFrame->data[plane] + r1 * srcLinesize[plane];
+                    uint8_t *dst = (plane == 1) ? u : v;
+                    if (!deep)
+                    {
+                        kernels->averageRows(row0, row1, dst, cw);
+                        continue;
+                    }
+                    for (int x = 0; x < cw; x += CHROMA_CHUNK * 2)
+                    {
+                        int count = FFMIN(CHROMA_CHUNK * 2, cw - x);
+                        kernels->narrow16((const uint16_t *) row0 + x, temp0, count, shift);
+                        kernels->narrow16((const uint16_t *) row1 + x, temp1, count, shift);
+                        kernels->averageRows(temp0, temp1, dst + x, count);
+                    }
+                }
+                break;
+            }
+
+            default:
+            {
+                break;
+            }
+        }
+    }
+}
+
+void VideoConvertor::run(int index)
+{
+    int generation = 0;
+    TRACE_THREAD("convert_worker");
+    for (;;)
+    {
+        mMutex.lock();
+        while (!abortRequest && generation == jobGeneration)
+        {
+            mCondition.wait(mMutex);
+        }
+        if (abortRequest)
+        {
+            mMutex.unlock();
+            break;
+        }
+        generation = jobGeneration;
+        mMutex.unlock();
+
+        {
+            TRACE_SCOPE("convert_slice");
+            convertSlice(index);
+        }
+
+        mMutex.lock();
+        if (--pendingSlices == 0)
+        {
+            mDoneCondition.signal();
+        }
+        mMutex.unlock();
+    }
+}
+
+/**
+ * 转换成BGRA格式，在解码线程调用
+ * @param src
+ * @param dst
+ * @return
+ */
+int VideoConvertor::convert(AVFrame *src, AVFrame *dst)
+{
+    int64_t start = av_gettime_relative();
+    int ret = updateContext(src);
+    if (ret < 0)
+    {
+        return ret;
+    }
+
+    dst->buf[0] = av_buffer_pool_get(bufferPool);
+    if (!dst->buf[0])
+    {
+        return AVERROR(ENOMEM);
+    }
+    for (int i = 0; i < dstPlanes; ++i)
+    {
+        dst->data[i] = dst->buf[0]->data + dstOffset[i];
+        dst->linesize[i] = dstLinesize[i];
+    }
+    dst->extended_data = dst->data;
+    dst->format = outputFormat;
+    dst->width = src->width;
+    dst->height = src->height;
+    av_frame_copy_props(dst, src);
+
+    srcFrame = src;
+    dstFrame = dst;
+    if (sliceCount > 1)
+    {
+        // 唤醒工作线程转换其余的条带，没有分到条带的线程直接完成
+        mMutex.lock();
+        pendingSlices = workerCount;
+        jobGeneration++;
+        mCondition.broadcast();
+        mMutex.unlock();
+
+        convertSlice(0);
+
+        mMutex.lock();
+        while (pendingSlices > 0)
+        {
+            mDoneCondition.wait(mMutex);
+        }
+        mMutex.unlock();
+    }
+    else
+    {
+        convertSlice(0);
+    }
+    srcFrame = NULL;
+    dstFrame = NULL;
+
+    playerState->convertedFrames++;
+    playerState->convertTime += av_gettime_relative() - start;
+    STATS_END(playerState, STAGE_VIDEO_CONVERT, start);
+    return 0;
+}
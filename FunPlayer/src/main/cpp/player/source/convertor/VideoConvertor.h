@@ -0,0 +1,77 @@
+#ifndef VIDEOCONVERTOR_H
+#define VIDEOCONVERTOR_H
+
+#include <player/PlayerState.h>
+#include <convertor/PixelKernels.h>
+
+/**
+ * 视频帧格式转换器，把渲染端不能直接上传的像素格式转换成YUV420P或者BGRA
+ * NV12/NV21/P010/YUV420P10/YUV422P等常见格式使用PixelKernels转换成YUV420P，其他格式使用sws_scale转换成BGRA
+ * 在解码线程入队之前完成转换，同步线程送显时不再做耗时的转换
+ * 一帧图像按行切分成多个条带，每个条带有自己的SwsContext，由工作线程并行转换
+ * 转换后的缓冲来自缓冲池，分辨率或者格式变化时重新创建
+ */
+class VideoConvertor
+{
+public:
+    VideoConvertor(PlayerState *playerState);
+
+    virtual ~VideoConvertor();
+
+    // 停止工作线程，并释放转换上下文
+    void stop();
+
+    // 是否需要转换，YUV420P/YUVJ420P/BGRA可以直接渲染
+    static int needConvert(int format);
+
+    // 转换成渲染端支持的格式，dst的数据来自缓冲池，并复制src的时间戳等参数
+    int convert(AVFrame *src, AVFrame *dst);
+
+private:
+    // 格式或者大小变化时重新创建转换上下文以及缓冲池
+    int updateContext(AVFrame *src);
+
+    // 启动工作线程
+    void startWorkers();
+
+    // 转换一个条带
+    void convertSlice(int index);
+
+    // 使用PixelKernels转换[y0, y1)行到YUV420P，y0必须是偶数
+    void convertRows(int y0, int y1);
+
+    void run(int index);
+
+    void freeContext();
+
+private:
+    PlayerState *playerState;
+    Mutex mMutex;
+    Condition mCondition;                   // 通知工作线程有新的任务
+    Condition mDoneCondition;               // 通知转换线程条带已完成
+    std::thread *workers[VIDEO_CONVERT_MAX_THREADS];
+    int workerCount;                        // 工作线程数量，转换线程自己也负责一个条带
+    int abortRequest;
+    int jobGeneration;                      // 任务序号，每转换一帧加一
+    int pendingSlices;                      // 还没完成的条带数量
+
+    const PixelKernels *kernels;            // 像素格式转换内核
+    int outputFormat;                       // 转换后的格式
+    SwsContext *sliceContext[VIDEO_CONVERT_MAX_THREADS];
+    int sliceY[VIDEO_CONVERT_MAX_THREADS + 1];  // 每个条带的起始行
+    int sliceCount;                         // 条带数量
+    AVBufferPool *bufferPool;               // 转换后图像的缓冲池
+    int format;                             // 源图像格式
+    int width;                              // 源图像宽度
+    int height;                             // 源图像高度
+    int dstLinesize[4];                     // 转换后图像每个平面的linesize
+    int dstOffset[4];                       // 转换后图像每个平面在缓冲中的偏移
+    int dstPlanes;                          // 转换后图像的平面数
+    int planeShift[4];                      // 每个平面的垂直下采样位数，用于计算条带在平面中的起始行
+
+    AVFrame *srcFrame;                      // 正在转换的源图像
+    AVFrame *dstFrame;                      // 正在转换的目标图像
+};
+
+
+#endif //VIDEOCONVERTOR_H
@@ -6,6 +6,8 @@ AudioDecoder::AudioDecoder(AVCodecContext *avctx, AVStream *stream, int streamIn
 {
     packet = av_packet_alloc();
     packetPending = 0;
+    next_pts = AV_NOPTS_VALUE;
+    next_pts_tb = (AVRational) {1, 1};
 }
 
 AudioDecoder::~AudioDecoder()
@@ -41,12 +43,13 @@ int AudioDecoder::getAudioFrame(AVFrame *frame)
             break;
         }
 
-        if (playerState->seekRequest)
+        AVPacket pkt;
+        // 未消耗完的数据包在刷新之后已经过期，直接丢弃
+        if (packetPending && pktSerial != packetQueue->getSerial())
         {
-            continue;
+            av_packet_unref(packet);
+            packetPending = 0;
         }
-
-        AVPacket pkt;
         if (packetPending)
         {
             av_packet_move_ref(&pkt, packet);
@@ -54,14 +57,27 @@ int AudioDecoder::getAudioFrame(AVFrame *frame)
         }
         else
         {
-            if (packetQueue->getPacket(&pkt) < 0)
+            int serial = pktSerial;
+            if (readPacket(&pkt) < 0)
             {
                 ret = -1;
                 break;
             }
+            if (serial != pktSerial)
+            {
+                next_pts = AV_NOPTS_VALUE;
+            }
+            // 拖动时静音，不解码音频
+            if (playerState->scrubbing)
+            {
+                av_packet_unref(&pkt);
+                continue;
+            }
         }
 
-        playerState->mMutex.lock();
+        lockCodec();
+        TRACE_BEGIN("decode");
+        STATS_BEGIN(decodeStart);
         // 将数据包解码
         ret = avcodec_send_packet(pCodecCtx, &pkt);
         if (ret < 0)
@@ -77,21 +93,31 @@ int AudioDecoder::getAudioFrame(AVFrame *frame)
                 av_packet_unref(&pkt);
                 packetPending = 0;
             }
-            playerState->mMutex.unlock();
+            TRACE_END("decode");
+            unlockCodec();
             continue;
         }
 
         // 获取解码得到的音频帧AVFrame
         ret = avcodec_receive_frame(pCodecCtx, frame);
-        playerState->mMutex.unlock();
+        STATS_END(playerState, STAGE_AUDIO_DECODE, decodeStart);
+        TRACE_END("decode");
+        unlockCodec();
         // 释放数据包的引用，防止内存泄漏
-        av_packet_unref(packet);
+        av_packet_unref(&pkt);
         if (ret < 0)
         {
             av_frame_unref(frame);
             got_frame = 0;
             continue;
         }
+        else if (pktSerial != packetQueue->getSerial())
+        {
+            // 解码过程中发生了刷新，丢弃旧的音频帧
+            av_frame_unref(frame);
+            got_frame = 0;
+            continue;
+        }
         else
         {
             got_frame = 1;
@@ -0,0 +1,281 @@
+#include "FrameBufferPool.h"
+
+extern "C" {
+#include <libavutil/pixdesc.h>
+};
+
+// 平面起始地址的对齐大小，满足各平台SIMD指令的要求
+#define FRAME_BUFFER_ALIGN 64
+// 每个平面末尾额外的空间，部分解码器的SIMD优化会越界读写少量数据
+#define FRAME_BUFFER_PADDING (16 + FRAME_BUFFER_ALIGN - 1)
+// 缓冲头部记录缓冲大小，释放时更新统计，保持平面起始地址的对齐
+#define FRAME_BUFFER_HEADER FRAME_BUFFER_ALIGN
+
+FrameBufferPool::FrameBufferPool(PlayerState *playerState)
+{
+    this->playerState = playerState;
+    refCount = 1;
+    liveBytes = 0;
+    pool = NULL;
+    format = AV_PIX_FMT_NONE;
+    width = 0;
+    height = 0;
+    memset(linesize, 0, sizeof(linesize));
+    memset(offset, 0, sizeof(offset));
+    planes = 0;
+    bufferSize = 0;
+}
+
+FrameBufferPool::~FrameBufferPool()
+{
+    playerState = NULL;
+}
+
+/**
+ * 安装到解码上下文，只接管支持直接渲染(DR1)的视频解码器
+ * @param avctx
+ * @param codec
+ * @return
+ */
+int FrameBufferPool::attach(AVCodecContext *avctx, AVCodec *codec)
+{
+    if (avctx->codec_type != AVMEDIA_TYPE_VIDEO || !(codec->capabilities & AV_CODEC_CAP_DR1))
+    {
+        return -1;
+    }
+    avctx->opaque = this;
+    avctx->get_buffer2 = FrameBufferPool::getBuffer;
+    // 帧级多线程解码时，允许在解码线程中直接回调
+    avctx->thread_safe_callbacks = 1;
+    return 0;
+}
+
+void FrameBufferPool::acquire()
+{
+    refCount++;
+}
+
+void FrameBufferPool::unref()
+{
+    if (--refCount == 0)
+    {
+        delete this;
+    }
+}
+
+void FrameBufferPool::release()
+{
+    mMutex.lock();
+    if (pool)
+    {
+        // 缓冲池等所有缓冲都归还之后才会销毁，销毁时回调freePool释放引用
+        av_buffer_pool_uninit(&pool);
+        pool = NULL;
+    }
+    mMutex.unlock();
+    unref();
+}
+
+int64_t FrameBufferPool::getLiveBytes()
+{
+    return liveBytes;
+}
+
+/**
+ * 计算缓冲布局，格式或者大小发生变化时，重新创建缓冲池，旧的缓冲池在旧缓冲全部释放之后销毁
+ * @param avctx
+ * @param frame
+ * @return
+ */
+int FrameBufferPool::updatePool(AVCodecContext *avctx, AVFrame *frame)
+{
+    if (pool && format == frame->format && width == frame->width && height == frame->height)
+    {
+        return 0;
+    }
+
+    int w = frame->width;
+    int h = frame->height;
+    int linesize_align[AV_NUM_DATA_POINTERS];
+    int lines[AV_NUM_DATA_POINTERS];
+    uint8_t *data[4];
+    int ret;
+
+    avcodec_align_dimensions2(avctx, &w, &h, linesize_align);
+
+    // 取满足解码器对齐要求的最小宽度，多余的padding越少，上传纹理的数据越少
+    int unaligned;
+    do
+    {
+        ret = av_image_fill_linesizes(lines, (AVPixelFormat) frame->format, w);
+        if (ret < 0)
+        {
+            return ret;
+        }
+        unaligned = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            unaligned |= lines[i] % linesize_align[i];
+        }
+        if (unaligned)
+        {
+            w++;
+        }
+    } while (unaligned);
+
+    // 计算每个平面的大小
+    int size = av_image_fill_pointers(data, (AVPixelFormat) frame->format, h, NULL, lines);
+    if (size < 0)
+    {
+        return size;
+    }
+
+    int count = av_pix_fmt_count_planes((AVPixelFormat) frame->format);
+    int total = 0;
+    if (count <= 0 || count > 4)
+    {
+        return AVERROR(EINVAL);
+    }
+    for (int i = 0; i < count; i++)
+    {
+        intptr_t start = (intptr_t) data[i] - (intptr_t) data[0];
+        intptr_t end = (i + 1 < count) ? (intptr_t) data[i + 1] - (intptr_t) data[0] : size;
+        int planeSize = (int) (end - start);
+        offset[i] = total;
+        linesize[i] = lines[i];
+        total += FFALIGN(planeSize + FRAME_BUFFER_PADDING, FRAME_BUFFER_ALIGN);
+    }
+    for (int i = count; i < AV_NUM_DATA_POINTERS; i++)
+    {
+        offset[i] = 0;
+        linesize[i] = 0;
+    }
+
+    if (pool)
+    {
+        av_buffer_pool_uninit(&pool);
+        pool = NULL;
+    }
+    pool = av_buffer_pool_init2(total, this, FrameBufferPool::allocBuffer,
+                                FrameBufferPool::freePool);
+    if (!pool)
+    {
+        format = AV_PIX_FMT_NONE;
+        return AVERROR(ENOMEM);
+    }
+    acquire();
+
+    format = frame->format;
+    width = frame->width;
+    height = frame->height;
+    planes = count;
+    bufferSize = total;
+
+    av_log(avctx, AV_LOG_VERBOSE, "frame buffer pool: %dx%d %s, linesize %d, %d bytes per frame\n",
+           width, height, av_get_pix_fmt_name((AVPixelFormat) format), linesize[0], bufferSize);
+    return 0;
+}
+
+/**
+ * get_buffer2回调，帧级多线程解码时可能在解码器内部的线程调用，但不会同时调用
+ * @param avctx
+ * @param frame
+ * @param flags
+ * @return
+ */
+int FrameBufferPool::getBuffer(AVCodecContext *avctx, AVFrame *frame, int flags)
+{
+    FrameBufferPool *framePool = (FrameBufferPool *) avctx->opaque;
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get((AVPixelFormat) frame->format);
+
+    // 调色板以及硬件解码格式使用默认的分配方式
+    if (!framePool || !desc
+        || (desc->flags & (AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_PSEUDOPAL | AV_PIX_FMT_FLAG_HWACCEL))
+        || frame->width <= 0 || frame->height <= 0)
+    {
+        return avcodec_default_get_buffer2(avctx, frame, flags);
+    }
+
+    Mutex::Autolock lock(framePool->mMutex);
+    if (framePool->updatePool(avctx, frame) < 0)
+    {
+        return avcodec_default_get_buffer2(avctx, frame, flags);
+    }
+
+    PlayerState *playerState = framePool->playerState;
+    int64_t misses = playerState->framePoolMisses;
+    frame->buf[0] = av_buffer_pool_get(framePool->pool);
+    if (!frame->buf[0])
+    {
+        return AVERROR(ENOMEM);
+    }
+    // 没有走到allocBuffer，说明复用了池里的缓冲
+    if (playerState->framePoolMisses == misses)
+    {
+        playerState->framePoolHits++;
+    }
+
+    for (int i = 0; i < framePool->planes; i++)
+    {
+        frame->data[i] = frame->buf[0]->data + framePool->offset[i];
+        frame->linesize[i] = framePool->linesize[i];
+    }
+    for (int i = framePool->planes; i < AV_NUM_DATA_POINTERS; i++)
+    {
+        frame->data[i] = NULL;
+        frame->linesize[i] = 0;
+    }
+    frame->extended_data = frame->data;
+    return 0;
+}
+
+/**
+ * 缓冲池为空时分配新的缓冲，统计未命中次数以及峰值内存
+ * @param opaque
+ * @param size
+ * @return
+ */
+AVBufferRef *FrameBufferPool::allocBuffer(void *opaque, int size)
+{
+    FrameBufferPool *framePool = (FrameBufferPool *) opaque;
+    uint8_t *data = (uint8_t *) av_malloc((size_t) size + FRAME_BUFFER_HEADER);
+    if (!data)
+    {
+        return NULL;
+    }
+    *(int *) data = size;
+    AVBufferRef *buf = av_buffer_create(data + FRAME_BUFFER_HEADER, size,
+                                        FrameBufferPool::freeBuffer, framePool, 0);
+    if (!buf)
+    {
+        av_free(data);
+        return NULL;
+    }
+
+    int64_t bytes = (framePool->liveBytes += size);
+    PlayerState *playerState = framePool->playerState;
+    playerState->framePoolMisses++;
+    if (bytes > playerState->framePoolPeakBytes)
+    {
+        playerState->framePoolPeakBytes = bytes;
+    }
+    return buf;
+}
+
+void FrameBufferPool::freeBuffer(void *opaque, uint8_t *data)
+{
+    FrameBufferPool *framePool = (FrameBufferPool *) opaque;
+    uint8_t *base = data - FRAME_BUFFER_HEADER;
+    framePool->liveBytes -= *(int *) base;
+    av_free(base);
+}
+
+/**
+ * 缓冲池销毁时回调，此时这个缓冲池分配的缓冲都已经释放
+ * @param opaque
+ */
+void FrameBufferPool::freePool(void *opaque)
+{
+    FrameBufferPool *framePool = (FrameBufferPool *) opaque;
+    framePool->unref();
+}
@@ -0,0 +1,63 @@
+#ifndef FRAMEBUFFERPOOL_H
+#define FRAMEBUFFERPOOL_H
+
+#include <atomic>
+#include <player/PlayerState.h>
+
+/**
+ * 视频解码帧缓冲池，通过AVCodecContext的get_buffer2回调为解码器分配帧缓冲
+ * 每一帧的所有平面放在同一块缓冲里面，按照分辨率和像素格式回收复用，避免长时间播放时反复申请释放大块内存
+ * linesize取满足解码器对齐要求的最小宽度，并保证色度平面的linesize刚好是亮度平面的一半，
+ * 上传纹理时多出来的padding最少，InputRenderNode::cropTexVertices的裁剪比例也对所有平面一致
+ * 缓冲池使用引用计数管理，解码器销毁之后还在帧队列或者渲染线程中的缓冲依然可以安全释放
+ */
+class FrameBufferPool
+{
+public:
+    FrameBufferPool(PlayerState *playerState);
+
+    // 安装到解码上下文，需要在avcodec_open2之前调用，解码器不支持自定义缓冲时保持默认的分配方式
+    int attach(AVCodecContext *avctx, AVCodec *codec);
+
+    // 释放持有者的引用，缓冲池在所有缓冲都释放之后才会真正销毁
+    void release();
+
+    // 获取当前还没有释放的缓冲的总大小
+    int64_t getLiveBytes();
+
+    // get_buffer2回调
+    static int getBuffer(AVCodecContext *avctx, AVFrame *frame, int flags);
+
+private:
+    virtual ~FrameBufferPool();
+
+    void acquire();
+
+    void unref();
+
+    // 按照帧的格式和大小计算缓冲布局，变化时重新创建缓冲池
+    int updatePool(AVCodecContext *avctx, AVFrame *frame);
+
+    static AVBufferRef *allocBuffer(void *opaque, int size);
+
+    static void freeBuffer(void *opaque, uint8_t *data);
+
+    static void freePool(void *opaque);
+
+private:
+    Mutex mMutex;
+    std::atomic<int> refCount;          // 引用计数，持有者以及每一个还没销毁的AVBufferPool各占一个
+    std::atomic<int64_t> liveBytes;     // 还没有释放的缓冲的总大小
+    PlayerState *playerState;
+    AVBufferPool *pool;                 // 当前格式和大小对应的缓冲池
+    int format;                         // 缓冲池的像素格式
+    int width;                          // 缓冲池的帧宽度
+    int height;                         // 缓冲池的帧高度
+    int linesize[AV_NUM_DATA_POINTERS]; // 每个平面的linesize
+    int offset[AV_NUM_DATA_POINTERS];   // 每个平面在缓冲中的偏移
+    int planes;                         // 平面数量
+    int bufferSize;                     // 每一帧的缓冲大小
+};
+
+
+#endif //FRAMEBUFFERPOOL_H
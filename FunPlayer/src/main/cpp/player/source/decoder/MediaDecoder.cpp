@@ -8,6 +8,18 @@ MediaDecoder::MediaDecoder(AVCodecContext *avctx, AVStream *stream, int streamIn
     this->pStream = stream;
     this->streamIndex = streamIndex;
     this->playerState = playerState;
+    this->pktSerial = -1;
+    seekSerial = -1;
+    seekTarget = AV_NOPTS_VALUE;
+    seekStartTime = 0;
+    seekReport = 0;
+    catchupFrames = 0;
+    // 数据包队列消耗到低水位时唤醒读包线程
+    packetQueue->setLowWatermark(LOW_WATERMARK_FRAMES,
+                                 (int64_t) (LOW_WATERMARK_DURATION / av_q2d(stream->time_base)),
+                                 &playerState->readMutex, &playerState->readCondition);
+    // 队列占用内存过大时读包线程等待所有队列的总占用降到低水位
+    packetQueue->setMemoryWatermark(&playerState->queueMemorySize, LOW_WATERMARK_QUEUE_SIZE);
 }
 
 MediaDecoder::~MediaDecoder()
@@ -19,6 +31,7 @@ MediaDecoder::~MediaDecoder()
         delete packetQueue;
         packetQueue = NULL;
     }
+    // 解码线程已经退出，解码上下文不再有别的线程使用
     if (pCodecCtx)
     {
         avcodec_close(pCodecCtx);
@@ -55,14 +68,12 @@ void MediaDecoder::stop()
 
 void MediaDecoder::flush()
 {
+    // 定位时，音视频均需要清空缓冲区
+    // 这里只刷新数据包队列，解码上下文由解码线程在取到新序列号的数据包时清空，不需要跟解码线程抢锁
     if (packetQueue)
     {
         packetQueue->flush();
     }
-    // 定位时，音视频均需要清空缓冲区
-    playerState->mMutex.lock();
-    avcodec_flush_buffers(getCodecContext());
-    playerState->mMutex.unlock();
 }
 
 int MediaDecoder::pushPacket(AVPacket *pkt)
@@ -74,11 +85,25 @@ int MediaDecoder::pushPacket(AVPacket *pkt)
     return 0;
 }
 
+int MediaDecoder::pushNullPacket()
+{
+    if (packetQueue)
+    {
+        return packetQueue->pushNullPacket(streamIndex);
+    }
+    return 0;
+}
+
 int MediaDecoder::getPacketSize()
 {
     return packetQueue ? packetQueue->getPacketSize() : 0;
 }
 
+int MediaDecoder::getPacketSerial()
+{
+    return packetQueue ? packetQueue->getSerial() : -1;
+}
+
 int MediaDecoder::getStreamIndex()
 {
     return streamIndex;
@@ -104,9 +129,78 @@ int MediaDecoder::hasEnoughPackets()
     Mutex::Autolock lock(mMutex);
     return (packetQueue == NULL) || (packetQueue->isAbort())
            || (pStream->disposition & AV_DISPOSITION_ATTACHED_PIC)
-           || (packetQueue->getPacketSize() > MIN_FRAMES)
-              && (!packetQueue->getDuration()
-                  || av_q2d(pStream->time_base) * packetQueue->getDuration() > 1.0);
+           || ((packetQueue->getPacketSize() > MIN_FRAMES)
+               && (!packetQueue->getDuration()
+                   || av_q2d(pStream->time_base) * packetQueue->getDuration() > 1.0));
+}
+
+int MediaDecoder::isLowWatermark()
+{
+    Mutex::Autolock lock(mMutex);
+    return (packetQueue != NULL) && !packetQueue->isAbort()
+           && !(pStream->disposition & AV_DISPOSITION_ATTACHED_PIC)
+           && packetQueue->isLowWatermark();
+}
+
+/**
+ * 设置精确定位的目标
+ * 必须在刷新之后、送入新序列号的数据包之前调用，解码线程取到新序列号的数据包时目标已经生效
+ * @param target    目标时间(AV_TIME_BASE)，AV_NOPTS_VALUE表示取消
+ * @param report    是否统计追赶的耗时和帧数
+ */
+void MediaDecoder::setSeekTarget(int64_t target, int report)
+{
+    if (target == AV_NOPTS_VALUE || !packetQueue)
+    {
+        seekSerial = -1;
+        return;
+    }
+    seekTarget = target;
+    seekStartTime = av_gettime_relative();
+    seekReport = report;
+    seekSerial = packetQueue->getSerial();
+}
+
+double MediaDecoder::getSeekTarget()
+{
+    if (pktSerial < 0 || seekSerial != pktSerial)
+    {
+        return NAN;
+    }
+    return seekTarget / (double) AV_TIME_BASE;
+}
+
+/**
+ * 判断解码帧是否在定位目标之前，只能在解码线程中调用
+ * 在目标之前结束的帧丢弃，不做转换和上传；第一个覆盖目标的帧结束追赶
+ * @param pts       帧的显示时间(秒)，NAN表示未知
+ * @param duration  帧的时长(秒)
+ * @return 1表示需要丢弃
+ */
+int MediaDecoder::isBeforeSeekTarget(double pts, double duration)
+{
+    double target = getSeekTarget();
+    if (isnan(target))
+    {
+        catchupFrames = 0;
+        return 0;
+    }
+    if (!isnan(pts) && pts + duration <= target)
+    {
+        catchupFrames++;
+        return 1;
+    }
+    // 追赶完成，同一个序列号只统计一次
+    int serial = pktSerial;
+    if (seekSerial.compare_exchange_strong(serial, -1) && seekReport && playerState)
+    {
+        playerState->accurateSeeks++;
+        playerState->catchupFrames += catchupFrames;
+        playerState->catchupTime.add(av_gettime_relative() - seekStartTime);
+        TRACE_INSTANT("seek_catchup", catchupFrames);
+    }
+    catchupFrames = 0;
+    return 0;
 }
 
 void MediaDecoder::run()
@@ -114,3 +208,59 @@ void MediaDecoder::run()
     // do nothing
 }
 
+/**
+ * 取出数据包，只能在解码线程中调用
+ * 数据包的序列号跟上一个数据包不一样时，表示中间发生了刷新(定位)，需要先清空解码上下文的缓冲
+ * @param pkt
+ * @return
+ */
+int MediaDecoder::readPacket(AVPacket *pkt)
+{
+    int serial;
+    int ret = packetQueue->getPacket(pkt, 1, &serial);
+    if (ret < 0)
+    {
+        return ret;
+    }
+    if (serial != pktSerial)
+    {
+        if (pktSerial >= 0)
+        {
+            lockCodec();
+            avcodec_flush_buffers(pCodecCtx);
+            unlockCodec();
+        }
+        pktSerial = serial;
+    }
+    return ret;
+}
+
+
+/**
+ * 锁定解码上下文
+ * 解码、刷新都在解码器自己的线程中执行，解码上下文不会被别的线程访问，正常情况下不加锁
+ * 开启串行解码时音视频解码共用一把锁，复现原来全局锁的行为，统计等待锁的时长用于对比
+ */
+void MediaDecoder::lockCodec()
+{
+    if (!playerState->serialDecode)
+    {
+        return;
+    }
+    if (playerState->codecMutex.tryLock() == 0)
+    {
+        return;
+    }
+    TRACE_SCOPE("codec_lock");
+    int64_t start = av_gettime_relative();
+    playerState->codecMutex.lock();
+    playerState->codecLockWaitTime += av_gettime_relative() - start;
+}
+
+void MediaDecoder::unlockCodec()
+{
+    if (playerState->serialDecode)
+    {
+        playerState->codecMutex.unlock();
+    }
+}
@@ -22,8 +22,14 @@ public:
 
     int pushPacket(AVPacket *pkt);
 
+    // 送入空数据包，解码器输出缓存的所有帧
+    int pushNullPacket();
+
     int getPacketSize();
 
+    // 获取数据包队列当前的序列号
+    int getPacketSerial();
+
     int getStreamIndex();
 
     AVStream *getStream();
@@ -34,8 +40,32 @@ public:
 
     int hasEnoughPackets();
 
+    // 数据包队列是否被消耗到低水位以下
+    int isLowWatermark();
+
+    // 设置精确定位的目标时间(AV_TIME_BASE)，刷新之后、送入新数据包之前调用
+    // 当前序列号解码出来的、在目标之前结束的帧全部丢弃，report表示是否统计追赶的耗时
+    void setSeekTarget(int64_t target, int report);
+
+    // 以下两个方法只能在解码线程中调用
+    // 获取正在解码的序列号对应的精确定位目标(秒)，没有目标或者已经追赶完成时返回NAN
+    double getSeekTarget();
+
+    // 解码帧是否在定位目标之前，是则计入追赶帧数，否则结束追赶并统计耗时
+    int isBeforeSeekTarget(double pts, double duration);
+
     virtual void run();
 
+protected:
+    // 取出数据包，序列号变化时清空解码上下文的缓冲
+    int readPacket(AVPacket *pkt);
+
+    // 锁定解码上下文，只在串行解码的对比模式下加锁，并统计等待锁的时长
+    void lockCodec();
+
+    // 解锁解码上下文
+    void unlockCodec();
+
 protected:
     Mutex mMutex;
     Condition mCondition;
@@ -45,6 +75,13 @@ protected:
     AVCodecContext *pCodecCtx;
     AVStream *pStream;
     int streamIndex;
+    int pktSerial;                  // 正在解码的数据包序列号
+
+    std::atomic<int> seekSerial;            // 精确定位对应的序列号，-1表示没有定位目标
+    std::atomic<int64_t> seekTarget;        // 精确定位的目标时间(AV_TIME_BASE)
+    std::atomic<int64_t> seekStartTime;     // 设置定位目标的时间
+    std::atomic<int> seekReport;            // 是否统计追赶的耗时
+    int catchupFrames;                      // 追赶过程中丢弃的帧数，只在解码线程中访问
 };
 
 
@@ -1,11 +1,14 @@
 #include "VideoDecoder.h"
 
 VideoDecoder::VideoDecoder(AVFormatContext *pFormatCtx, AVCodecContext *avctx,
-                           AVStream *stream, int streamIndex, PlayerState *playerState)
+                           AVStream *stream, int streamIndex, PlayerState *playerState,
+                           FrameBufferPool *framePool)
         : MediaDecoder(avctx, stream, streamIndex, playerState)
 {
     this->pFormatCtx = pFormatCtx;
-    frameQueue = new FrameQueue(VIDEO_QUEUE_SIZE, 1);
+    this->framePool = framePool;
+    convertor = new VideoConvertor(playerState);
+    frameQueue = new VideoFrameQueue(1);
     mExit = true;
     masterClock = NULL;
     // 旋转角度
@@ -30,6 +33,17 @@ VideoDecoder::~VideoDecoder()
         delete frameQueue;
         frameQueue = NULL;
     }
+    if (convertor)
+    {
+        delete convertor;
+        convertor = NULL;
+    }
+    // 还没有释放的缓冲会在归还之后再销毁缓冲池
+    if (framePool)
+    {
+        framePool->release();
+        framePool = NULL;
+    }
     masterClock = NULL;
     mMutex.unlock();
 }
@@ -66,19 +80,14 @@ void VideoDecoder::stop()
     }
     mMutex.unlock();
 
-    decodeThread.join();
-}
-
-void VideoDecoder::flush()
-{
-    mMutex.lock();
-    MediaDecoder::flush();
-    if (frameQueue)
+    if (decodeThread.joinable())
     {
-        frameQueue->flush();
+        decodeThread.join();
+    }
+    if (convertor)
+    {
+        convertor->stop();
     }
-    mCondition.signal();
-    mMutex.unlock();
 }
 
 int VideoDecoder::getFrameSize()
@@ -93,7 +102,7 @@ int VideoDecoder::getRotate()
     return mRotate;
 }
 
-FrameQueue *VideoDecoder::getFrameQueue()
+VideoFrameQueue *VideoDecoder::getFrameQueue()
 {
     Mutex::Autolock lock(mMutex);
     return frameQueue;
@@ -123,6 +132,11 @@ int VideoDecoder::decodeVideo()
 
     AVRational tb = pStream->time_base;
     AVRational frame_rate = av_guess_frame_rate(pFormatCtx, pStream, NULL);
+    double frame_duration = frame_rate.num && frame_rate.den
+                            ? av_q2d((AVRational) {frame_rate.den, frame_rate.num}) : 0;
+    enum AVDiscard skip_frame = AVDISCARD_DEFAULT;
+
+    TRACE_THREAD("video_decode");
 
     if (!frame)
     {
@@ -148,39 +162,73 @@ int VideoDecoder::decodeVideo()
             break;
         }
 
-        if (playerState->seekRequest)
         {
-            continue;
+            TRACE_SCOPE("read_packet");
+            ret = readPacket(packet);
         }
-
-        if (packetQueue->getPacket(packet) < 0)
+        if (ret < 0)
         {
             ret = -1;
             break;
         }
 
+        // 拖动时只解码关键帧，解复用器不支持丢弃非关键帧时在这里丢弃
+        if (playerState->scrubbing && packet->data && !(packet->flags & AV_PKT_FLAG_KEY))
+        {
+            av_packet_unref(packet);
+            continue;
+        }
+
+        // 精确定位追赶期间，显示时间在目标之前的数据包跳过非参考帧，解码器不支持时照常解码
+        double seek_target = getSeekTarget();
+        enum AVDiscard discard = AVDISCARD_DEFAULT;
+        if (!isnan(seek_target) && packet->data && packet->pts != AV_NOPTS_VALUE
+            && packet->pts * av_q2d(tb) + frame_duration <= seek_target)
+        {
+            discard = AVDISCARD_NONREF;
+        }
+
         // 送去解码
-        playerState->mMutex.lock();
+        lockCodec();
+        if (skip_frame != discard)
+        {
+            skip_frame = discard;
+            pCodecCtx->skip_frame = discard;
+        }
+        TRACE_BEGIN("decode");
+        STATS_BEGIN(decodeStart);
         ret = avcodec_send_packet(pCodecCtx, packet);
         if (ret < 0 && ret != AVERROR(EAGAIN) && ret != AVERROR_EOF)
         {
             av_packet_unref(packet);
-            playerState->mMutex.unlock();
+            TRACE_END("decode");
+            unlockCodec();
             continue;
         }
 
         // 得到解码帧
         ret = avcodec_receive_frame(pCodecCtx, frame);
-        playerState->mMutex.unlock();
-        if (ret < 0 && ret != AVERROR_EOF)
+        STATS_END(playerState, STAGE_VIDEO_DECODE, decodeStart);
+        TRACE_END("decode");
+        unlockCodec();
+        // 送入空数据包之后解码器进入结束状态，直到序列号变化时刷新，期间没有输出
+        if (ret < 0)
         {
             av_frame_unref(frame);
             av_packet_unref(packet);
             continue;
         }
+        else if (pktSerial != packetQueue->getSerial())
+        {
+            // 解码过程中发生了刷新，丢弃旧的视频帧
+            av_frame_unref(frame);
+            av_packet_unref(packet);
+            continue;
+        }
         else
         {
             got_picture = 1;
+            playerState->decodedFrames++;
 
             // 是否重排pts，默认情况下需要重排pts的
             if (playerState->reorderVideoPts == -1)
@@ -192,6 +240,15 @@ int VideoDecoder::decodeVideo()
                 frame->pts = frame->pkt_dts;
             }
 
+            // 精确定位追赶期间，目标之前的帧直接丢弃，不做转换和上传
+            if (isBeforeSeekTarget(frame->pts == AV_NOPTS_VALUE ? NAN : frame->pts * av_q2d(tb),
+                                   frame_duration))
+            {
+                av_frame_unref(frame);
+                av_packet_unref(packet);
+                continue;
+            }
+
             // 丢帧处理
             if (masterClock != NULL)
             {
@@ -204,9 +261,9 @@ int VideoDecoder::decodeVideo()
                 // 计算视频帧的长宽比
                 frame->sample_aspect_ratio = av_guess_sample_aspect_ratio(pFormatCtx, pStream,
                                                                           frame);
-                // 是否需要做舍帧操作
-                if (playerState->frameDrop > 0 ||
-                    (playerState->frameDrop > 0 && playerState->syncType != AV_SYNC_VIDEO))
+                // 是否需要做舍帧操作，拖动时的关键帧立即显示，不根据时钟丢弃
+                if (!playerState->scrubbing && (playerState->frameDrop > 0 ||
+                    (playerState->frameDrop > 0 && playerState->syncType != AV_SYNC_VIDEO)))
                 {
                     if (frame->pts != AV_NOPTS_VALUE)
                     {
@@ -216,6 +273,7 @@ int VideoDecoder::decodeVideo()
                         {
                             av_frame_unref(frame);
                             got_picture = 0;
+                            playerState->droppedFrames++;
                         }
                     }
                 }
@@ -226,7 +284,10 @@ int VideoDecoder::decodeVideo()
         {
 
             // 取出帧
-            if (!(vp = frameQueue->peekWritable()))
+            TRACE_BEGIN("wait_frame_slot");
+            vp = frameQueue->peekWritable();
+            TRACE_END("wait_frame_slot");
+            if (!vp)
             {
                 ret = -1;
                 break;
@@ -238,9 +299,21 @@ int VideoDecoder::decodeVideo()
             vp->height = frame->height;
             vp->format = frame->format;
             vp->pts = (frame->pts == AV_NOPTS_VALUE) ? NAN : frame->pts * av_q2d(tb);
-            vp->duration = frame_rate.num && frame_rate.den
-                           ? av_q2d((AVRational) {frame_rate.den, frame_rate.num}) : 0;
-            av_frame_move_ref(vp->frame, frame);
+            vp->serial = pktSerial;
+            vp->duration = frame_duration;
+            // 渲染端不能直接上传的格式，在入队之前转换，转换失败时由同步线程转换
+            TRACE_BEGIN("convert");
+            int converted = VideoConvertor::needConvert(frame->format)
+                            && convertor->convert(frame, vp->frame) >= 0;
+            TRACE_END("convert");
+            if (converted)
+            {
+                vp->format = vp->frame->format;
+            }
+            else
+            {
+                av_frame_move_ref(vp->frame, frame);
+            }
 
             // 入队帧
             frameQueue->pushFrame();
@@ -2,14 +2,20 @@
 #define VIDEODECODER_H
 
 #include <decoder/MediaDecoder.h>
+#include <decoder/FrameBufferPool.h>
+#include <convertor/VideoConvertor.h>
 #include <player/PlayerState.h>
 #include <sync/MediaClock.h>
 
+// 视频帧队列
+typedef FrameQueue<VIDEO_QUEUE_SIZE> VideoFrameQueue;
+
 class VideoDecoder : public MediaDecoder
 {
 public:
     VideoDecoder(AVFormatContext *pFormatCtx, AVCodecContext *avctx,
-                 AVStream *stream, int streamIndex, PlayerState *playerState);
+                 AVStream *stream, int streamIndex, PlayerState *playerState,
+                 FrameBufferPool *framePool = NULL);
 
     virtual ~VideoDecoder();
 
@@ -19,13 +25,11 @@ public:
 
     void stop() override;
 
-    void flush() override;
-
     int getFrameSize();
 
     int getRotate();
 
-    FrameQueue *getFrameQueue();
+    VideoFrameQueue *getFrameQueue();
 
     AVFormatContext *getFormatContext();
 
@@ -37,7 +41,9 @@ private:
 
 private:
     AVFormatContext *pFormatCtx;    // 解复用上下文
-    FrameQueue *frameQueue;         // 帧队列
+    VideoFrameQueue *frameQueue;    // 帧队列
+    FrameBufferPool *framePool;     // 解码帧缓冲池
+    VideoConvertor *convertor;      // 渲染端不支持的格式在入队前转换
     int mRotate;                    // 旋转角度
 
     bool mExit;                     // 退出标志
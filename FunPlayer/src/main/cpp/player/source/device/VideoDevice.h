@@ -2,7 +2,7 @@
 #define VIDEODEVICE_H
 
 #include <player/PlayerState.h>
-#include <renderer/GLInputFilter.h>
+#include <renderer/TextureType.h>
 
 class VideoDevice
 {
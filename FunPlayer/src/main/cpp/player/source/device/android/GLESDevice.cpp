@@ -1,5 +1,6 @@
 #include <AndroidLog.h>
 #include <renderer/CoordinateUtils.h>
+#include <common/TraceRecorder.h>
 #include "GLESDevice.h"
 
 GLESDevice::GLESDevice()
@@ -155,7 +156,9 @@ int GLESDevice::onUpdateYUV(uint8_t *yData, int yPitch, uint8_t *uData, int uPit
     {
         return -1;
     }
+    TRACE_BEGIN("device_lock");
     mMutex.lock();
+    TRACE_END("device_lock");
     mVideoTexture->pitches[0] = yPitch;
     mVideoTexture->pitches[1] = uPitch;
     mVideoTexture->pitches[2] = vPitch;
@@ -179,7 +182,9 @@ int GLESDevice::onUpdateARGB(uint8_t *rgba, int pitch)
     {
         return -1;
     }
+    TRACE_BEGIN("device_lock");
     mMutex.lock();
+    TRACE_END("device_lock");
     mVideoTexture->pitches[0] = pitch;
     mVideoTexture->pixels[0] = rgba;
     if (mRenderNode != NULL && eglSurface != EGL_NO_SURFACE)
@@ -199,7 +204,9 @@ int GLESDevice::onRequestRender(bool flip)
     {
         return -1;
     }
+    TRACE_BEGIN("device_lock");
     mMutex.lock();
+    TRACE_END("device_lock");
     mVideoTexture->direction = flip ? FLIP_VERTICAL : FLIP_NONE;
     ALOGD("flip ? %d", flip);
     if (mRenderNode != NULL && eglSurface != EGL_NO_SURFACE)
@@ -210,7 +217,9 @@ int GLESDevice::onRequestRender(bool flip)
             mRenderNode->setDisplaySize(mSurfaceWidth, mSurfaceHeight);
         }
         mRenderNode->drawFrame(mVideoTexture);
+        TRACE_BEGIN("swap_buffers");
         eglHelper->swapBuffers(eglSurface);
+        TRACE_END("swap_buffers");
     }
     mMutex.unlock();
     return 0;
@@ -70,7 +70,10 @@ void SLESDevice::stop()
     abortRequest = 1;
     mCondition.signal();
     mMutex.unlock();
-    audioThread.join();
+    if (audioThread.joinable())
+    {
+        audioThread.join();
+    }
 }
 
 void SLESDevice::pause()
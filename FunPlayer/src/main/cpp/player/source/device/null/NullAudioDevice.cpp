@@ -0,0 +1,154 @@
+#include <AndroidLog.h>
+#include "NullAudioDevice.h"
+
+NullAudioDevice::NullAudioDevice()
+{
+    memset(&audioDeviceSpec, 0, sizeof(AudioDeviceSpec));
+    bytes_per_buffer = 0;
+    buffer_duration = 0;
+    buffer = NULL;
+    abortRequest = 1;
+    pauseRequest = 0;
+}
+
+NullAudioDevice::~NullAudioDevice()
+{
+    mMutex.lock();
+    memset(&audioDeviceSpec, 0, sizeof(AudioDeviceSpec));
+    if (buffer)
+    {
+        free(buffer);
+        buffer = NULL;
+    }
+    mMutex.unlock();
+}
+
+/**
+ * 打开音频设备，缓冲区大小由期望的采样数决定
+ * @param desired
+ * @param obtained
+ * @return
+ */
+int NullAudioDevice::open(const AudioDeviceSpec *desired, AudioDeviceSpec *obtained)
+{
+    if (desired->format != AV_SAMPLE_FMT_S16 || desired->channels <= 0 || desired->freq <= 0
+        || desired->samples <= 0)
+    {
+        return -1;
+    }
+
+    bytes_per_buffer = desired->samples * desired->channels * av_get_bytes_per_sample(desired->format);
+    buffer_duration = (int64_t) desired->samples * 1000000 / desired->freq;
+
+    buffer = (uint8_t *) malloc((size_t) bytes_per_buffer);
+    if (!buffer)
+    {
+        ALOGE("%s: failed to alloc buffer %d\n", __func__, bytes_per_buffer);
+        return -1;
+    }
+    memset(buffer, 0, (size_t) bytes_per_buffer);
+
+    if (obtained != NULL)
+    {
+        *obtained = *desired;
+        obtained->size = (uint32_t) bytes_per_buffer;
+    }
+    audioDeviceSpec = *desired;
+
+    return bytes_per_buffer;
+}
+
+void NullAudioDevice::start()
+{
+    if (audioDeviceSpec.callback != NULL)
+    {
+        abortRequest = 0;
+        pauseRequest = 0;
+
+        audioThread = std::thread(&NullAudioDevice::run, this);
+    }
+    else
+    {
+        ALOGE("audio device callback is NULL!");
+    }
+}
+
+void NullAudioDevice::stop()
+{
+    mMutex.lock();
+    abortRequest = 1;
+    mCondition.signal();
+    mMutex.unlock();
+    if (audioThread.joinable())
+    {
+        audioThread.join();
+    }
+}
+
+void NullAudioDevice::pause()
+{
+    mMutex.lock();
+    pauseRequest = 1;
+    mCondition.signal();
+    mMutex.unlock();
+}
+
+void NullAudioDevice::resume()
+{
+    mMutex.lock();
+    pauseRequest = 0;
+    mCondition.signal();
+    mMutex.unlock();
+}
+
+void NullAudioDevice::flush()
+{
+    // 没有硬件缓冲，不需要清空
+}
+
+void NullAudioDevice::setStereoVolume(float left_volume, float right_volume)
+{
+    // 不输出声音，忽略音量
+}
+
+/**
+ * 按照缓冲区时长的节奏取数据，模拟声卡的消耗速度，使音频时钟按真实时间推进
+ */
+void NullAudioDevice::run()
+{
+    int64_t next_time = av_gettime_relative();
+
+    while (true)
+    {
+        mMutex.lock();
+        while (!abortRequest && pauseRequest)
+        {
+            mCondition.wait(mMutex);
+            next_time = av_gettime_relative();
+        }
+        if (abortRequest)
+        {
+            mMutex.unlock();
+            break;
+        }
+        mMutex.unlock();
+
+        // 通过回调取出PCM数据
+        audioDeviceSpec.callback(audioDeviceSpec.userdata, buffer, bytes_per_buffer);
+
+        // 等待下一个缓冲区的回调时间，落后太多时重新对齐，避免连续追赶
+        next_time += buffer_duration;
+        int64_t time = av_gettime_relative();
+        if (time - next_time > buffer_duration)
+        {
+            next_time = time;
+        }
+        mMutex.lock();
+        while (!abortRequest && time < next_time)
+        {
+            mCondition.waitRelative(mMutex, (next_time - time) * 1000);
+            time = av_gettime_relative();
+        }
+        mMutex.unlock();
+    }
+}
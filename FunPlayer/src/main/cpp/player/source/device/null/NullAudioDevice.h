@@ -0,0 +1,46 @@
+#ifndef NULLAUDIODEVICE_H
+#define NULLAUDIODEVICE_H
+
+#include <device/AudioDevice.h>
+
+/**
+ * 空音频输出设备，不输出声音，按照采样率的节奏回调取PCM数据，用于桌面端无头播放
+ */
+class NullAudioDevice : public AudioDevice
+{
+public:
+    NullAudioDevice();
+
+    virtual ~NullAudioDevice();
+
+    int open(const AudioDeviceSpec *desired, AudioDeviceSpec *obtained) override;
+
+    void start() override;
+
+    void stop() override;
+
+    void pause() override;
+
+    void resume() override;
+
+    void flush() override;
+
+    void setStereoVolume(float left_volume, float right_volume) override;
+
+    void run() override;
+
+private:
+    AudioDeviceSpec audioDeviceSpec;    // 音频设备参数
+    int bytes_per_buffer;               // 一个缓冲区的大小
+    int64_t buffer_duration;            // 一个缓冲区的时长(微秒)
+    uint8_t *buffer;                    // 缓冲区
+
+    Mutex mMutex;
+    Condition mCondition;
+    std::thread audioThread;            // 音频播放线程
+    int abortRequest;                   // 终止标志
+    int pauseRequest;                   // 暂停标志
+};
+
+
+#endif //NULLAUDIODEVICE_H
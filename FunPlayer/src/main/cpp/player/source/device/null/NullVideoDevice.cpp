@@ -0,0 +1,55 @@
+#include "NullVideoDevice.h"
+
+NullVideoDevice::NullVideoDevice()
+{
+    mUploadedFrames = 0;
+    mRenderedFrames = 0;
+    mFirstRenderTime = AV_NOPTS_VALUE;
+}
+
+NullVideoDevice::~NullVideoDevice()
+{
+
+}
+
+void NullVideoDevice::onInitTexture(int width, int height, TextureFormat format,
+                                    BlendMode blendMode, int rotate)
+{
+
+}
+
+int NullVideoDevice::onUpdateYUV(uint8_t *yData, int yPitch, uint8_t *uData, int uPitch,
+                                 uint8_t *vData, int vPitch)
+{
+    mUploadedFrames++;
+    return 0;
+}
+
+int NullVideoDevice::onUpdateARGB(uint8_t *rgba, int pitch)
+{
+    mUploadedFrames++;
+    return 0;
+}
+
+int NullVideoDevice::onRequestRender(bool flip)
+{
+    int64_t noPts = AV_NOPTS_VALUE;
+    mFirstRenderTime.compare_exchange_strong(noPts, av_gettime_relative());
+    mRenderedFrames++;
+    return 0;
+}
+
+int64_t NullVideoDevice::getUploadedFrames() const
+{
+    return mUploadedFrames;
+}
+
+int64_t NullVideoDevice::getRenderedFrames() const
+{
+    return mRenderedFrames;
+}
+
+int64_t NullVideoDevice::getFirstRenderTime() const
+{
+    return mFirstRenderTime;
+}
@@ -0,0 +1,42 @@
+#ifndef NULLVIDEODEVICE_H
+#define NULLVIDEODEVICE_H
+
+#include <atomic>
+#include <device/VideoDevice.h>
+
+/**
+ * 空视频输出设备，不做渲染，只统计送显的帧，用于桌面端无头播放
+ */
+class NullVideoDevice : public VideoDevice
+{
+public:
+    NullVideoDevice();
+
+    virtual ~NullVideoDevice();
+
+    void onInitTexture(int width, int height, TextureFormat format, BlendMode blendMode,
+                       int rotate) override;
+
+    int onUpdateYUV(uint8_t *yData, int yPitch, uint8_t *uData, int uPitch,
+                    uint8_t *vData, int vPitch) override;
+
+    int onUpdateARGB(uint8_t *rgba, int pitch) override;
+
+    int onRequestRender(bool flip) override;
+
+    // 获取上传的帧数
+    int64_t getUploadedFrames() const;
+
+    // 获取送显的帧数
+    int64_t getRenderedFrames() const;
+
+    // 获取第一帧送显的时间(av_gettime_relative，微秒)，没有送显时返回AV_NOPTS_VALUE
+    int64_t getFirstRenderTime() const;
+
+private:
+    std::atomic<int64_t> mUploadedFrames;   // 上传的帧数
+    std::atomic<int64_t> mRenderedFrames;   // 送显的帧数
+    std::atomic<int64_t> mFirstRenderTime;  // 第一帧送显时间
+};
+
+#endif //NULLVIDEODEVICE_H
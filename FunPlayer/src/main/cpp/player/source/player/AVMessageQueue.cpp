@@ -7,11 +7,22 @@ AVMessageQueue::AVMessageQueue()
     mSize = 0;
     mFirstMsg = 0;
     mLastMsg = 0;
+    mCoalesced = 0;
+    mAllocated = 0;
+
+    // 空闲节点链表
+    mFreeMsg = NULL;
+    for (int i = MESSAGE_POOL_SIZE - 1; i >= 0; --i)
+    {
+        message_init(&mPool[i]);
+        mPool[i].next = mFreeMsg;
+        mFreeMsg = &mPool[i];
+    }
 }
 
 AVMessageQueue::~AVMessageQueue()
 {
-
+    flush();
 }
 
 void AVMessageQueue::start()
@@ -37,7 +48,7 @@ void AVMessageQueue::flush()
     for (msg = mFirstMsg; msg != NULL; msg = msg1)
     {
         msg1 = msg->next;
-        av_freep(&msg);
+        recycleNode(msg);
     }
     mFirstMsg = NULL;
     mLastMsg = NULL;
@@ -84,7 +95,11 @@ void AVMessageQueue::postMessage(int what, int arg1, int arg2, void *obj, int le
     msg.what = what;
     msg.arg1 = arg1;
     msg.arg2 = arg2;
-    msg.obj = av_malloc(sizeof(len));
+    msg.obj = av_malloc(len);
+    if (!msg.obj)
+    {
+        return;
+    }
     memcpy(msg.obj, obj, len);
     msg.free = message_free;
     putMessage(&msg);
@@ -96,9 +111,15 @@ int AVMessageQueue::getMessage(AVMessage *msg)
 }
 
 int AVMessageQueue::getMessage(AVMessage *msg, int block)
+{
+    return getMessage(msg, block, 0);
+}
+
+int AVMessageQueue::getMessage(AVMessage *msg, int block, int timeoutMs)
 {
     AVMessage *msg1;
     int ret;
+    int64_t deadline = timeoutMs > 0 ? av_gettime_relative() + timeoutMs * 1000LL : 0;
     mMutex.lock();
     for (;;)
     {
@@ -117,8 +138,9 @@ int AVMessageQueue::getMessage(AVMessage *msg, int block)
             }
             mSize--;
             *msg = *msg1;
+            msg->next = NULL;
             msg1->obj = NULL;
-            av_free(msg1);
+            recycleNode(msg1);
             ret = 1;
             break;
         }
@@ -127,6 +149,16 @@ int AVMessageQueue::getMessage(AVMessage *msg, int block)
             ret = 0;
             break;
         }
+        else if (deadline > 0)
+        {
+            int64_t remaining = deadline - av_gettime_relative();
+            if (remaining <= 0)
+            {
+                ret = 0;
+                break;
+            }
+            mCondition.waitRelative(mMutex, remaining * 1000);
+        }
         else
         {
             mCondition.wait(mMutex);
@@ -152,7 +184,7 @@ void AVMessageQueue::removeMessage(int what)
             if (msg->what == what)
             {
                 *p_msg = msg->next;
-                av_free(msg);
+                recycleNode(msg);
                 mSize--;
             }
             else
@@ -174,18 +206,106 @@ void AVMessageQueue::removeMessage(int what)
     mCondition.signal();
 }
 
+bool AVMessageQueue::isCoalescable(int what)
+{
+    return what == MSG_CURRENT_POSITON
+           || what == MSG_BUFFERING_UPDATE
+           || what == MSG_BUFFERING_TIME_UPDATE;
+}
+
+int64_t AVMessageQueue::getCoalescedCount()
+{
+    Mutex::Autolock lock(mMutex);
+    return mCoalesced;
+}
+
+int64_t AVMessageQueue::getAllocatedCount()
+{
+    Mutex::Autolock lock(mMutex);
+    return mAllocated;
+}
+
+AVMessage *AVMessageQueue::obtainNode()
+{
+    AVMessage *message = mFreeMsg;
+    if (message)
+    {
+        mFreeMsg = message->next;
+        return message;
+    }
+    mAllocated++;
+    return (AVMessage *) av_malloc(sizeof(AVMessage));
+}
+
+void AVMessageQueue::recycleNode(AVMessage *msg)
+{
+    message_free_resouce(msg);
+    if (msg >= mPool && msg < mPool + MESSAGE_POOL_SIZE)
+    {
+        msg->next = mFreeMsg;
+        mFreeMsg = msg;
+    }
+    else
+    {
+        av_free(msg);
+    }
+}
+
+/**
+ * 投递消息，可以合并的消息如果队列中已经有同类的消息，则移除旧的消息，新消息放到队尾
+ * @param msg
+ * @return
+ */
 int AVMessageQueue::putMessage(AVMessage *msg)
 {
     Mutex::Autolock lock(mMutex);
-    AVMessage *message;
+    AVMessage *message = NULL;
     if (abortRequest)
     {
+        message_free_resouce(msg);
         return -1;
     }
-    message = (AVMessage *) av_malloc(sizeof(AVMessage));
+
+    if (isCoalescable(msg->what) && !msg->obj)
+    {
+        AVMessage *prev = NULL;
+        for (AVMessage *node = mFirstMsg; node != NULL; prev = node, node = node->next)
+        {
+            if (node->what != msg->what || node->obj)
+            {
+                continue;
+            }
+            mCoalesced++;
+            // 已经在队尾，直接替换数值
+            if (node == mLastMsg)
+            {
+                node->arg1 = msg->arg1;
+                node->arg2 = msg->arg2;
+                return 0;
+            }
+            // 从原来的位置摘下，复用节点放到队尾
+            if (prev)
+            {
+                prev->next = node->next;
+            }
+            else
+            {
+                mFirstMsg = node->next;
+            }
+            mSize--;
+            message = node;
+            break;
+        }
+    }
+
     if (!message)
     {
-        return -1;
+        message = obtainNode();
+        if (!message)
+        {
+            message_free_resouce(msg);
+            return -1;
+        }
     }
     *message = *msg;
     message->next = NULL;
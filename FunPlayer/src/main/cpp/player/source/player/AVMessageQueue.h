@@ -8,10 +8,14 @@
 
 extern "C" {
 #include <libavutil/mem.h>
+#include <libavutil/time.h>
 };
 
 #include "PlayerMessage.h"
 
+// 预分配的消息节点数，用完之后从堆上分配
+#define MESSAGE_POOL_SIZE 64
+
 typedef struct AVMessage
 {
     int what;
@@ -45,6 +49,12 @@ inline static void message_free_resouce(AVMessage *msg)
     msg->obj = NULL;
 }
 
+/**
+ * 播放器消息队列
+ * 消息节点从预分配的节点池中获取，播放过程中不需要分配内存
+ * 位置、缓冲进度这类高频更新的消息可以合并，未被取走的旧消息会被新消息替换，
+ * 新消息总是放在队尾，不会越过在它之前投递的状态消息
+ */
 class AVMessageQueue
 {
 public:
@@ -72,17 +82,40 @@ public:
 
     int getMessage(AVMessage *msg, int block);
 
+    // 阻塞获取消息，最多等待timeoutMs毫秒，超时返回0，timeoutMs小于等于0时一直等待
+    int getMessage(AVMessage *msg, int block, int timeoutMs);
+
     void removeMessage(int what);
 
+    // 是否是可以合并的消息，只保留最新的值
+    static bool isCoalescable(int what);
+
+    // 获取被合并掉的消息数
+    int64_t getCoalescedCount();
+
+    // 获取节点池用完之后从堆上分配的次数
+    int64_t getAllocatedCount();
+
 private:
     int putMessage(AVMessage *msg);
 
+    // 获取一个空闲节点
+    AVMessage *obtainNode();
+
+    // 回收节点，释放消息附带的资源
+    void recycleNode(AVMessage *msg);
+
 private:
     Mutex mMutex;
     Condition mCondition;
     AVMessage *mFirstMsg, *mLastMsg;
     bool abortRequest;
     int mSize;
+
+    AVMessage mPool[MESSAGE_POOL_SIZE];     // 预分配的节点
+    AVMessage *mFreeMsg;                    // 空闲节点链表
+    int64_t mCoalesced;                     // 合并的消息数
+    int64_t mAllocated;                     // 堆上分配的节点数
 };
 
 #endif //AVMESSAGEQUEUE_H
@@ -63,11 +63,21 @@ MediaPlayerEx::MediaPlayerEx()
     pFormatCtx = NULL;
     lastPaused = -1;
     attachmentRequest = 0;
+    audioBufferedTime = AV_NOPTS_VALUE;
+    videoBufferedTime = AV_NOPTS_VALUE;
+    packetCache = new PacketCache();
+    seekIndex = new SeekIndex();
+    indexCursor = AV_NOPTS_VALUE;
+    readAheadIO = NULL;
+    traceStarted = false;
+    scrubTarget = 0;
+    scrubDiscard = 0;
+    scrubPending = 0;
 
 #if defined(__ANDROID__)
     audioDevice = new SLESDevice();
 #else
-    audioDevice = new AudioDevice();
+    audioDevice = new NullAudioDevice();
 #endif
 
     mediaSync = new MediaSync(playerState);
@@ -84,6 +94,12 @@ MediaPlayerEx::MediaPlayerEx()
 
 MediaPlayerEx::~MediaPlayerEx()
 {
+    // 在析构时才停止，reset之后仍然可以导出完整的跟踪
+    if (traceStarted)
+    {
+        TraceRecorder::stop();
+        traceStarted = false;
+    }
     avformat_network_deinit();
     av_lockmgr_register(NULL);
 }
@@ -98,6 +114,8 @@ status_t MediaPlayerEx::reset()
         delete mediaSync;
         mediaSync = NULL;
     }
+    // getStats读取下面这些对象，在锁内释放并清空，统计不会访问到正在释放或者已经释放的对象
+    std::lock_guard<std::mutex> lock(mStatsMutex);
     if (audioDecoder != NULL)
     {
         audioDecoder->stop();
@@ -118,6 +136,8 @@ status_t MediaPlayerEx::reset()
     }
 
     SAFE_DELETE(audioResampler);
+    SAFE_DELETE(packetCache);
+    SAFE_DELETE(seekIndex);
 
     if (pFormatCtx != NULL)
     {
@@ -125,6 +145,8 @@ status_t MediaPlayerEx::reset()
         avformat_free_context(pFormatCtx);
         pFormatCtx = NULL;
     }
+    // 解复用上下文不会关闭自定义的AVIOContext，关闭之后再释放
+    SAFE_DELETE(readAheadIO);
 
     SAFE_DELETE(playerState);
 
@@ -181,37 +203,75 @@ void MediaPlayerEx::start()
     playerState->abortRequest = 0;
     playerState->pauseRequest = 0;
     mExit = false;
+    // 还在准备时由读包线程在准备完成后切换到播放状态
+    int state = playerState->playback.getState();
+    if (state == PLAYBACK_PREPARED || state == PLAYBACK_PAUSED)
+    {
+        playerState->playback.setState(PLAYBACK_PLAYING);
+    }
     mCondition.notify_one();
+    notifyReadThread();
+    if (mediaSync)
+    {
+        mediaSync->wakeUp();
+    }
 }
 
 void MediaPlayerEx::pause()
 {
     std::lock_guard<std::mutex> lock(mMutex);
     playerState->pauseRequest = 1;
+    if (playerState->playback.getState() == PLAYBACK_PLAYING)
+    {
+        playerState->playback.setState(PLAYBACK_PAUSED);
+    }
     mCondition.notify_one();
+    notifyReadThread();
+    if (mediaSync)
+    {
+        mediaSync->wakeUp();
+    }
 }
 
 void MediaPlayerEx::resume()
 {
     std::lock_guard<std::mutex> lock(mMutex);
     playerState->pauseRequest = 0;
+    if (playerState->playback.getState() == PLAYBACK_PAUSED)
+    {
+        playerState->playback.setState(PLAYBACK_PLAYING);
+    }
     mCondition.notify_one();
+    notifyReadThread();
+    if (mediaSync)
+    {
+        mediaSync->wakeUp();
+    }
 }
 
 void MediaPlayerEx::stop()
 {
-    mMutex.lock();
+    std::unique_lock<std::mutex> lock(mMutex);
     playerState->abortRequest = 1;
+    if (playerState->playback.getState() != PLAYBACK_IDLE)
+    {
+        playerState->playback.setState(PLAYBACK_STOPPED);
+    }
     mCondition.notify_one();
-    mMutex.unlock();
-    mMutex.lock();
+    notifyReadThread();
+    if (mediaSync)
+    {
+        mediaSync->wakeUp();
+    }
     while (!mExit)
     {
-        std::unique_lock<std::mutex> lock(mMutex);
         mCondition.wait(lock);
     }
-    mMutex.unlock();
-    mThread.join();
+    lock.unlock();
+    if (mThread.joinable())
+    {
+        mThread.join();
+    }
 }
 
 void MediaPlayerEx::seekTo(float timeMs)
@@ -222,31 +282,78 @@ void MediaPlayerEx::seekTo(float timeMs)
         return;
     }
 
-    // 等待上一次操作完成
-    mMutex.lock();
-    while (playerState->seekRequest)
+    // 不等待上一次定位完成，还没有执行的定位请求直接被替换，只保留最新的目标
+    int64_t seek_pos = av_rescale(timeMs, AV_TIME_BASE, 1000);
+    mSeekMutex.lock();
+    int64_t start_time = pFormatCtx ? pFormatCtx->start_time : 0;
+    if (start_time > 0 && start_time != AV_NOPTS_VALUE)
     {
-        std::unique_lock<std::mutex> lock(mMutex);
-        mCondition.wait(lock);
+        seek_pos += start_time;
     }
-    mMutex.unlock();
+    if (playerState->seekRequest)
+    {
+        playerState->coalescedSeeks++;
+    }
+    playerState->seekPos = seek_pos;
+    playerState->seekRel = 0;
+    playerState->seekFlags &= ~AVSEEK_FLAG_BYTE;
+    playerState->seekRequestTime = av_gettime_relative();
+    playerState->seekRequest = 1;
+    playerState->playback.beginSeek((int64_t) timeMs);
+    mSeekMutex.unlock();
+    notifyReadThread();
+}
 
-    if (!playerState->seekRequest)
+/**
+ * 拖动期间的定位由读包线程只送出目标附近的关键帧，同步线程收到之后立即显示
+ */
+void MediaPlayerEx::beginScrub()
+{
+    if (!videoDecoder || (videoDecoder->getStream()->disposition & AV_DISPOSITION_ATTACHED_PIC))
     {
-        int64_t start_time = 0;
-        int64_t seek_pos = av_rescale(timeMs, AV_TIME_BASE, 1000);
-        start_time = pFormatCtx ? pFormatCtx->start_time : 0;
-        if (start_time > 0 && start_time != AV_NOPTS_VALUE)
-        {
-            seek_pos += start_time;
-        }
-        playerState->seekPos = seek_pos;
-        playerState->seekRel = 0;
-        playerState->seekFlags &= ~AVSEEK_FLAG_BYTE;
-        playerState->seekRequest = 1;
-        mCondition.notify_one();
+        return;
     }
+    mSeekMutex.lock();
+    scrubTarget = (float) getCurrentPosition();
+    playerState->scrubbing = 1;
+    mSeekMutex.unlock();
+    TRACE_INSTANT("scrub_begin", (int64_t) scrubTarget);
+    notifyReadThread();
+    mediaSync->wakeUp();
+}
 
+void MediaPlayerEx::updateScrub(float timeMs)
+{
+    mSeekMutex.lock();
+    scrubTarget = timeMs;
+    mSeekMutex.unlock();
+    seekTo(timeMs);
+}
+
+void MediaPlayerEx::endScrub()
+{
+    mSeekMutex.lock();
+    if (!playerState->scrubbing)
+    {
+        mSeekMutex.unlock();
+        return;
+    }
+    playerState->scrubbing = 0;
+    float target = scrubTarget;
+    mSeekMutex.unlock();
+    TRACE_INSTANT("scrub_end", (int64_t) target);
+    seekTo(target);
+    mediaSync->wakeUp();
+}
+
+/**
+ * 唤醒等待队列空间的读包线程
+ */
+void MediaPlayerEx::notifyReadThread()
+{
+    playerState->readMutex.lock();
+    playerState->readCondition.signal();
+    playerState->readMutex.unlock();
 }
 
 void MediaPlayerEx::setLooping(int looping)
@@ -289,85 +396,48 @@ void MediaPlayerEx::setPitch(float pitch)
     mMutex.unlock();
 }
 
+/**
+ * 以下获取播放状态的接口都从快照中读取，不加锁，不会被打开文件、查找媒体流信息阻塞
+ * @return
+ */
 int MediaPlayerEx::getRotate()
 {
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (videoDecoder)
-    {
-        return videoDecoder->getRotate();
-    }
-    return 0;
+    PlaybackSnapshot snapshot;
+    playerState->playback.getSnapshot(&snapshot);
+    return snapshot.rotation;
 }
 
 int MediaPlayerEx::getVideoWidth()
 {
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (videoDecoder)
-    {
-        return videoDecoder->getCodecContext()->width;
-    }
-    return 0;
+    PlaybackSnapshot snapshot;
+    playerState->playback.getSnapshot(&snapshot);
+    return snapshot.videoWidth;
 }
 
 int MediaPlayerEx::getVideoHeight()
 {
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (videoDecoder)
-    {
-        return videoDecoder->getCodecContext()->height;
-    }
-    return 0;
+    PlaybackSnapshot snapshot;
+    playerState->playback.getSnapshot(&snapshot);
+    return snapshot.videoHeight;
 }
 
 long MediaPlayerEx::getCurrentPosition()
 {
-    std::lock_guard<std::mutex> lock(mMutex);
-    int64_t currentPosition = 0;
-    // 处于定位
-    if (playerState->seekRequest)
-    {
-        currentPosition = playerState->seekPos;
-    }
-    else
-    {
-        // 起始延时
-        int64_t start_time = pFormatCtx->start_time;
-        int64_t start_diff = 0;
-        if (start_time > 0 && start_time != AV_NOPTS_VALUE)
-        {
-            start_diff = av_rescale(start_time, 1000, AV_TIME_BASE);
-        }
-
-        // 计算主时钟的时间
-        int64_t pos = 0;
-        double clock = mediaSync->getMasterClock();
-        if (isnan(clock))
-        {
-            pos = playerState->seekPos;
-        }
-        else
-        {
-            pos = (int64_t) (clock * 1000);
-        }
-        if (pos < 0 || pos < start_diff)
-        {
-            return 0;
-        }
-        return (long) (pos - start_diff);
-    }
-    return (long) currentPosition;
+    PlaybackSnapshot snapshot;
+    playerState->playback.getSnapshot(&snapshot);
+    return (long) snapshot.position;
 }
 
 long MediaPlayerEx::getDuration()
 {
-    std::lock_guard<std::mutex> lock(mMutex);
-    return (long) mDuration;
+    PlaybackSnapshot snapshot;
+    playerState->playback.getSnapshot(&snapshot);
+    return (long) snapshot.duration;
 }
 
 int MediaPlayerEx::isPlaying()
 {
-    std::lock_guard<std::mutex> lock(mMutex);
-    return !playerState->abortRequest && !playerState->pauseRequest;
+    return playerState->playback.getState() == PLAYBACK_PLAYING;
 }
 
 int MediaPlayerEx::isLooping()
@@ -375,6 +445,102 @@ int MediaPlayerEx::isLooping()
     return playerState->loop;
 }
 
+double MediaPlayerEx::getAVDiff()
+{
+    PlaybackSnapshot snapshot;
+    playerState->playback.getSnapshot(&snapshot);
+    return snapshot.avDiff;
+}
+
+/**
+ * 获取统计快照，各阶段的耗时直方图由各个线程无锁更新，读取时不保证各项之间是同一时刻的值
+ * 不持有mMutex，读包线程在打开和探测期间一直持有它，加锁会阻塞到起播完成
+ * 解码器、重采样器、预读I/O层等对象指针只在mStatsMutex内发布和释放，这里持有它读取，
+ * 对象内部的计数再由原子变量或者对象自己的锁保护
+ * @param stats
+ */
+void MediaPlayerEx::getStats(PlayerStats *stats)
+{
+    std::lock_guard<std::mutex> lock(mStatsMutex);
+    memset(stats, 0, sizeof(PlayerStats));
+    if (!playerState)
+    {
+        return;
+    }
+    for (int i = 0; i < STAGE_COUNT; ++i)
+    {
+        getStageStats(&playerState->stageLatency[i], &stats->stages[i]);
+    }
+    if (audioDecoder)
+    {
+        stats->audioPackets = audioDecoder->getPacketSize();
+        stats->audioQueueBytes = audioDecoder->getMemorySize();
+    }
+    if (videoDecoder)
+    {
+        stats->videoPackets = videoDecoder->getPacketSize();
+        stats->videoQueueBytes = videoDecoder->getMemorySize();
+        stats->videoFrames = videoDecoder->getFrameSize();
+    }
+    if (audioResampler)
+    {
+        stats->audioBufferBytes = audioResampler->getBufferedSize();
+    }
+    stats->decodedFrames = playerState->decodedFrames;
+    stats->droppedFrames = playerState->droppedFrames;
+    stats->presentedFrames = playerState->presentError.getTotal();
+    stats->repeatedFrames = playerState->repeatedFrames;
+    stats->skippedFrames = playerState->skippedFrames;
+    stats->cachedSeeks = playerState->cachedSeeks;
+    stats->demuxerSeeks = playerState->demuxerSeeks;
+    stats->packetCacheBytes = playerState->packetCacheBytes;
+    stats->indexSeeks = playerState->indexSeeks;
+    stats->seekIndexEntries = seekIndex ? seekIndex->getEntryCount() : 0;
+    ReadAheadStats ioStats;
+    memset(&ioStats, 0, sizeof(ioStats));
+    if (readAheadIO)
+    {
+        readAheadIO->getStats(&ioStats);
+    }
+    stats->ioBufferedBytes = ioStats.bufferedBytes;
+    stats->ioReadBytes = ioStats.readBytes;
+    stats->ioReadTime = ioStats.readTime;
+    stats->ioStalls = ioStats.stalls;
+    stats->ioStallTime = ioStats.stallTime;
+    stats->ioBufferSeeks = ioStats.bufferSeeks;
+    stats->ioSeeks = ioStats.ioSeeks;
+    stats->coalescedSeeks = playerState->coalescedSeeks;
+    stats->abortedSeeks = playerState->abortedSeeks;
+    getStageStats(&playerState->seekLatency, &stats->seekLatency);
+    stats->accurateSeeks = playerState->accurateSeeks;
+    stats->catchupFrames = playerState->catchupFrames;
+    getStageStats(&playerState->catchupTime, &stats->catchupTime);
+    for (int i = 0; i < STARTUP_PHASE_COUNT; ++i)
+    {
+        stats->startupTime[i] = playerState->startupTime[i];
+    }
+}
+
+/**
+ * 获取播放状态快照，计数器各自独立读取，不保证与其他字段是同一时刻的值
+ * @param snapshot
+ */
+void MediaPlayerEx::getPlaybackSnapshot(PlaybackSnapshot *snapshot)
+{
+    playerState->playback.getSnapshot(snapshot);
+    snapshot->droppedFrames = playerState->droppedFrames;
+    snapshot->stallCount = playerState->audioUnderruns;
+}
+
+int MediaPlayerEx::dumpTrace(const char *path)
+{
+    if (!path)
+    {
+        return BAD_VALUE;
+    }
+    return TraceRecorder::dump(path);
+}
+
 int MediaPlayerEx::getMetadata(AVDictionary **metadata)
 {
     if (!pFormatCtx)
@@ -392,35 +558,97 @@ static int avformat_interrupt_cb(void *ctx)
     {
         return AVERROR_EOF;
     }
+    // 解复用器定位过程中有新的定位请求时中断，由读包线程直接执行新的定位
+    if (playerState->seekInterruptible && playerState->seekRequest)
+    {
+        return AVERROR_EXIT;
+    }
     return 0;
 }
 
+/**
+ * 播放器状态和消息队列在播放器的生命周期内不变，不需要加锁，避免消息线程被准备过程阻塞
+ * @return
+ */
 AVMessageQueue *MediaPlayerEx::getMessageQueue()
 {
-    std::lock_guard<std::mutex> lock(mMutex);
     return playerState->messageQueue;
 }
 
 PlayerState *MediaPlayerEx::getPlayerState()
 {
-    std::lock_guard<std::mutex> lock(mMutex);
     return playerState;
 }
 
 void MediaPlayerEx::run()
 {
+    TRACE_THREAD("read");
+    if (playerState->traceCapacity > 0 && !traceStarted)
+    {
+        TraceRecorder::start(playerState->traceCapacity);
+        traceStarted = true;
+    }
     readPackets();
 }
 
+/**
+ * 获取音视频数据包队列占用的内存大小
+ */
+int MediaPlayerEx::getQueueMemorySize()
+{
+    return (audioDecoder ? audioDecoder->getMemorySize() : 0) +
+           (videoDecoder ? videoDecoder->getMemorySize() : 0);
+}
+
+/**
+ * 队列达到高水位时休眠读包线程，直到队列被消耗到低水位以下，或者有退出、暂停、定位请求
+ * @param sizeLimited 是否因为队列占用内存超过MAX_QUEUE_SIZE而等待，此时需要等到占用内存降到低水位以下
+ */
+void MediaPlayerEx::waitQueueLowWatermark(int sizeLimited)
+{
+    TRACE_SCOPE("wait_queue");
+    int64_t start = av_gettime_relative();
+    int blocked = 0;
+    playerState->readMutex.lock();
+    while (!playerState->abortRequest && !playerState->seekRequest
+           && playerState->pauseRequest == lastPaused)
+    {
+        if (sizeLimited)
+        {
+            if (getQueueMemorySize() <= LOW_WATERMARK_QUEUE_SIZE)
+            {
+                break;
+            }
+        }
+        else if ((audioDecoder && audioDecoder->isLowWatermark())
+                 || (videoDecoder && videoDecoder->isLowWatermark()))
+        {
+            break;
+        }
+        playerState->readCondition.waitRelative(playerState->readMutex,
+                                                READ_WAIT_TIMEOUT * 1000000LL);
+        blocked = 1;
+    }
+    playerState->readMutex.unlock();
+    if (blocked)
+    {
+        playerState->readBlockedCount++;
+        playerState->readBlockedTime += av_gettime_relative() - start;
+    }
+}
+
 int MediaPlayerEx::readPackets()
 {
     int ret = 0;
     AVDictionaryEntry *t;
-    AVDictionary **opts;
     int scan_all_pmts_set = 0;
+    ProbeCache *probeCache = NULL;
+    int probeCached = 0;
 
     // 准备解码器
     mMutex.lock();
+    playerState->playback.setState(PLAYBACK_PREPARING);
+    playerState->beginStartup();
     do
     {
         // 创建解复用上下文
@@ -461,15 +689,45 @@ int MediaPlayerEx::readPackets()
             av_dict_set(&playerState->format_opts, "timeout", NULL, 0);
         }
 
+        // 快速起播时限制探测的数据量和时长，已经指定的不覆盖
+        if (playerState->fastStart)
+        {
+            av_dict_set_int(&playerState->format_opts, "probesize", FAST_START_PROBE_SIZE,
+                            AV_DICT_DONT_OVERWRITE);
+            av_dict_set_int(&playerState->format_opts, "analyzeduration",
+                            FAST_START_ANALYZE_DURATION, AV_DICT_DONT_OVERWRITE);
+        }
+
+        // 本地文件和http渐进式下载使用预读I/O层，打开失败时使用默认的I/O
+        if (playerState->ioBufferSize > 0 && ReadAheadIO::isSupported(playerState->url)
+            && (!playerState->iformat || !(playerState->iformat->flags & AVFMT_NOFILE)))
+        {
+            ReadAheadIO *io = new ReadAheadIO(playerState->ioBufferSize);
+            if (io->open(playerState->url, &pFormatCtx->interrupt_callback,
+                         &playerState->format_opts) == 0)
+            {
+                pFormatCtx->pb = io->getContext();
+                std::lock_guard<std::mutex> lock(mStatsMutex);
+                readAheadIO = io;
+            }
+            else
+            {
+                delete io;
+            }
+        }
+
         // 打开文件
+        TRACE_BEGIN("open_input");
         ret = avformat_open_input(&pFormatCtx, playerState->url, playerState->iformat,
                                   &playerState->format_opts);
+        TRACE_END("open_input");
         if (ret < 0)
         {
             printError(playerState->url, ret);
             ret = -1;
             break;
         }
+        playerState->markStartupPhase(STARTUP_OPEN);
 
         // 打开文件回调
         if (playerState->messageQueue)
@@ -495,22 +753,43 @@ int MediaPlayerEx::readPackets()
         }
         av_format_inject_global_side_data(pFormatCtx);
 
-        opts = setupStreamInfoOptions(pFormatCtx, playerState->codec_opts);
-
-        // 查找媒体流信息
-        ret = avformat_find_stream_info(pFormatCtx, opts);
-        if (opts != NULL)
+        // 有探测结果缓存时，用缓存的解码参数代替 avformat_find_stream_info
+        if (playerState->probeCacheDir && !isRealTime(pFormatCtx))
         {
-            for (int i = 0; i < pFormatCtx->nb_streams; i++)
+            probeCache = new ProbeCache(playerState->probeCacheDir, playerState->url);
+            if (probeCache->load(pFormatCtx) == 0)
             {
-                if (opts[i] != NULL)
+                // 读包时才出现媒体流的格式，只用很少的数据把媒体流找出来
+                ret = 0;
+                if (pFormatCtx->ctx_flags & AVFMTCTX_NOHEADER)
+                {
+                    int64_t probeSize = pFormatCtx->probesize;
+                    int64_t analyzeDuration = pFormatCtx->max_analyze_duration;
+                    pFormatCtx->probesize = PROBE_CACHE_PROBE_SIZE;
+                    pFormatCtx->max_analyze_duration = PROBE_CACHE_ANALYZE_DURATION;
+                    ret = findStreamInfo();
+                    pFormatCtx->probesize = probeSize;
+                    pFormatCtx->max_analyze_duration = analyzeDuration;
+                }
+                if (ret >= 0 && probeCache->match(pFormatCtx))
                 {
-                    av_dict_free(&opts[i]);
+                    probeCache->apply(pFormatCtx);
+                    probeCached = 1;
+                    TRACE_INSTANT("probe_cache_hit", pFormatCtx->nb_streams);
+                    av_log(NULL, AV_LOG_INFO, "probe cache hit: %s\n", playerState->url);
+                }
+                else
+                {
+                    probeCache->remove();
                 }
             }
-            av_freep(&opts);
         }
 
+        // 查找媒体流信息，读包时才出现媒体流的格式在缓存校验时已经找过一部分，这里继续查找
+        if (!probeCached)
+        {
+            ret = findStreamInfo();
+        }
         if (ret < 0)
         {
             av_log(NULL, AV_LOG_WARNING,
@@ -518,6 +797,7 @@ int MediaPlayerEx::readPackets()
             ret = -1;
             break;
         }
+        playerState->markStartupPhase(STARTUP_PROBE);
 
         // 查找媒体流信息回调
         if (playerState->messageQueue)
@@ -546,17 +826,26 @@ int MediaPlayerEx::readPackets()
             }
         }
         playerState->videoDuration = mDuration;
+        playerState->playback.setDuration(mDuration);
 
         if (pFormatCtx->pb)
         {
             pFormatCtx->pb->eof_reached = 0;
         }
         // 判断是否以字节方式定位
-        playerState->seekByBytes = !!(pFormatCtx->iformat->flags & AVFMT_TS_DISCONT)
-                                   && strcmp("ogg", pFormatCtx->iformat->name);
+        if (probeCached)
+        {
+            playerState->seekByBytes = probeCache->getSeekByBytes();
+        }
+        else
+        {
+            playerState->seekByBytes = !!(pFormatCtx->iformat->flags & AVFMT_TS_DISCONT)
+                                       && strcmp("ogg", pFormatCtx->iformat->name);
+        }
 
         // 设置最大帧间隔
         mediaSync->setMaxDuration((pFormatCtx->iformat->flags & AVFMT_TS_DISCONT) ? 10.0 : 3600.0);
+        mediaSync->setStartTime(pFormatCtx->start_time);
 
         // 如果不是从头开始播放，则跳转到播放位置
         if (playerState->startTime != AV_NOPTS_VALUE)
@@ -568,9 +857,7 @@ int MediaPlayerEx::readPackets()
             {
                 timestamp += pFormatCtx->start_time;
             }
-            playerState->mMutex.lock();
             ret = avformat_seek_file(pFormatCtx, -1, INT64_MIN, timestamp, INT64_MAX, 0);
-            playerState->mMutex.unlock();
             if (ret < 0)
             {
                 av_log(NULL, AV_LOG_WARNING, "%s: could not seek to position %0.3f\n",
@@ -581,42 +868,51 @@ int MediaPlayerEx::readPackets()
         // 查找媒体流信息
         int audioIndex = -1;
         int videoIndex = -1;
-        for (int i = 0; i < pFormatCtx->nb_streams; ++i)
+        if (probeCached)
         {
-            if (pFormatCtx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_AUDIO)
+            // 使用缓存中选中的媒体流
+            videoIndex = playerState->videoDisable ? -1 : probeCache->getVideoIndex();
+            audioIndex = playerState->audioDisable ? -1 : probeCache->getAudioIndex();
+        }
+        else
+        {
+            for (int i = 0; i < pFormatCtx->nb_streams; ++i)
             {
-                if (audioIndex == -1)
+                if (pFormatCtx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_AUDIO)
                 {
-                    audioIndex = i;
+                    if (audioIndex == -1)
+                    {
+                        audioIndex = i;
+                    }
                 }
-            }
-            else if (pFormatCtx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
-            {
-                if (videoIndex == -1)
+                else if (pFormatCtx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
                 {
-                    videoIndex = i;
+                    if (videoIndex == -1)
+                    {
+                        videoIndex = i;
+                    }
                 }
             }
-        }
-        // 如果不禁止视频流，则查找最合适的视频流索引
-        if (!playerState->videoDisable)
-        {
-            videoIndex = av_find_best_stream(pFormatCtx, AVMEDIA_TYPE_VIDEO,
-                                             videoIndex, -1, NULL, 0);
-        }
-        else
-        {
-            videoIndex = -1;
-        }
-        // 如果不禁止音频流，则查找最合适的音频流索引(与视频流关联的音频流)
-        if (!playerState->audioDisable)
-        {
-            audioIndex = av_find_best_stream(pFormatCtx, AVMEDIA_TYPE_AUDIO,
-                                             audioIndex, videoIndex, NULL, 0);
-        }
-        else
-        {
-            audioIndex = -1;
+            // 如果不禁止视频流，则查找最合适的视频流索引
+            if (!playerState->videoDisable)
+            {
+                videoIndex = av_find_best_stream(pFormatCtx, AVMEDIA_TYPE_VIDEO,
+                                                 videoIndex, -1, NULL, 0);
+            }
+            else
+            {
+                videoIndex = -1;
+            }
+            // 如果不禁止音频流，则查找最合适的音频流索引(与视频流关联的音频流)
+            if (!playerState->audioDisable)
+            {
+                audioIndex = av_find_best_stream(pFormatCtx, AVMEDIA_TYPE_AUDIO,
+                                                 audioIndex, videoIndex, NULL, 0);
+            }
+            else
+            {
+                audioIndex = -1;
+            }
         }
 
         // 如果音频流和视频流都没有找到，则直接退出
@@ -628,25 +924,46 @@ int MediaPlayerEx::readPackets()
             break;
         }
 
-        // 根据媒体流索引准备解码器
-        if (audioIndex >= 0)
+        // 根据媒体流索引准备解码器，快速起播时音频解码器在另外的线程中同时打开
+        if (playerState->fastStart && audioIndex >= 0 && videoIndex >= 0)
         {
-            prepareDecoder(audioIndex);
+            std::thread audioThread(&MediaPlayerEx::prepareDecoder, this, audioIndex);
+            prepareDecoder(videoIndex);
+            audioThread.join();
         }
-        if (videoIndex >= 0)
+        else
         {
-            prepareDecoder(videoIndex);
+            if (audioIndex >= 0)
+            {
+                prepareDecoder(audioIndex);
+            }
+            if (videoIndex >= 0)
+            {
+                prepareDecoder(videoIndex);
+            }
         }
 
         if (!audioDecoder && !videoDecoder)
         {
             av_log(NULL, AV_LOG_WARNING,
                    "failed to create audio and video decoder\n");
+            // 缓存的参数打不开解码器，删除缓存，下次重新探测
+            if (probeCached)
+            {
+                probeCache->remove();
+            }
             ret = -1;
             break;
         }
+        playerState->markStartupPhase(STARTUP_CODEC_OPEN);
         ret = 0;
 
+        // 完整探测成功后保存探测结果，禁止了音频或视频时选中的媒体流不完整，不保存
+        if (probeCache && !probeCached && !playerState->audioDisable && !playerState->videoDisable)
+        {
+            probeCache->save(pFormatCtx, audioIndex, videoIndex, playerState->seekByBytes);
+        }
+
         // 准备解码器消息回调
         if (playerState->messageQueue)
         {
@@ -654,13 +971,17 @@ int MediaPlayerEx::readPackets()
         }
 
     } while (false);
+    delete probeCache;
     mMutex.unlock();
 
     // 出错返回
     if (ret < 0)
     {
+        mMutex.lock();
         mExit = true;
+        playerState->playback.setState(PLAYBACK_ERROR);
         mCondition.notify_one();
+        mMutex.unlock();
         if (playerState->messageQueue)
         {
             const char errorMsg[] = "prepare decoder failed!";
@@ -674,6 +995,8 @@ int MediaPlayerEx::readPackets()
     if (videoDecoder)
     {
         AVCodecParameters *codecpar = videoDecoder->getStream()->codecpar;
+        playerState->playback.setVideoSize(codecpar->width, codecpar->height,
+                                           videoDecoder->getRotate());
         if (playerState->messageQueue)
         {
             playerState->messageQueue->postMessage(MSG_VIDEO_SIZE_CHANGED,
@@ -684,7 +1007,10 @@ int MediaPlayerEx::readPackets()
         }
     }
 
-    // 准备完成回调
+    // 准备完成回调，状态切换与start、pause在同一把锁下进行
+    mMutex.lock();
+    playerState->playback.setState(PLAYBACK_PREPARED);
+    mMutex.unlock();
     if (playerState->messageQueue)
     {
         playerState->messageQueue->postMessage(MSG_PREPARED);
@@ -748,7 +1074,8 @@ int MediaPlayerEx::readPackets()
         }
         else
         {
-            // 启动音频输出设备
+            // 启动音频解码重采样线程以及音频输出设备
+            audioResampler->start();
             audioDevice->start();
         }
     }
@@ -769,10 +1096,31 @@ int MediaPlayerEx::readPackets()
         }
     }
 
+    // 数据包缓存，实时流和以字节定位时不缓存，有视频时以视频关键帧作为定位点，封面图片不算作视频流
+    if (!playerState->realTime && !playerState->seekByBytes && playerState->packetCacheTime > 0)
+    {
+        packetCache->setWindow(playerState->packetCacheTime / 1000.0, playerState->packetCacheSize);
+        if (videoDecoder
+            && !(videoDecoder->getStream()->disposition & AV_DISPOSITION_ATTACHED_PIC))
+        {
+            packetCache->setAnchorStream(videoDecoder->getStreamIndex());
+        }
+        else if (audioDecoder)
+        {
+            packetCache->setAnchorStream(audioDecoder->getStreamIndex());
+        }
+    }
+    else
+    {
+        packetCache->setWindow(0, 0);
+    }
+    openSeekIndex();
+
     // 开始同步
     mediaSync->start(videoDecoder, audioDecoder);
 
-    // 等待开始
+    // 等待开始，快速起播时不等待，暂停状态下继续读包，由同步线程显示第一帧作为封面
+    int startPending = 0;
     if (playerState->pauseRequest)
     {
         // 请求开始
@@ -780,15 +1128,18 @@ int MediaPlayerEx::readPackets()
         {
             playerState->messageQueue->postMessage(MSG_REQUEST_START);
         }
-        while ((!playerState->abortRequest) && playerState->pauseRequest)
+        if (playerState->fastStart)
+        {
+            startPending = 1;
+        }
+        while (!startPending && (!playerState->abortRequest) && playerState->pauseRequest)
         {
             av_usleep(10 * 1000);
         }
     }
-
-    if (playerState->messageQueue)
+    if (!startPending)
     {
-        playerState->messageQueue->postMessage(MSG_STARTED);
+        notifyStarted();
     }
 
     // 读数据包流程
@@ -808,8 +1159,15 @@ int MediaPlayerEx::readPackets()
             break;
         }
 
-        // 是否暂停
-        if (playerState->pauseRequest != lastPaused)
+        // 快速起播时，开始播放之后才回调开始
+        if (startPending && !playerState->pauseRequest)
+        {
+            startPending = 0;
+            notifyStarted();
+        }
+
+        // 是否暂停，快速起播等待开始时不暂停网络流，需要读出第一帧
+        if (!startPending && playerState->pauseRequest != lastPaused)
         {
             lastPaused = playerState->pauseRequest;
             if (playerState->pauseRequest)
@@ -830,36 +1188,100 @@ int MediaPlayerEx::readPackets()
             continue;
         }
 #endif
-        // 定位处理
+        // 定位处理，只执行最新的定位请求，执行过程中有新的请求时中断解复用器定位
         if (playerState->seekRequest)
         {
+            mSeekMutex.lock();
             int64_t seek_target = playerState->seekPos;
-            int64_t seek_min =
-                    playerState->seekRel > 0 ? seek_target - playerState->seekRel + 2 : INT64_MIN;
-            int64_t seek_max =
-                    playerState->seekRel < 0 ? seek_target - playerState->seekRel - 2 : INT64_MAX;
-            // 定位
-            playerState->mMutex.lock();
-            ret = avformat_seek_file(pFormatCtx, -1, seek_min, seek_target, seek_max,
-                                     playerState->seekFlags);
-            playerState->mMutex.unlock();
-            if (ret < 0)
+            int64_t seek_rel = playerState->seekRel;
+            int seek_flags = playerState->seekFlags;
+            int64_t request_time = playerState->seekRequestTime;
+            int scrub = playerState->scrubbing;
+            playerState->seekRequest = 0;
+            mSeekMutex.unlock();
+            int64_t seek_min = seek_rel > 0 ? seek_target - seek_rel + 2 : INT64_MIN;
+            int64_t seek_max = seek_rel < 0 ? seek_target - seek_rel - 2 : INT64_MAX;
+            // 定位，解复用上下文只在读包线程中使用，解码器通过数据包序列号得知定位，不需要加锁
+            TRACE_SCOPE("seek");
+            int cached = 0;
+            // 精确定位只用于按时间定位到指定位置，拖动预览只显示关键帧
+            int64_t accurate_target = AV_NOPTS_VALUE;
+            if (playerState->accurateSeek && !scrub && seek_rel == 0
+                && !(seek_flags & AVSEEK_FLAG_BYTE))
             {
-                av_log(NULL, AV_LOG_ERROR, "%s: error while seeking\n", playerState->url);
+                accurate_target = seek_target;
+            }
+            if (seek_rel == 0 && !(seek_flags & AVSEEK_FLAG_BYTE))
+            {
+                cached = seekPacketCache(seek_target, request_time, scrub, accurate_target) == 0;
+            }
+            scrubPending = 0;
+            if (cached)
+            {
+                ret = 0;
+                playerState->cachedSeeks++;
             }
             else
             {
-                if (audioDecoder)
+                // 拖动时解复用器只读取关键帧，结束拖动之后恢复
+                setScrubDiscard(scrub);
+                // 关键帧索引覆盖了目标时，直接以字节方式定位到目标之前最近的关键帧
+                int64_t index_pos, index_time;
+                int indexed = seek_rel == 0 && !(seek_flags & AVSEEK_FLAG_BYTE)
+                              && seekIndex->lookup(seek_target, &index_pos, &index_time) == 0;
+                playerState->seekInterruptible = 1;
+                if (indexed)
+                {
+                    ret = avformat_seek_file(pFormatCtx, -1, INT64_MIN, index_pos, INT64_MAX,
+                                             AVSEEK_FLAG_BYTE);
+                    TRACE_INSTANT("seek_index", (int64_t) av_rescale(index_time, 1000, AV_TIME_BASE));
+                }
+                else
                 {
-                    audioDecoder->flush();
+                    ret = avformat_seek_file(pFormatCtx, -1, seek_min, seek_target, seek_max,
+                                             seek_flags);
                 }
-                if (videoDecoder)
+                playerState->seekInterruptible = 0;
+                playerState->demuxerSeeks++;
+                if (indexed && ret >= 0)
                 {
-                    videoDecoder->flush();
+                    playerState->indexSeeks++;
                 }
+                indexCursor = AV_NOPTS_VALUE;
+                // 解复用器定位之后读出的数据包与缓存不再连续，定位失败时读取位置也不确定
+                packetCache->clear();
+                playerState->packetCacheBytes = 0;
+                audioBufferedTime = AV_NOPTS_VALUE;
+                videoBufferedTime = AV_NOPTS_VALUE;
+                if (ret >= 0)
+                {
+                    flushDecoders(request_time, accurate_target);
+                    scrubPending = scrub;
+                }
+            }
 
+            // 被新的定位请求中断，直接执行新的定位，不回调定位完成
+            if (ret < 0 && playerState->seekRequest && !playerState->abortRequest)
+            {
+                // 中断发生在读取过程中时，AVIOContext会记住AVERROR_EXIT和结尾标志，avio_seek不会清除，
+                // 不清除的话之后任何一次读取失败都会被当成读取出错而退出读包线程
+                if (pFormatCtx->pb)
+                {
+                    pFormatCtx->pb->error = 0;
+                    pFormatCtx->pb->eof_reached = 0;
+                }
+                playerState->abortedSeeks++;
+                TRACE_INSTANT("seek_aborted", (int64_t) av_rescale(seek_target, 1000, AV_TIME_BASE));
+                continue;
+            }
+            if (ret < 0)
+            {
+                av_log(NULL, AV_LOG_ERROR, "%s: error while seeking\n", playerState->url);
+            }
+            else
+            {
                 // 更新外部时钟值
-                if (playerState->seekFlags & AVSEEK_FLAG_BYTE)
+                if (seek_flags & AVSEEK_FLAG_BYTE)
                 {
                     mediaSync->updateExternalClock(NAN);
                 }
@@ -870,11 +1292,17 @@ int MediaPlayerEx::readPackets()
                 mediaSync->refreshVideoTimer();
             }
             attachmentRequest = 1;
-            playerState->seekRequest = 0;
-            mCondition.notify_one();
             eof = 0;
+            // 已经有新的定位请求时，定位状态和完成回调留给最后一次定位
+            mSeekMutex.lock();
+            int superseded = playerState->seekRequest;
+            if (!superseded && !playerState->scrubbing)
+            {
+                playerState->playback.endSeek();
+            }
+            mSeekMutex.unlock();
             // 定位完成回调通知
-            if (playerState->messageQueue)
+            if (!superseded && playerState->messageQueue)
             {
                 playerState->messageQueue->postMessage(MSG_SEEK_COMPLETE,
                                                        (int) av_rescale(seek_target, 1000,
@@ -898,21 +1326,33 @@ int MediaPlayerEx::readPackets()
             attachmentRequest = 0;
         }
 
-        // 如果队列中存在足够的数据包，则等待消耗
-        // 备注：这里要等待一定时长的缓冲队列，要不然会导致OpenSLES播放音频出现卡顿等现象
-        if (playerState->infiniteBuffer < 1 &&
-            ((audioDecoder ? audioDecoder->getMemorySize() : 0) +
-             (videoDecoder ? videoDecoder->getMemorySize() : 0) > MAX_QUEUE_SIZE
-             || (!audioDecoder || audioDecoder->hasEnoughPackets()) &&
-                (!videoDecoder || videoDecoder->hasEnoughPackets())))
+        // 拖动时送出目标附近的关键帧之后不再读包，等待新的拖动位置
+        if (playerState->scrubbing && !scrubPending)
         {
+            waitScrubRequest();
             continue;
         }
 
+        // 如果队列中存在足够的数据包，则休眠等待消耗到低水位
+        // 备注：这里要等待一定时长的缓冲队列，要不然会导致OpenSLES播放音频出现卡顿等现象
+        if (playerState->infiniteBuffer < 1)
+        {
+            int sizeLimited = getQueueMemorySize() > MAX_QUEUE_SIZE;
+            if (sizeLimited || ((!audioDecoder || audioDecoder->hasEnoughPackets()) &&
+                                (!videoDecoder || videoDecoder->hasEnoughPackets())))
+            {
+                waitQueueLowWatermark(sizeLimited);
+                continue;
+            }
+        }
+
         // 读出数据包
         if (!waitToSeek)
         {
+            TRACE_SCOPE("av_read_frame");
+            STATS_BEGIN(readStart);
             ret = av_read_frame(pFormatCtx, pkt);
+            STATS_END(playerState, STAGE_DEMUX, readStart);
         }
         else
         {
@@ -924,6 +1364,10 @@ int MediaPlayerEx::readPackets()
             if ((ret == AVERROR_EOF || avio_feof(pFormatCtx->pb)) && !eof)
             {
                 eof = 1;
+                if (mDuration > 0)
+                {
+                    playerState->playback.setBufferedPosition(mDuration);
+                }
             }
             // 读取出错，则直接退出
             if (pFormatCtx->pb && pFormatCtx->pb->error)
@@ -933,7 +1377,8 @@ int MediaPlayerEx::readPackets()
             }
 
             // 如果不处于暂停状态，并且队列中所有数据都没有，则判断是否需要
-            if (!playerState->pauseRequest && (!audioDecoder || audioDecoder->getPacketSize() == 0)
+            if (!playerState->pauseRequest && !playerState->scrubbing
+                && (!audioDecoder || audioDecoder->getPacketSize() == 0)
                 && (!videoDecoder || (videoDecoder->getPacketSize() == 0
                                       && videoDecoder->getFrameSize() == 0)))
             {
@@ -954,6 +1399,8 @@ int MediaPlayerEx::readPackets()
         else
         {
             eof = 0;
+            playerState->markStartupPhase(STARTUP_FIRST_PACKET);
+            seekIndex->addPacket(pkt, &indexCursor);
         }
 
         // 计算pkt的pts是否处于播放范围内
@@ -967,6 +1414,28 @@ int MediaPlayerEx::readPackets()
                          (double) (playerState->startTime != AV_NOPTS_VALUE ? playerState->startTime
                                                                             : 0) / 1000000
                          <= ((double) playerState->duration / 1000000);
+        // 拖动时只送出第一个视频关键帧，送入空数据包让解码器立即输出，其他数据包丢弃
+        if (scrubPending || scrubDiscard)
+        {
+            if (scrubPending && playInRange && videoDecoder
+                && pkt->stream_index == videoDecoder->getStreamIndex()
+                && (pkt->flags & AV_PKT_FLAG_KEY))
+            {
+                videoDecoder->pushPacket(pkt);
+                videoDecoder->pushNullPacket();
+                scrubPending = 0;
+            }
+            else
+            {
+                av_packet_unref(pkt);
+            }
+            continue;
+        }
+        if (playInRange)
+        {
+            updateBufferedPosition(pkt);
+            cachePacket(pkt);
+        }
         if (playInRange && audioDecoder && pkt->stream_index == audioDecoder->getStreamIndex())
         {
             audioDecoder->pushPacket(pkt);
@@ -986,6 +1455,9 @@ int MediaPlayerEx::readPackets()
         }
     }
 
+    packetCache->clear();
+    playerState->packetCacheBytes = 0;
+    closeSeekIndex();
     if (audioDecoder)
     {
         audioDecoder->stop();
@@ -998,14 +1470,27 @@ int MediaPlayerEx::readPackets()
     {
         audioDevice->stop();
     }
+    if (audioResampler)
+    {
+        audioResampler->stop();
+    }
     if (mediaSync)
     {
         mediaSync->stop();
     }
+    mMutex.lock();
     mExit = true;
+    // 停止时由stop设置状态
+    if (!playerState->abortRequest)
+    {
+        playerState->playback.setState(ret < 0 && ret != AVERROR_EOF ? PLAYBACK_ERROR
+                                                                     : PLAYBACK_COMPLETED);
+    }
     mCondition.notify_one();
+    mMutex.unlock();
 
-    if (ret < 0)
+    // 自动退出时读到结尾也是播放完成
+    if (ret < 0 && ret != AVERROR_EOF)
     {
         if (playerState->messageQueue)
         {
@@ -1031,14 +1516,317 @@ int MediaPlayerEx::readPackets()
     return ret;
 }
 
+/**
+ * 切换到播放状态并回调开始，状态切换与start、pause在同一把锁下进行
+ */
+void MediaPlayerEx::notifyStarted()
+{
+    mMutex.lock();
+    if (!playerState->abortRequest && !playerState->pauseRequest)
+    {
+        playerState->playback.setState(PLAYBACK_PLAYING);
+    }
+    mMutex.unlock();
+    if (playerState->messageQueue)
+    {
+        playerState->messageQueue->postMessage(MSG_STARTED);
+    }
+}
+
+/**
+ * 查找媒体流信息
+ * @return
+ */
+int MediaPlayerEx::findStreamInfo()
+{
+    AVDictionary **opts = setupStreamInfoOptions(pFormatCtx, playerState->codec_opts);
+    int nbStreams = pFormatCtx->nb_streams;
+
+    TRACE_BEGIN("find_stream_info");
+    int ret = avformat_find_stream_info(pFormatCtx, opts);
+    TRACE_END("find_stream_info");
+    if (opts != NULL)
+    {
+        for (int i = 0; i < nbStreams; i++)
+        {
+            if (opts[i] != NULL)
+            {
+                av_dict_free(&opts[i]);
+            }
+        }
+        av_freep(&opts);
+    }
+    return ret;
+}
+
+/**
+ * 已读取到的位置取音频、视频数据包中较小的一个，只有一种媒体流时取该媒体流的位置，封面图片不算作视频流
+ * @param pkt
+ */
+void MediaPlayerEx::updateBufferedPosition(AVPacket *pkt)
+{
+    int hasAudio = audioDecoder != NULL;
+    int hasVideo = videoDecoder != NULL
+                   && !(videoDecoder->getStream()->disposition & AV_DISPOSITION_ATTACHED_PIC);
+    int64_t pts = pkt->pts == AV_NOPTS_VALUE ? pkt->dts : pkt->pts;
+    if (pts == AV_NOPTS_VALUE)
+    {
+        return;
+    }
+    AVStream *stream = pFormatCtx->streams[pkt->stream_index];
+    int64_t time = av_rescale_q(pts, stream->time_base, av_make_q(1, 1000));
+    if (pFormatCtx->start_time > 0 && pFormatCtx->start_time != AV_NOPTS_VALUE)
+    {
+        time -= av_rescale(pFormatCtx->start_time, 1000, AV_TIME_BASE);
+    }
+    if (hasAudio && pkt->stream_index == audioDecoder->getStreamIndex())
+    {
+        audioBufferedTime = time;
+    }
+    else if (hasVideo && pkt->stream_index == videoDecoder->getStreamIndex())
+    {
+        videoBufferedTime = time;
+    }
+    else
+    {
+        return;
+    }
+    if ((hasAudio && audioBufferedTime == AV_NOPTS_VALUE)
+        || (hasVideo && videoBufferedTime == AV_NOPTS_VALUE))
+    {
+        return;
+    }
+    int64_t buffered = INT64_MAX;
+    if (hasAudio)
+    {
+        buffered = FFMIN(buffered, audioBufferedTime);
+    }
+    if (hasVideo)
+    {
+        buffered = FFMIN(buffered, videoBufferedTime);
+    }
+    playerState->playback.setBufferedPosition(FFMAX(buffered, 0));
+}
+
+/**
+ * 在数据包缓存中定位，目标在缓存范围内时清空解码器队列，把目标之前最近的关键帧开始的数据包重新送入解码器
+ * 解复用器的读取位置不变，之后读出的数据包接在缓存的数据包后面
+ * @param target 定位目标(AV_TIME_BASE)
+ * @param requestTime 请求定位的时间，用于统计定位耗时
+ * @param keyOnly 拖动预览，只送出目标之前最近的关键帧
+ * @param accurateTarget 精确定位的目标(AV_TIME_BASE)，AV_NOPTS_VALUE表示从关键帧开始播放
+ * @return 0表示在缓存中完成了定位，小于0表示需要解复用器定位
+ */
+int MediaPlayerEx::seekPacketCache(int64_t target, int64_t requestTime, int keyOnly,
+                                   int64_t accurateTarget)
+{
+    if (packetCache->seek(target / (double) AV_TIME_BASE) < 0)
+    {
+        return -1;
+    }
+    AVPacket pkt1, *pkt = &pkt1;
+    av_init_packet(pkt);
+    // 拖动时只送出关键帧，缓存以音频作为定位点时没有视频关键帧
+    if (keyOnly)
+    {
+        if (!videoDecoder || packetCache->getKeyPacket(pkt) < 0)
+        {
+            return -1;
+        }
+        if (pkt->stream_index != videoDecoder->getStreamIndex())
+        {
+            av_packet_unref(pkt);
+            return -1;
+        }
+        flushDecoders(requestTime, AV_NOPTS_VALUE);
+        videoDecoder->pushPacket(pkt);
+        videoDecoder->pushNullPacket();
+        TRACE_INSTANT("packet_cache_scrub", 1);
+        return 0;
+    }
+    flushDecoders(requestTime, accurateTarget);
+    int count = 0;
+    while (packetCache->nextPacket(pkt) > 0)
+    {
+        if (audioDecoder && pkt->stream_index == audioDecoder->getStreamIndex())
+        {
+            audioDecoder->pushPacket(pkt);
+        }
+        else if (videoDecoder && pkt->stream_index == videoDecoder->getStreamIndex())
+        {
+            videoDecoder->pushPacket(pkt);
+        }
+        else
+        {
+            av_packet_unref(pkt);
+        }
+        av_init_packet(pkt);
+        count++;
+    }
+    TRACE_INSTANT("packet_cache_seek", count);
+    return 0;
+}
+
+/**
+ * 视频流只读取关键帧，音频流全部丢弃，解复用器不支持丢弃时由读包线程丢弃
+ * @param enable
+ */
+void MediaPlayerEx::setScrubDiscard(int enable)
+{
+    if (scrubDiscard == enable)
+    {
+        return;
+    }
+    scrubDiscard = enable;
+    if (videoDecoder)
+    {
+        pFormatCtx->streams[videoDecoder->getStreamIndex()]->discard =
+                enable ? AVDISCARD_NONKEY : AVDISCARD_DEFAULT;
+    }
+    if (audioDecoder)
+    {
+        pFormatCtx->streams[audioDecoder->getStreamIndex()]->discard =
+                enable ? AVDISCARD_ALL : AVDISCARD_DEFAULT;
+    }
+}
+
+void MediaPlayerEx::waitScrubRequest()
+{
+    TRACE_SCOPE("wait_scrub");
+    playerState->readMutex.lock();
+    while (!playerState->abortRequest && !playerState->seekRequest && playerState->scrubbing)
+    {
+        playerState->readCondition.waitRelative(playerState->readMutex,
+                                                READ_WAIT_TIMEOUT * 1000000LL);
+    }
+    playerState->readMutex.unlock();
+}
+
+/**
+ * 刷新解码器，序列号递增，解码线程、同步线程丢弃之前的数据包和帧
+ * 开始统计定位耗时，有视频时以第一次送显作为定位完成，否则以第一次输出声音作为定位完成
+ * 精确定位时给解码器设置目标，追赶耗时同样以视频为准，没有视频时以音频为准
+ * @param requestTime 请求定位的时间
+ * @param accurateTarget 精确定位的目标(AV_TIME_BASE)，AV_NOPTS_VALUE表示不需要追赶
+ */
+void MediaPlayerEx::flushDecoders(int64_t requestTime, int64_t accurateTarget)
+{
+    if (audioDecoder)
+    {
+        audioDecoder->flush();
+        audioDecoder->setSeekTarget(accurateTarget, videoDecoder == NULL);
+    }
+    if (videoDecoder)
+    {
+        videoDecoder->flush();
+        videoDecoder->setSeekTarget(accurateTarget, 1);
+        playerState->beginSeekLatency(requestTime, videoDecoder->getPacketSerial(), 0);
+    }
+    else if (audioDecoder)
+    {
+        playerState->beginSeekLatency(requestTime, audioDecoder->getPacketSerial(), 1);
+    }
+}
+
+/**
+ * mpegts等以字节定位的格式没有索引，按时间定位需要解复用器逐步逼近，记录读出的关键帧作为索引
+ * 有视频时以视频关键帧作为索引点，封面图片不算作视频流，索引文件保存在探测结果缓存的目录中
+ */
+void MediaPlayerEx::openSeekIndex()
+{
+    indexCursor = AV_NOPTS_VALUE;
+    if (!playerState->seekIndexEnable || playerState->realTime || !playerState->seekByBytes
+        || !pFormatCtx->pb || !(pFormatCtx->pb->seekable & AVIO_SEEKABLE_NORMAL))
+    {
+        return;
+    }
+    int streamIndex = -1;
+    if (videoDecoder && !(videoDecoder->getStream()->disposition & AV_DISPOSITION_ATTACHED_PIC))
+    {
+        streamIndex = videoDecoder->getStreamIndex();
+    }
+    else if (audioDecoder)
+    {
+        streamIndex = audioDecoder->getStreamIndex();
+    }
+    if (streamIndex < 0)
+    {
+        return;
+    }
+    seekIndex->open(streamIndex, pFormatCtx->streams[streamIndex]);
+    if (playerState->probeCacheDir)
+    {
+        char *path = getCacheFilePath(playerState->probeCacheDir, playerState->url, "index");
+        if (path)
+        {
+            int64_t size, mtime;
+            getCacheSignature(pFormatCtx, playerState->url, &size, &mtime);
+            seekIndex->load(path, playerState->url, size, mtime);
+            av_free(path);
+        }
+    }
+    if (playerState->seekIndexScan)
+    {
+        seekIndex->startScan(playerState->url, pFormatCtx->iformat);
+    }
+}
+
+void MediaPlayerEx::closeSeekIndex()
+{
+    if (!seekIndex->isEnabled())
+    {
+        return;
+    }
+    seekIndex->stopScan();
+    if (playerState->probeCacheDir)
+    {
+        char *path = getCacheFilePath(playerState->probeCacheDir, playerState->url, "index");
+        if (path)
+        {
+            int64_t size, mtime;
+            getCacheSignature(pFormatCtx, playerState->url, &size, &mtime);
+            seekIndex->save(path, playerState->url, size, mtime);
+            av_free(path);
+        }
+    }
+}
+
+/**
+ * 缓存送入解码器的数据包，数据与解码器队列共享，需要在数据包送入解码器之前调用
+ * @param pkt
+ */
+void MediaPlayerEx::cachePacket(AVPacket *pkt)
+{
+    if (!packetCache->isEnabled())
+    {
+        return;
+    }
+    if ((!audioDecoder || pkt->stream_index != audioDecoder->getStreamIndex())
+        && (!videoDecoder || pkt->stream_index != videoDecoder->getStreamIndex()))
+    {
+        return;
+    }
+    int64_t pts = pkt->pts == AV_NOPTS_VALUE ? pkt->dts : pkt->pts;
+    double time = NAN;
+    if (pts != AV_NOPTS_VALUE)
+    {
+        time = pts * av_q2d(pFormatCtx->streams[pkt->stream_index]->time_base);
+    }
+    packetCache->addPacket(pkt, time);
+    packetCache->trim(mediaSync->getMasterClock());
+    playerState->packetCacheBytes = packetCache->getSize();
+}
+
 int MediaPlayerEx::prepareDecoder(int streamIndex)
 {
     AVCodecContext *avctx;
     AVCodec *codec = NULL;
     AVDictionary *opts = NULL;
     AVDictionaryEntry *t = NULL;
+    FrameBufferPool *framePool = NULL;
     int ret = 0;
     const char *forcedCodecName = NULL;
+    TRACE_SCOPE_ARG("prepare_decoder", streamIndex);
 
     if (streamIndex < 0 || streamIndex >= pFormatCtx->nb_streams)
     {
@@ -1148,6 +1936,17 @@ int MediaPlayerEx::prepareDecoder(int streamIndex)
             av_dict_set(&opts, "refcounted_frames", "1", 0);
         }
 
+        // 视频解码帧使用播放器的缓冲池，需要在打开解码器之前设置
+        if (avctx->codec_type == AVMEDIA_TYPE_VIDEO)
+        {
+            framePool = new FrameBufferPool(playerState);
+            if (framePool->attach(avctx, codec) < 0)
+            {
+                framePool->release();
+                framePool = NULL;
+            }
+        }
+
         // 打开解码器
         if ((ret = avcodec_open2(avctx, codec, &opts)) < 0)
         {
@@ -1166,15 +1965,21 @@ int MediaPlayerEx::prepareDecoder(int streamIndex)
         {
             case AVMEDIA_TYPE_AUDIO:
             {
-                audioDecoder = new AudioDecoder(avctx, pFormatCtx->streams[streamIndex],
-                                                streamIndex, playerState);
+                AudioDecoder *decoder = new AudioDecoder(avctx, pFormatCtx->streams[streamIndex],
+                                                         streamIndex, playerState);
+                std::lock_guard<std::mutex> lock(mStatsMutex);
+                audioDecoder = decoder;
                 break;
             }
 
             case AVMEDIA_TYPE_VIDEO:
             {
-                videoDecoder = new VideoDecoder(pFormatCtx, avctx, pFormatCtx->streams[streamIndex],
-                                                streamIndex, playerState);
+                VideoDecoder *decoder = new VideoDecoder(pFormatCtx, avctx,
+                                                         pFormatCtx->streams[streamIndex],
+                                                         streamIndex, playerState, framePool);
+                framePool = NULL;
+                std::lock_guard<std::mutex> lock(mStatsMutex);
+                videoDecoder = decoder;
                 attachmentRequest = 1;
                 break;
             }
@@ -1198,6 +2003,11 @@ int MediaPlayerEx::prepareDecoder(int streamIndex)
         }
         avcodec_free_context(&avctx);
     }
+    if (framePool)
+    {
+        framePool->release();
+        framePool = NULL;
+    }
 
     // 释放参数
     av_dict_free(&opts);
@@ -1278,7 +2088,8 @@ int MediaPlayerEx::openAudioDevice(int64_t wanted_channel_layout, int wanted_nb_
         }
     }
 
-    // 初始化音频重采样器
+    // 初始化音频重采样器，设置参数时会替换PCM缓冲区，与getStats互斥
+    std::lock_guard<std::mutex> lock(mStatsMutex);
     if (!audioResampler)
     {
         audioResampler = new AudioResampler(playerState, audioDecoder, mediaSync);
@@ -1291,15 +2102,28 @@ int MediaPlayerEx::openAudioDevice(int64_t wanted_channel_layout, int wanted_nb_
 
 void MediaPlayerEx::pcmQueueCallback(uint8_t *stream, int len)
 {
-    if (!audioResampler)
+    TRACE_THREAD("audio_device");
+    TRACE_SCOPE("audio_callback");
+    // 拖动时静音
+    if (!audioResampler || playerState->scrubbing)
     {
-        memset(stream, 0, sizeof(len));
+        memset(stream, 0, len);
         return;
     }
     audioResampler->pcmQueueCallback(stream, len);
+    if (!mediaSync)
+    {
+        return;
+    }
+    int64_t pos = mediaSync->updatePosition();
+    // 没有视频时以第一次输出音频作为起播完成
+    if (!videoDecoder && !isnan(mediaSync->getAudioClock()->getClock()))
+    {
+        playerState->markStartupPhase(STARTUP_FIRST_FRAME);
+    }
     if (playerState->messageQueue && playerState->syncType != AV_SYNC_VIDEO)
     {
-        playerState->messageQueue->postMessage(MSG_CURRENT_POSITON, getCurrentPosition(),
+        playerState->messageQueue->postMessage(MSG_CURRENT_POSITON, (int) pos,
                                                playerState->videoDuration);
     }
 }
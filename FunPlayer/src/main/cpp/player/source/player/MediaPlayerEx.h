@@ -10,17 +10,23 @@
 
 #include <device/android/SLESDevice.h>
 #include <device/android/GLESDevice.h>
+#include <android/native_window.h>
+#include <android/native_window_jni.h>
 
 #else
-#include <device/AudioDevice.h>
-#include <device/VideoDevice.h>
+#include <device/null/NullAudioDevice.h>
+#include <device/null/NullVideoDevice.h>
 #endif
 
-#include <android/native_window.h>
-#include <android/native_window_jni.h>
 #include <sync/MediaSync.h>
 #include <convertor/AudioResampler.h>
+#include <common/ProbeCache.h>
+#include <common/ReadAheadIO.h>
+#include <common/SeekIndex.h>
+#include <queue/PacketCache.h>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
 
 class MediaPlayerEx
 {
@@ -47,8 +53,18 @@ public:
 
     void stop();
 
+    // 定位，不阻塞调用线程，连续调用时只执行最新的目标
     void seekTo(float timeMs);
 
+    // 开始拖动进度条，只解码目标附近的关键帧并立即显示，不解码音频，没有视频时不起作用
+    void beginScrub();
+
+    // 拖动到新的位置
+    void updateScrub(float timeMs);
+
+    // 结束拖动，定位到最后一次拖动的位置并恢复正常播放
+    void endScrub();
+
     void setLooping(int looping);
 
     void setVolume(float leftVolume, float rightVolume);
@@ -73,6 +89,18 @@ public:
 
     int isLooping();
 
+    // 获取视频时钟与音频时钟的差值(秒)，没有音频或者视频时返回NAN
+    double getAVDiff();
+
+    // 获取流水线各阶段的耗时统计以及队列深度
+    void getStats(PlayerStats *stats);
+
+    // 获取播放状态快照，不加锁，可以在任意线程调用
+    void getPlaybackSnapshot(PlaybackSnapshot *snapshot);
+
+    // 导出事件跟踪数据到JSON文件，需要通过"trace"参数开启，返回导出的事件数
+    int dumpTrace(const char *path);
+
     int getMetadata(AVDictionary **metadata);
 
     AVMessageQueue *getMessageQueue();
@@ -87,6 +115,45 @@ protected:
 private:
     int readPackets();
 
+    // 获取数据包队列占用的内存大小
+    int getQueueMemorySize();
+
+    // 等待数据包队列消耗到低水位
+    void waitQueueLowWatermark(int sizeLimited);
+
+    // 唤醒读包线程
+    void notifyReadThread();
+
+    // 切换到播放状态并回调开始
+    void notifyStarted();
+
+    // 查找媒体流信息
+    int findStreamInfo();
+
+    // 根据读出的数据包更新已读取到的位置
+    void updateBufferedPosition(AVPacket *pkt);
+
+    // 在数据包缓存中定位，把目标之前最近的关键帧开始的数据包重新送入解码器
+    int seekPacketCache(int64_t target, int64_t requestTime, int keyOnly, int64_t accurateTarget);
+
+    // 拖动预览时只读取关键帧，丢弃其他视频数据包以及音频数据包
+    void setScrubDiscard(int enable);
+
+    // 拖动预览时，已经送出目标附近的关键帧之后等待新的拖动位置
+    void waitScrubRequest();
+
+    // 刷新解码器并开始统计定位耗时，精确定位时设置解码器追赶的目标
+    void flushDecoders(int64_t requestTime, int64_t accurateTarget);
+
+    // 缓存送入解码器的数据包，并丢弃播放位置之前超出保留范围的数据包
+    void cachePacket(AVPacket *pkt);
+
+    // 没有索引的格式开始记录关键帧索引，读取保存的索引文件，按需启动后台扫描
+    void openSeekIndex();
+
+    // 停止后台扫描，保存索引文件
+    void closeSeekIndex();
+
     // prepare decoder with stream_index
     int prepareDecoder(int streamIndex);
 
@@ -96,6 +163,8 @@ private:
 private:
     std::mutex                  mMutex;
     std::condition_variable     mCondition;
+    std::mutex                  mSeekMutex;                 // 定位请求锁，定位不等待准备和读包
+    std::mutex                  mStatsMutex;                // 统计读取的对象在发布、替换和释放时持有，不会在打开和探测期间持有
     std::thread                 mThread;                    // 读数据包线程
     PlayerState*                playerState;                // 播放器状态
     AudioDecoder*               audioDecoder;               // 音频解码器
@@ -107,6 +176,16 @@ private:
     int                         lastPaused;                 // 上一次暂停状态
     int                         eof;                        // 数据包读到结尾标志
     int                         attachmentRequest;          // 视频封面数据包请求
+    int64_t                     audioBufferedTime;          // 音频数据包读取到的位置(毫秒)
+    int64_t                     videoBufferedTime;          // 视频数据包读取到的位置(毫秒)
+    PacketCache*                packetCache;                // 已读取数据包的缓存，定位在缓存范围内时不需要解复用器定位
+    float                       scrubTarget;                // 最后一次拖动的位置(毫秒)
+    int                         scrubDiscard;               // 解复用器是否只读取关键帧
+    int                         scrubPending;               // 拖动定位之后还没有送出关键帧
+    SeekIndex*                  seekIndex;                  // 关键帧索引，没有索引的格式按索引以字节定位
+    int64_t                     indexCursor;                // 连续读出的最后一个索引项，解复用器定位之后中断
+    ReadAheadIO*                readAheadIO;                // 预读I/O层，NULL表示使用默认的I/O
+    bool                        traceStarted;               // 是否开启了事件跟踪，销毁时停止
 
     AudioDevice*                audioDevice;                // 音频输出设备
     AudioResampler*             audioResampler;             // 音频重采样器
@@ -35,6 +35,8 @@ void PlayerState::init()
 
     audioCodecName = NULL;
     videoCodecName = NULL;
+    probeCacheDir = NULL;
+    queueMemorySize = 0;
     messageQueue = new AVMessageQueue();
 }
 
@@ -63,6 +65,7 @@ void PlayerState::reset()
         av_freep(&url);
         url = NULL;
     }
+    av_freep(&probeCacheDir);
     offset = 0;
     abortRequest = 1;
     pauseRequest = 1;
@@ -84,13 +87,124 @@ void PlayerState::reset()
     seekFlags = 0;
     seekPos = 0;
     seekRel = 0;
-    seekRel = 0;
+    seekRequestTime = 0;
+    seekInterruptible = 0;
+    scrubbing = 0;
     autoExit = 0;
     loop = 1;
     mute = 0;
     frameDrop = 1;
     reorderVideoPts = -1;
+    audioBufferTime = AUDIO_BUFFER_TIME;
+    convertThreads = 0;
+    traceCapacity = 0;
+    eventBatchTime = 0;
+    fastStart = 0;
+    packetCacheTime = PACKET_CACHE_TIME;
+    packetCacheSize = PACKET_CACHE_SIZE;
+    accurateSeek = 0;
+    seekIndexEnable = 1;
+    seekIndexScan = 0;
+    ioBufferSize = READ_AHEAD_BUFFER_SIZE;
+    serialDecode = 0;
     videoDuration = 0;
+    decodedFrames = 0;
+    droppedFrames = 0;
+    readBlockedCount = 0;
+    readBlockedTime = 0;
+    audioUnderruns = 0;
+    audioBufferLevel = 0;
+    codecLockWaitTime = 0;
+    framePoolHits = 0;
+    framePoolMisses = 0;
+    framePoolPeakBytes = 0;
+    convertedFrames = 0;
+    convertTime = 0;
+    presentError.reset();
+    repeatedFrames = 0;
+    skippedFrames = 0;
+    cachedSeeks = 0;
+    demuxerSeeks = 0;
+    indexSeeks = 0;
+    packetCacheBytes = 0;
+    coalescedSeeks = 0;
+    abortedSeeks = 0;
+    seekPendingSerial = -1;
+    seekPendingAudio = 0;
+    seekPendingTime = 0;
+    seekLatency.reset();
+    accurateSeeks = 0;
+    catchupFrames = 0;
+    catchupTime.reset();
+    for (int i = 0; i < STAGE_COUNT; ++i)
+    {
+        stageLatency[i].reset();
+    }
+    startupBegin = 0;
+    for (int i = 0; i < STARTUP_PHASE_COUNT; ++i)
+    {
+        startupTime[i] = 0;
+    }
+    playback.reset();
+}
+
+void PlayerState::beginStartup()
+{
+    for (int i = 0; i < STARTUP_PHASE_COUNT; ++i)
+    {
+        startupTime[i].store(0, std::memory_order_relaxed);
+    }
+    startupBegin.store(av_gettime_relative(), std::memory_order_release);
+}
+
+/**
+ * 音频回调线程、同步线程都可能记录第一帧，只保留最先记录的时间
+ * @param phase
+ */
+void PlayerState::markStartupPhase(int phase)
+{
+    if (startupTime[phase].load(std::memory_order_relaxed) != 0)
+    {
+        return;
+    }
+    int64_t time = av_gettime_relative() - startupBegin.load(std::memory_order_acquire);
+    int64_t expected = 0;
+    startupTime[phase].compare_exchange_strong(expected, FFMAX(time, 1),
+                                               std::memory_order_relaxed);
+}
+
+/**
+ * 由读包线程在刷新解码器之后、送入新的数据包之前调用，被替换的定位不统计
+ * @param requestTime
+ * @param serial
+ * @param audio
+ */
+void PlayerState::beginSeekLatency(int64_t requestTime, int serial, int audio)
+{
+    seekPendingSerial.store(-1, std::memory_order_relaxed);
+    seekPendingTime.store(requestTime, std::memory_order_relaxed);
+    seekPendingAudio.store(audio, std::memory_order_relaxed);
+    seekPendingSerial.store(serial, std::memory_order_release);
+}
+
+/**
+ * 同步线程送显、音频重采样线程输出时调用，只有序列号和媒体类型都匹配的第一次调用会记录
+ * @param serial
+ * @param audio
+ */
+void PlayerState::markSeekPresented(int serial, int audio)
+{
+    if (serial < 0 || seekPendingSerial.load(std::memory_order_acquire) != serial
+        || seekPendingAudio.load(std::memory_order_relaxed) != audio)
+    {
+        return;
+    }
+    int64_t requestTime = seekPendingTime.load(std::memory_order_relaxed);
+    int expected = serial;
+    if (seekPendingSerial.compare_exchange_strong(expected, -1, std::memory_order_relaxed))
+    {
+        seekLatency.add(av_gettime_relative() - requestTime);
+    }
 }
 
 void PlayerState::setOption(int category, const char *type, const char *option)
@@ -175,6 +289,11 @@ void PlayerState::parse_string(const char *type, const char *option)
     {   // 指定视频解码器名称
         videoCodecName = av_strdup(option);
     }
+    else if (!strcmp("probecache", type))
+    { // 媒体流探测结果的缓存目录
+        av_freep(&probeCacheDir);
+        probeCacheDir = av_strdup(option);
+    }
     else if (!strcmp("sync", type))
     { // 制定同步类型
         if (!strcmp("audio", option))
@@ -250,6 +369,54 @@ void PlayerState::parse_int(const char *type, int64_t option)
     { // 无限缓冲区标志
         infiniteBuffer = (option > 0) ? 1 : ((option < 0) ? -1 : 0);
     }
+    else if (!strcmp("abuftime", type))
+    { // 音频PCM缓冲时长(毫秒)
+        audioBufferTime = (int) FFMAX(option, AUDIO_MIN_BUFFER_TIME);
+    }
+    else if (!strcmp("convthreads", type))
+    { // 视频格式转换线程数
+        convertThreads = (int) av_clip64(option, 0, VIDEO_CONVERT_MAX_THREADS);
+    }
+    else if (!strcmp("eventbatch", type))
+    { // 批量投递事件的时间窗口(毫秒)
+        eventBatchTime = (int) av_clip64(option, 0, EVENT_BATCH_MAX_TIME);
+    }
+    else if (!strcmp("faststart", type))
+    { // 快速起播
+        fastStart = (option != 0) ? 1 : 0;
+    }
+    else if (!strcmp("pktcachetime", type))
+    { // 数据包缓存在播放位置之前保留的时长(毫秒)，0表示不缓存
+        packetCacheTime = (int) av_clip64(option, 0, INT_MAX);
+    }
+    else if (!strcmp("pktcachesize", type))
+    { // 数据包缓存占用内存的上限(字节)
+        packetCacheSize = FFMAX(option, 0);
+    }
+    else if (!strcmp("seekindex", type))
+    { // 没有索引的格式记录关键帧索引
+        seekIndexEnable = (option != 0) ? 1 : 0;
+    }
+    else if (!strcmp("indexscan", type))
+    { // 后台扫描补全关键帧索引
+        seekIndexScan = (option != 0) ? 1 : 0;
+    }
+    else if (!strcmp("iobuffer", type))
+    { // 预读I/O层环形缓冲区的大小(字节)，0表示不预读
+        ioBufferSize = (int) av_clip64(option, 0, READ_AHEAD_MAX_BUFFER_SIZE);
+    }
+    else if (!strcmp("serialdecode", type))
+    { // 音视频解码共用一把锁，用于对比
+        serialDecode = (option != 0) ? 1 : 0;
+    }
+    else if (!strcmp("accurateseek", type))
+    { // 精确定位，从关键帧解码追赶到目标位置
+        accurateSeek = (option != 0) ? 1 : 0;
+    }
+    else if (!strcmp("trace", type))
+    { // 事件跟踪，每个线程缓存的事件数，0表示不记录
+        traceCapacity = (int) av_clip64(option, 0, INT_MAX);
+    }
     else
     {
         ALOGE("unknown option - '%s'", type);
@@ -3,10 +3,15 @@
 
 #include <iostream>
 #include <thread>
+#include <atomic>
 
 #include <Mutex.h>
 #include <Condition.h>
 #include <common/FFmpegUtils.h>
+#include <common/LatencyHistogram.h>
+#include <common/PipelineStats.h>
+#include <common/PlaybackSnapshot.h>
+#include <common/TraceRecorder.h>
 
 extern "C" {
 #include <libavcodec/avcodec.h>
@@ -28,10 +33,44 @@ extern "C" {
 #define MAX_QUEUE_SIZE (15 * 1024 * 1024)
 #define MIN_FRAMES 25
 
+// 低水位，队列满时读包线程休眠，直到队列被消耗到低水位以下
+#define LOW_WATERMARK_FRAMES (MIN_FRAMES / 2)
+#define LOW_WATERMARK_DURATION 0.5
+#define LOW_WATERMARK_QUEUE_SIZE (MAX_QUEUE_SIZE * 3 / 4)
+
+// 读包线程等待队列空间的超时时长(毫秒)，只是兜底，正常由低水位、定位、暂停、退出等操作唤醒
+#define READ_WAIT_TIMEOUT 100
+
+// 视频格式转换的最大线程数，包括解码线程自己
+#define VIDEO_CONVERT_MAX_THREADS 4
+
+// 批量投递事件的最大时间窗口(毫秒)
+#define EVENT_BATCH_MAX_TIME 1000
+
+// 快速起播时探测媒体流信息的数据量(字节)和时长(微秒)上限，可以用同名的format参数覆盖
+#define FAST_START_PROBE_SIZE (256 * 1024)
+#define FAST_START_ANALYZE_DURATION (500 * 1000)
+
+// 数据包缓存在播放位置之前保留的时长(毫秒)以及缓存占用内存的上限(字节)，包括解码器队列中的数据包
+#define PACKET_CACHE_TIME (30 * 1000)
+#define PACKET_CACHE_SIZE (MAX_QUEUE_SIZE * 2)
+
+// 预读I/O层环形缓冲区的默认大小和上限(字节)
+#define READ_AHEAD_BUFFER_SIZE (4 * 1024 * 1024)
+#define READ_AHEAD_MAX_BUFFER_SIZE (64 * 1024 * 1024)
+
 #define AUDIO_MIN_BUFFER_SIZE 512
 
+// 音频PCM环形缓冲区的填充目标时长(毫秒)
+#define AUDIO_BUFFER_TIME 100
+#define AUDIO_MIN_BUFFER_TIME 20
+
+// 音频解码重采样线程等待的超时时长(毫秒)
+#define AUDIO_RESAMPLE_WAIT_TIMEOUT 10
+
 #define AUDIO_MAX_CALLBACKS_PER_SEC 30
 
+// 实时流同步到外部时钟时调整时钟速度的间隔
 #define REFRESH_RATE 0.01
 
 #define AV_SYNC_THRESHOLD_MIN 0.04
@@ -91,6 +130,18 @@ public:
 
     void setOptionLong(int category, const char *type, int64_t option);
 
+    // 开始记录起播耗时
+    void beginStartup();
+
+    // 记录起播阶段完成的时间，只记录第一次
+    void markStartupPhase(int phase);
+
+    // 开始统计定位耗时，serial为定位之后数据包队列的序列号，audio表示以音频输出作为定位完成
+    void beginSeekLatency(int64_t requestTime, int serial, int audio);
+
+    // 定位之后第一次输出画面或者声音，记录从请求定位到输出的耗时
+    void markSeekPresented(int serial, int audio);
+
 private:
     void init();
 
@@ -99,7 +150,10 @@ private:
     void parse_int(const char *type, int64_t option);
 
 public:
-    Mutex mMutex;                   // 操作互斥锁，主要是给seek操作、音视频解码以及清空解码上下文缓冲使用，不加锁会导致ffmpeg内部崩溃现象
+    Mutex readMutex;                // 读包线程等待队列空间的互斥锁
+    Condition readCondition;        // 唤醒读包线程的条件变量
+    std::atomic<int64_t> queueMemorySize;   // 所有数据包队列中节点占用的内存，由队列维护
+    Mutex codecMutex;               // 音视频解码共用的锁，只在串行解码的对比模式下使用
     AVDictionary *sws_dict;         // 视频转码option参数
     AVDictionary *swr_opts;         // 音频重采样option参数
     AVDictionary *format_opts;      // 解复用option参数
@@ -115,6 +169,7 @@ public:
 
     const char *audioCodecName;     // 指定音频解码器名称
     const char *videoCodecName;     // 指定视频解码器名称
+    char *probeCacheDir;            // 媒体流探测结果的缓存目录，NULL表示不缓存
 
     int abortRequest;               // 退出标志
     int pauseRequest;               // 暂停标志
@@ -139,12 +194,60 @@ public:
     int seekFlags;                  // 定位标志
     int64_t seekPos;                // 定位位置
     int64_t seekRel;                // 定位偏移
+    int64_t seekRequestTime;        // 最近一次请求定位的时间
+    std::atomic<int> seekInterruptible; // 解复用器定位过程中有新的定位请求时中断
+    std::atomic<int> scrubbing;     // 拖动进度条预览，只解码关键帧并立即显示，不解码音频
 
     int autoExit;                   // 是否自动退出
     int loop;                       // 循环播放
     int mute;                       // 静音播放
     int frameDrop;                  // 舍帧操作
     int reorderVideoPts;            // 视频帧重排pts
+    int audioBufferTime;            // 音频PCM缓冲的填充目标时长(毫秒)
+    int convertThreads;             // 视频格式转换的线程数，0表示根据CPU核数自动选择
+    int traceCapacity;              // 事件跟踪每个线程缓存的事件数，0表示不记录
+    int eventBatchTime;             // 批量投递事件的时间窗口(毫秒)，0表示逐个投递
+    int fastStart;                  // 快速起播，限制探测数据量、并行打开解码器、开始之前显示第一帧
+    int packetCacheTime;            // 数据包缓存在播放位置之前保留的时长(毫秒)，0表示不缓存
+    int64_t packetCacheSize;        // 数据包缓存占用内存的上限(字节)
+    int accurateSeek;               // 精确定位，定位到关键帧之后解码追赶到目标位置
+    int seekIndexEnable;            // 没有索引的格式记录读出的关键帧，按索引以字节定位
+    int seekIndexScan;              // 后台线程扫描文件补全关键帧索引
+    int ioBufferSize;               // 预读I/O层环形缓冲区的大小(字节)，0表示使用默认的I/O
+    int serialDecode;               // 音视频解码共用一把锁串行执行，只用于对比并行解码的收益
+
+    std::atomic<int64_t> decodedFrames; // 已解码的视频帧数
+    std::atomic<int64_t> droppedFrames; // 丢弃的视频帧数
+    std::atomic<int64_t> readBlockedCount;  // 读包线程因队列满而休眠的次数
+    std::atomic<int64_t> readBlockedTime;   // 读包线程因队列满而休眠的总时长(微秒)
+    std::atomic<int64_t> audioUnderruns;    // 音频回调时PCM缓冲数据不足的次数
+    std::atomic<int> audioBufferLevel;      // 音频PCM缓冲当前的时长(毫秒)
+    std::atomic<int64_t> codecLockWaitTime; // 串行解码时等待解码锁的总时长(微秒)
+    std::atomic<int64_t> framePoolHits;     // 视频帧缓冲池复用缓冲的次数
+    std::atomic<int64_t> framePoolMisses;   // 视频帧缓冲池新分配缓冲的次数
+    std::atomic<int64_t> framePoolPeakBytes;// 视频帧缓冲池占用内存的峰值(字节)
+    std::atomic<int64_t> convertedFrames;   // 转换成BGRA的视频帧数
+    std::atomic<int64_t> convertTime;       // 视频格式转换的总时长(微秒)
+    LatencyHistogram presentError;          // 视频帧实际送显时间与预定时间的误差
+    std::atomic<int64_t> repeatedFrames;    // 停留时间超过帧时长1.5倍的视频帧数，即画面重复
+    std::atomic<int64_t> skippedFrames;     // 同步线程因为落后而跳过的视频帧数
+    std::atomic<int64_t> cachedSeeks;       // 在数据包缓存中完成的定位次数
+    std::atomic<int64_t> demuxerSeeks;      // 需要解复用器定位的次数
+    std::atomic<int64_t> indexSeeks;        // 解复用器定位中按关键帧索引以字节定位的次数
+    std::atomic<int64_t> packetCacheBytes;  // 数据包缓存占用的内存大小(字节)
+    std::atomic<int64_t> coalescedSeeks;    // 还没有执行就被新的定位请求替换的次数
+    std::atomic<int64_t> abortedSeeks;      // 执行过程中被新的定位请求中断的次数
+    std::atomic<int> seekPendingSerial;     // 等待输出的定位对应的序列号，-1表示没有
+    std::atomic<int> seekPendingAudio;      // 等待输出的定位是否以音频输出作为完成
+    std::atomic<int64_t> seekPendingTime;   // 等待输出的定位的请求时间
+    LatencyHistogram seekLatency;           // 从请求定位到第一次输出画面或者声音的耗时
+    std::atomic<int64_t> accurateSeeks;     // 完成追赶的精确定位次数
+    std::atomic<int64_t> catchupFrames;     // 精确定位追赶过程中解码后丢弃的帧数
+    LatencyHistogram catchupTime;           // 精确定位从关键帧追赶到目标位置的耗时
+    LatencyHistogram stageLatency[STAGE_COUNT]; // 流水线各个阶段的耗时
+    std::atomic<int64_t> startupBegin;      // 开始准备的时间
+    std::atomic<int64_t> startupTime[STARTUP_PHASE_COUNT]; // 起播各阶段完成的时间，相对开始准备(微秒)
+    PlaybackSnapshotPublisher playback;     // 播放状态快照，各线程更新，任意线程不加锁读取
 };
 
 
@@ -0,0 +1,144 @@
+#include <stdlib.h>
+#include <string.h>
+#include "AudioRingBuffer.h"
+
+AudioRingBuffer::AudioRingBuffer(int capacity)
+{
+    this->capacity = capacity > 0 ? capacity : 1;
+    buffer = (uint8_t *) malloc((size_t) this->capacity);
+    if (buffer)
+    {
+        memset(buffer, 0, (size_t) this->capacity);
+    }
+    readPos = 0;
+    writePos = 0;
+    discardPos = 0;
+}
+
+AudioRingBuffer::~AudioRingBuffer()
+{
+    if (buffer)
+    {
+        free(buffer);
+        buffer = NULL;
+    }
+}
+
+/**
+ * 写入数据
+ * @param data
+ * @param size
+ * @return 实际写入的字节数，缓冲区满时返回0
+ */
+int AudioRingBuffer::write(const uint8_t *data, int size)
+{
+    if (!buffer || size <= 0)
+    {
+        return 0;
+    }
+    int64_t w = writePos.load(std::memory_order_relaxed);
+    // 这里只用消费者的读位置计算空间，丢弃的数据消费者可能还在拷贝，不能覆盖
+    int64_t r = readPos.load(std::memory_order_acquire);
+    int length = (int) (capacity - (w - r));
+    if (length > size)
+    {
+        length = size;
+    }
+    if (length <= 0)
+    {
+        return 0;
+    }
+    int offset = (int) (w % capacity);
+    int first = capacity - offset;
+    if (first > length)
+    {
+        first = length;
+    }
+    memcpy(buffer + offset, data, (size_t) first);
+    if (length > first)
+    {
+        memcpy(buffer, data + first, (size_t) (length - first));
+    }
+    writePos.store(w + length, std::memory_order_release);
+    return length;
+}
+
+/**
+ * 读出数据
+ * @param data
+ * @param size
+ * @return 实际读出的字节数，缓冲区空时返回0
+ */
+int AudioRingBuffer::read(uint8_t *data, int size)
+{
+    if (!buffer || size <= 0)
+    {
+        return 0;
+    }
+    int64_t r = readPos.load(std::memory_order_relaxed);
+    int64_t d = discardPos.load(std::memory_order_acquire);
+    if (d > r)
+    {
+        r = d;
+    }
+    int64_t w = writePos.load(std::memory_order_acquire);
+    int length = (int) (w - r);
+    if (length > size)
+    {
+        length = size;
+    }
+    if (length > 0)
+    {
+        int offset = (int) (r % capacity);
+        int first = capacity - offset;
+        if (first > length)
+        {
+            first = length;
+        }
+        memcpy(data, buffer + offset, (size_t) first);
+        if (length > first)
+        {
+            memcpy(data + first, buffer, (size_t) (length - first));
+        }
+    }
+    else
+    {
+        length = 0;
+    }
+    readPos.store(r + length, std::memory_order_release);
+    return length;
+}
+
+void AudioRingBuffer::discard()
+{
+    discardPos.store(writePos.load(std::memory_order_relaxed), std::memory_order_release);
+}
+
+int AudioRingBuffer::getSize()
+{
+    int64_t r = readPos.load(std::memory_order_acquire);
+    int64_t d = discardPos.load(std::memory_order_acquire);
+    int64_t w = writePos.load(std::memory_order_acquire);
+    return (int) (w - (d > r ? d : r));
+}
+
+int AudioRingBuffer::getFreeSize()
+{
+    return (int) (capacity - (writePos.load(std::memory_order_acquire)
+                              - readPos.load(std::memory_order_acquire)));
+}
+
+int AudioRingBuffer::getCapacity() const
+{
+    return capacity;
+}
+
+int64_t AudioRingBuffer::getReadPosition()
+{
+    return readPos.load(std::memory_order_acquire);
+}
+
+int64_t AudioRingBuffer::getWritePosition()
+{
+    return writePos.load(std::memory_order_acquire);
+}
@@ -0,0 +1,51 @@
+#ifndef AUDIORINGBUFFER_H
+#define AUDIORINGBUFFER_H
+
+#include <atomic>
+#include <stdint.h>
+
+/**
+ * 音频PCM环形缓冲区，单生产者单消费者，读写都不加锁
+ * 生产者是音频解码重采样线程，消费者是音频设备的回调，回调里面只做拷贝，不会被解码阻塞
+ * 读写位置都是累计的字节数，不回绕，用于计算缓冲的数据量以及音频时钟
+ */
+class AudioRingBuffer
+{
+public:
+    AudioRingBuffer(int capacity);
+
+    virtual ~AudioRingBuffer();
+
+    // 写入数据，只能在生产者线程调用，返回实际写入的字节数
+    int write(const uint8_t *data, int size);
+
+    // 读出数据，只能在消费者线程调用，返回实际读出的字节数
+    int read(uint8_t *data, int size);
+
+    // 丢弃已写入的数据，只能在生产者线程调用，消费者下一次读取时生效
+    void discard();
+
+    // 获取缓冲的数据大小，已丢弃的数据不计算在内
+    int getSize();
+
+    // 获取可写入的空间大小
+    int getFreeSize();
+
+    int getCapacity() const;
+
+    // 获取累计读出的位置
+    int64_t getReadPosition();
+
+    // 获取累计写入的位置
+    int64_t getWritePosition();
+
+private:
+    uint8_t *buffer;                    // 缓冲区
+    int capacity;                       // 缓冲区容量
+    std::atomic<int64_t> readPos;       // 读位置，消费者更新
+    std::atomic<int64_t> writePos;      // 写位置，生产者更新
+    std::atomic<int64_t> discardPos;    // 丢弃位置，生产者更新，消费者读取时跳过之前的数据
+};
+
+
+#endif //AUDIORINGBUFFER_H
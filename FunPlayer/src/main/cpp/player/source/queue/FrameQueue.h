@@ -1,6 +1,7 @@
 #ifndef MEDIAPLAYER_FRAMEQUEUE_H
 #define MEDIAPLAYER_FRAMEQUEUE_H
 
+#include <atomic>
 #include <Mutex.h>
 #include <Condition.h>
 
@@ -8,25 +9,30 @@ extern "C" {
 #include <libavcodec/avcodec.h>
 };
 
-#define FRAME_QUEUE_SIZE 10
-
 typedef struct Frame
 {
     AVFrame *frame;
-    AVSubtitle sub;
     double pts;           /* presentation timestamp for the frame */
     double duration;      /* estimated duration of the frame */
+    int serial;           /* serial of the packet queue when the frame was decoded */
     int width;
     int height;
     int format;
     int uploaded;
 } Frame;
 
+/**
+ * 帧队列，单生产者单消费者，解码线程是唯一的生产者，同步线程是唯一的消费者
+ * 读写位置分别只由消费者和生产者修改，帧数量用acquire/release原子操作在两个线程间传递帧数据
+ * 只有队列满时生产者才需要加锁等待，只有消费者在等待新的帧时入队才需要通知
+ * @tparam Capacity 队列容量，编译期确定
+ */
+template<int Capacity>
 class FrameQueue
 {
 
 public:
-    FrameQueue(int max_size, int keep_last);
+    FrameQueue(int keep_last);
 
     virtual ~FrameQueue();
 
@@ -34,39 +40,217 @@ public:
 
     void abort();
 
+    // 当前帧，只能在消费者线程调用
     Frame *currentFrame();
 
+    // 下一帧，只能在消费者线程调用
     Frame *nextFrame();
 
+    // 上一次显示的帧，只能在消费者线程调用
     Frame *lastFrame();
 
+    // 获取可写入的帧，队列满时等待，只能在生产者线程调用
     Frame *peekWritable();
 
+    // 入队帧，只能在生产者线程调用
     void pushFrame();
 
+    // 出队帧，只能在消费者线程调用
     void popFrame();
 
+    // 清空所有帧，只能在消费者线程或者两个线程都停止之后调用
     void flush();
 
     int getFrameSize();
 
     int getShowIndex() const;
 
-private:
-    void unrefFrame(Frame *vp);
+    // 设置入队通知，消费者在队列为空时用这个条件变量等待
+    void setPushNotify(Mutex *mutex, Condition *condition);
+
+    // 标记消费者是否在等待新的帧，返回当前可读的帧数，需要在通知的互斥锁内调用
+    int setConsumerWaiting(int waiting);
 
 private:
     Mutex mMutex;
     Condition mCondition;
-    int abort_request;
-    Frame queue[FRAME_QUEUE_SIZE];
-    int rindex;
-    int windex;
-    int size;
-    int max_size;
+    std::atomic<int> abort_request;
+    std::atomic<int> waiting;       // 生产者是否在等待空位
+    std::atomic<int> consumerWaiting;   // 消费者是否在等待新的帧
+    Mutex *notifyMutex;             // 入队通知的互斥锁
+    Condition *notifyCondition;     // 入队通知的条件变量
+    Frame queue[Capacity];
+    int rindex;                     // 读位置，消费者使用
+    int windex;                     // 写位置，生产者使用
+    std::atomic<int> size;          // 帧数量
     int keep_last;
-    int show_index;
+    std::atomic<int> show_index;
 };
 
+template<int Capacity>
+FrameQueue<Capacity>::FrameQueue(int keep_last)
+{
+    memset(queue, 0, sizeof(Frame) * Capacity);
+    this->keep_last = (keep_last != 0);
+    for (int i = 0; i < Capacity; ++i)
+    {
+        queue[i].frame = av_frame_alloc();
+    }
+    abort_request = 1;
+    waiting = 0;
+    consumerWaiting = 0;
+    notifyMutex = NULL;
+    notifyCondition = NULL;
+    rindex = 0;
+    windex = 0;
+    size = 0;
+    show_index = 0;
+}
+
+template<int Capacity>
+FrameQueue<Capacity>::~FrameQueue()
+{
+    for (int i = 0; i < Capacity; ++i)
+    {
+        Frame *vp = &queue[i];
+        av_frame_unref(vp->frame);
+        av_frame_free(&vp->frame);
+    }
+}
+
+template<int Capacity>
+void FrameQueue<Capacity>::start()
+{
+    mMutex.lock();
+    abort_request = 0;
+    mCondition.signal();
+    mMutex.unlock();
+}
+
+template<int Capacity>
+void FrameQueue<Capacity>::abort()
+{
+    mMutex.lock();
+    abort_request = 1;
+    mCondition.signal();
+    mMutex.unlock();
+}
+
+template<int Capacity>
+Frame *FrameQueue<Capacity>::currentFrame()
+{
+    return &queue[(rindex + show_index.load(std::memory_order_relaxed)) % Capacity];
+}
+
+template<int Capacity>
+Frame *FrameQueue<Capacity>::nextFrame()
+{
+    return &queue[(rindex + show_index.load(std::memory_order_relaxed) + 1) % Capacity];
+}
+
+template<int Capacity>
+Frame *FrameQueue<Capacity>::lastFrame()
+{
+    return &queue[rindex];
+}
+
+template<int Capacity>
+Frame *FrameQueue<Capacity>::peekWritable()
+{
+    if (size.load(std::memory_order_acquire) >= Capacity && !abort_request)
+    {
+        mMutex.lock();
+        waiting.store(1, std::memory_order_seq_cst);
+        while (size.load(std::memory_order_seq_cst) >= Capacity && !abort_request)
+        {
+            mCondition.wait(mMutex);
+        }
+        waiting.store(0, std::memory_order_relaxed);
+        mMutex.unlock();
+    }
+
+    if (abort_request)
+    {
+        return NULL;
+    }
+
+    return &queue[windex];
+}
+
+template<int Capacity>
+void FrameQueue<Capacity>::pushFrame()
+{
+    if (++windex == Capacity)
+    {
+        windex = 0;
+    }
+    size.fetch_add(1, std::memory_order_seq_cst);
+    // 消费者在等待新的帧时才需要唤醒
+    if (consumerWaiting.load(std::memory_order_seq_cst) && notifyMutex != NULL)
+    {
+        notifyMutex->lock();
+        notifyCondition->signal();
+        notifyMutex->unlock();
+    }
+}
+
+template<int Capacity>
+void FrameQueue<Capacity>::popFrame()
+{
+    if (keep_last && !show_index.load(std::memory_order_relaxed))
+    {
+        show_index.store(1, std::memory_order_release);
+        return;
+    }
+    av_frame_unref(queue[rindex].frame);
+    if (++rindex == Capacity)
+    {
+        rindex = 0;
+    }
+    size.fetch_sub(1, std::memory_order_seq_cst);
+    // 生产者在等待空位时才需要唤醒
+    if (waiting.load(std::memory_order_seq_cst))
+    {
+        mMutex.lock();
+        mCondition.signal();
+        mMutex.unlock();
+    }
+}
+
+template<int Capacity>
+void FrameQueue<Capacity>::flush()
+{
+    while (getFrameSize() > 0)
+    {
+        popFrame();
+    }
+}
+
+template<int Capacity>
+int FrameQueue<Capacity>::getFrameSize()
+{
+    return size.load(std::memory_order_acquire) - show_index.load(std::memory_order_acquire);
+}
+
+template<int Capacity>
+int FrameQueue<Capacity>::getShowIndex() const
+{
+    return show_index.load(std::memory_order_acquire);
+}
+
+template<int Capacity>
+void FrameQueue<Capacity>::setPushNotify(Mutex *mutex, Condition *condition)
+{
+    notifyMutex = mutex;
+    notifyCondition = condition;
+}
+
+template<int Capacity>
+int FrameQueue<Capacity>::setConsumerWaiting(int waiting)
+{
+    consumerWaiting.store(waiting, std::memory_order_seq_cst);
+    return size.load(std::memory_order_seq_cst) - show_index.load(std::memory_order_acquire);
+}
+
 
 #endif //MEDIAPLAYER_FRAMEQUEUE_H
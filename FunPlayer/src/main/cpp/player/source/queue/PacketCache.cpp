@@ -0,0 +1,227 @@
+#include "PacketCache.h"
+
+PacketCache::PacketCache()
+{
+    size = 0;
+    backTime = 0;
+    maxSize = 0;
+    anchorStream = -1;
+    replayIndex = 0;
+    keyIndex = 0;
+    keyTime = NAN;
+}
+
+PacketCache::~PacketCache()
+{
+    clear();
+}
+
+void PacketCache::setWindow(double backTime, int64_t maxSize)
+{
+    this->backTime = backTime;
+    this->maxSize = maxSize;
+    if (!isEnabled())
+    {
+        clear();
+    }
+}
+
+int PacketCache::isEnabled()
+{
+    return backTime > 0 && maxSize > 0;
+}
+
+void PacketCache::setAnchorStream(int streamIndex)
+{
+    anchorStream = streamIndex;
+}
+
+/**
+ * 缓存数据包，没有时间戳的数据包沿用前一个数据包的时间
+ * @param pkt
+ * @param time
+ * @return
+ */
+int PacketCache::addPacket(AVPacket *pkt, double time)
+{
+    if (!isEnabled())
+    {
+        return 0;
+    }
+    if (isnan(time))
+    {
+        // 缓存开头没有时间戳的数据包在任何关键帧之前，不会被重新送入解码器，不需要缓存
+        if (entries.empty())
+        {
+            return 0;
+        }
+        time = entries.back().time;
+    }
+    entries.push_back(PacketCacheEntry());
+    PacketCacheEntry *entry = &entries.back();
+    av_init_packet(&entry->pkt);
+    int ret = av_packet_ref(&entry->pkt, pkt);
+    if (ret < 0)
+    {
+        entries.pop_back();
+        return ret;
+    }
+    entry->time = time;
+    size += entry->pkt.size;
+    return 0;
+}
+
+/**
+ * 丢弃播放位置之前的数据包
+ * @param position 当前播放位置(秒)
+ */
+void PacketCache::trim(double position)
+{
+    if (isnan(position))
+    {
+        return;
+    }
+    while (!entries.empty() && entries.front().time < position
+           && (entries.front().time < position - backTime || size > maxSize))
+    {
+        popFront();
+    }
+}
+
+void PacketCache::popFront()
+{
+    size -= entries.front().pkt.size;
+    av_packet_unref(&entries.front().pkt);
+    entries.pop_front();
+    // 丢弃的数据包在重新送入的范围内时，同步调整下标
+    if (replayIndex > 0)
+    {
+        replayIndex--;
+    }
+    if (keyIndex > 0)
+    {
+        keyIndex--;
+    }
+}
+
+void PacketCache::clear()
+{
+    while (!entries.empty())
+    {
+        popFront();
+    }
+    size = 0;
+    replayIndex = 0;
+    keyIndex = 0;
+    keyTime = NAN;
+}
+
+/**
+ * 查找目标之前最近的关键帧，目标需要在关键帧媒体流已缓存的范围内
+ * 其他媒体流与关键帧交错存放，从关键帧之前不早于关键帧时间的数据包开始重新送入
+ * @param target
+ * @return
+ */
+int PacketCache::seek(double target)
+{
+    replayIndex = entries.size();
+    if (!isEnabled() || anchorStream < 0 || isnan(target))
+    {
+        return -1;
+    }
+
+    // 目标超出了已读取的范围
+    double endTime = NAN;
+    int64_t key = -1;
+    for (int64_t i = (int64_t) entries.size() - 1; i >= 0; --i)
+    {
+        const PacketCacheEntry *entry = &entries[i];
+        if (entry->pkt.stream_index != anchorStream)
+        {
+            continue;
+        }
+        if (isnan(endTime))
+        {
+            endTime = entry->time;
+            if (target > endTime)
+            {
+                return -1;
+            }
+        }
+        if ((entry->pkt.flags & AV_PKT_FLAG_KEY) && entry->time <= target)
+        {
+            key = i;
+            break;
+        }
+    }
+    if (key < 0)
+    {
+        return -1;
+    }
+
+    keyIndex = (size_t) key;
+    keyTime = entries[keyIndex].time;
+    replayIndex = keyIndex;
+    for (int64_t i = key - 1; i >= 0; --i)
+    {
+        const PacketCacheEntry *entry = &entries[i];
+        if (entry->time < keyTime - PACKET_CACHE_MAX_INTERLEAVE)
+        {
+            break;
+        }
+        if (entry->pkt.stream_index != anchorStream && entry->time >= keyTime)
+        {
+            replayIndex = (size_t) i;
+        }
+    }
+    return 0;
+}
+
+int PacketCache::nextPacket(AVPacket *pkt)
+{
+    while (replayIndex < entries.size())
+    {
+        const PacketCacheEntry *entry = &entries[replayIndex++];
+        // 关键帧之前只送入其他媒体流不早于关键帧的数据包
+        if (replayIndex - 1 < keyIndex
+            && (entry->pkt.stream_index == anchorStream || entry->time < keyTime))
+        {
+            continue;
+        }
+        if (av_packet_ref(pkt, &entry->pkt) < 0)
+        {
+            continue;
+        }
+        return 1;
+    }
+    return 0;
+}
+
+int PacketCache::getKeyPacket(AVPacket *pkt)
+{
+    if (keyIndex >= entries.size() || isnan(keyTime))
+    {
+        return -1;
+    }
+    return av_packet_ref(pkt, &entries[keyIndex].pkt);
+}
+
+double PacketCache::getStartTime()
+{
+    return entries.empty() ? NAN : entries.front().time;
+}
+
+double PacketCache::getEndTime()
+{
+    return entries.empty() ? NAN : entries.back().time;
+}
+
+int PacketCache::getPacketCount()
+{
+    return (int) entries.size();
+}
+
+int64_t PacketCache::getSize()
+{
+    return size;
+}
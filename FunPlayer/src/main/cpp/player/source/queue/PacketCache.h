@@ -0,0 +1,104 @@
+#ifndef PACKETCACHE_H
+#define PACKETCACHE_H
+
+#include <deque>
+#include <math.h>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+};
+
+// 音视频交错的最大时间差(秒)，定位时在关键帧之前这个范围内查找其他媒体流的数据包
+#define PACKET_CACHE_MAX_INTERLEAVE 1.0
+
+/**
+ * 缓存的数据包
+ */
+typedef struct PacketCacheEntry
+{
+    AVPacket pkt;
+    double time;        // 数据包的时间(秒)，没有时间戳时为NAN
+} PacketCacheEntry;
+
+/**
+ * 解复用数据包缓存，按读出的顺序保存读包线程送入解码器的数据包的引用
+ * 既包括解码器队列中还没有消耗的数据包，也包括播放位置之前一段时长内已经消耗的数据包
+ * 数据包的数据与解码器队列中的数据包共享，只有已经消耗的部分额外占用内存
+ * 定位目标在缓存范围内时，从目标之前最近的关键帧开始把缓存的数据包重新送入解码器，不需要重新解复用
+ * 只在读包线程中使用，不加锁
+ */
+class PacketCache
+{
+public:
+    PacketCache();
+
+    virtual ~PacketCache();
+
+    // 设置播放位置之前保留的时长(秒)和缓存占用内存的上限(字节)，时长为0表示不缓存
+    // 超过内存上限时只丢弃播放位置之前的数据包，解码器队列中的数据包总是保留
+    void setWindow(double backTime, int64_t maxSize);
+
+    // 是否开启缓存
+    int isEnabled();
+
+    // 设置用于查找关键帧的媒体流，有视频流时为视频流，否则为音频流
+    void setAnchorStream(int streamIndex);
+
+    // 缓存数据包，time为数据包的时间(秒)
+    int addPacket(AVPacket *pkt, double time);
+
+    // 丢弃播放位置之前超出保留时长或者内存上限的数据包
+    void trim(double position);
+
+    // 清空缓存，解复用器定位之后缓存的数据包与之后读出的数据包不再连续
+    void clear();
+
+    /**
+     * 在缓存中定位，成功之后通过nextPacket依次取出需要重新送入解码器的数据包
+     * @param target 定位目标(秒)
+     * @return 0表示目标在缓存范围内，小于0表示需要解复用器定位
+     */
+    int seek(double target);
+
+    /**
+     * 取出定位之后需要重新送入解码器的数据包的引用
+     * @param pkt
+     * @return 1表示取出了数据包，0表示已经全部取出
+     */
+    int nextPacket(AVPacket *pkt);
+
+    /**
+     * 取出定位找到的关键帧数据包的引用，拖动预览时只需要解码关键帧
+     * @param pkt
+     * @return 0表示成功，小于0表示没有定位或者失败
+     */
+    int getKeyPacket(AVPacket *pkt);
+
+    // 缓存的起始时间(秒)，没有缓存时为NAN
+    double getStartTime();
+
+    // 缓存的结束时间(秒)，没有缓存时为NAN
+    double getEndTime();
+
+    // 缓存的数据包数量
+    int getPacketCount();
+
+    // 缓存的数据包占用的内存大小
+    int64_t getSize();
+
+private:
+    // 丢弃最早的数据包
+    void popFront();
+
+private:
+    std::deque<PacketCacheEntry> entries;
+    int64_t size;               // 缓存数据包的总大小
+    double backTime;            // 播放位置之前保留的时长
+    int64_t maxSize;            // 缓存占用内存的上限
+    int anchorStream;           // 查找关键帧的媒体流
+    size_t replayIndex;         // 定位之后下一个需要重新送入解码器的数据包
+    size_t keyIndex;            // 定位找到的关键帧
+    double keyTime;             // 定位找到的关键帧时间，其他媒体流在此之前的数据包不重新送入
+};
+
+#endif //PACKETCACHE_H
@@ -2,18 +2,63 @@
 
 PacketQueue::PacketQueue()
 {
+    // 哑节点，队列为空时head和tail都指向它
+    PacketList *node = new PacketList();
+    node->next = NULL;
+    tail = node;
+    head = node;
+    first = node;
+    tailCopy = node;
+    nodeCount = 1;
+    waiting = 0;
+    pushCount = 0;
+    pushSize = 0;
+    pushDuration = 0;
+    popCount = 0;
+    popSize = 0;
+    popDuration = 0;
+    flushCount = 0;
+    flushSize = 0;
+    flushDuration = 0;
     abort_request = 0;
-    first_pkt = NULL;
-    last_pkt = NULL;
-    nb_packets = 0;
-    size = 0;
-    duration = 0;
+    serial = 0;
+    lowWatermarkPackets = 0;
+    lowWatermarkDuration = 0;
+    waterMarkMutex = NULL;
+    waterMarkCondition = NULL;
+    memorySize = NULL;
+    memoryWatermark = 0;
 }
 
 PacketQueue::~PacketQueue()
 {
     abort();
-    flush();
+    release();
+}
+
+/**
+ * 分配节点，优先复用消费者已经取出的节点
+ * @return
+ */
+PacketList *PacketQueue::allocNode()
+{
+    PacketList *node;
+    if (first != tailCopy)
+    {
+        node = first;
+        first = first->next.load(std::memory_order_relaxed);
+        return node;
+    }
+    tailCopy = tail.load(std::memory_order_acquire);
+    if (first != tailCopy)
+    {
+        node = first;
+        first = first->next.load(std::memory_order_relaxed);
+        return node;
+    }
+    node = new PacketList();
+    nodeCount++;
+    return node;
 }
 
 /**
@@ -30,26 +75,29 @@ int PacketQueue::put(AVPacket *pkt)
         return -1;
     }
 
-    pkt1 = (PacketList *) av_malloc(sizeof(PacketList));
+    pkt1 = allocNode();
     if (!pkt1)
     {
         return -1;
     }
     pkt1->pkt = *pkt;
-    pkt1->next = NULL;
+    pkt1->next.store(NULL, std::memory_order_relaxed);
+    pkt1->serial = serial;
+    pkt1->index = pushCount.load(std::memory_order_relaxed);
+    int64_t pktSize = pkt1->pkt.size + sizeof(*pkt1);
 
-    if (!last_pkt)
+    // 先更新统计再发布节点，保证出队统计不会超过入队统计
+    if (memorySize)
     {
-        first_pkt = pkt1;
+        memorySize->fetch_add(pktSize);
     }
-    else
-    {
-        last_pkt->next = pkt1;
-    }
-    last_pkt = pkt1;
-    nb_packets++;
-    size += pkt1->pkt.size + sizeof(*pkt1);
-    duration += pkt1->pkt.duration;
+    pushSize.store(pushSize.load(std::memory_order_relaxed) + pktSize, std::memory_order_release);
+    pushDuration.store(pushDuration.load(std::memory_order_relaxed) + pkt1->pkt.duration,
+                       std::memory_order_release);
+    pushCount.store(pkt1->index + 1, std::memory_order_release);
+
+    head->next.store(pkt1, std::memory_order_seq_cst);
+    head = pkt1;
     return 0;
 }
 
@@ -60,11 +108,15 @@ int PacketQueue::put(AVPacket *pkt)
  */
 int PacketQueue::pushPacket(AVPacket *pkt)
 {
-    int ret;
-    mMutex.lock();
-    ret = put(pkt);
-    mCondition.signal();
-    mMutex.unlock();
+    int ret = put(pkt);
+
+    // 消费者在等待时才需要唤醒
+    if (waiting.load(std::memory_order_seq_cst))
+    {
+        mMutex.lock();
+        mCondition.signal();
+        mMutex.unlock();
+    }
 
     if (ret < 0)
     {
@@ -85,26 +137,21 @@ int PacketQueue::pushNullPacket(int stream_index)
 }
 
 /**
- * 刷新数据包
+ * 刷新数据包，递增序列号，解码器和同步器根据序列号丢弃刷新之前的数据
+ * 生产者不能操作消费者一侧的节点，这里只记录刷新的位置，刷新之前的数据包由消费者出队时直接释放
  */
 void PacketQueue::flush()
 {
-    PacketList *pkt, *pkt1;
+    flushSize.store(pushSize.load(std::memory_order_relaxed), std::memory_order_release);
+    flushDuration.store(pushDuration.load(std::memory_order_relaxed), std::memory_order_release);
+    flushCount.store(pushCount.load(std::memory_order_relaxed), std::memory_order_release);
+    serial++;
 
     mMutex.lock();
-    for (pkt = first_pkt; pkt; pkt = pkt1)
-    {
-        pkt1 = pkt->next;
-        av_packet_unref(&pkt->pkt);
-        av_freep(&pkt);
-    }
-    last_pkt = NULL;
-    first_pkt = NULL;
-    nb_packets = 0;
-    size = 0;
-    duration = 0;
     mCondition.signal();
     mMutex.unlock();
+
+    notifyLowWatermark();
 }
 
 /**
@@ -147,10 +194,20 @@ int PacketQueue::getPacket(AVPacket *pkt)
  */
 int PacketQueue::getPacket(AVPacket *pkt, int block)
 {
-    PacketList *pkt1;
+    return getPacket(pkt, block, NULL);
+}
+
+/**
+ * 取出数据包
+ * @param pkt
+ * @param block
+ * @param serial 数据包的序列号，可以为NULL
+ * @return
+ */
+int PacketQueue::getPacket(AVPacket *pkt, int block, int *serial)
+{
     int ret;
 
-    mMutex.lock();
     for (;;)
     {
         if (abort_request)
@@ -159,53 +216,213 @@ int PacketQueue::getPacket(AVPacket *pkt, int block)
             break;
         }
 
-        pkt1 = first_pkt;
-        if (pkt1)
+        int notify = !belowLowWatermark(getPacketSize(), getDuration());
+        ret = take(pkt, serial);
+        if (ret > 0)
         {
-            first_pkt = pkt1->next;
-            if (!first_pkt)
+            // 刚好跨过低水位时才唤醒，避免每次取包都去竞争读包线程的锁
+            if (notify && belowLowWatermark(getPacketSize(), getDuration()))
             {
-                last_pkt = NULL;
+                notifyLowWatermark();
             }
-            nb_packets--;
-            size -= pkt1->pkt.size + sizeof(*pkt1);
-            duration -= pkt1->pkt.duration;
-            *pkt = pkt1->pkt;
-            av_free(pkt1);
-            ret = 1;
             break;
         }
+        else if (ret < 0)
+        {
+            // 刷新之前的数据包，继续取下一个
+            continue;
+        }
         else if (!block)
         {
             ret = 0;
             break;
         }
-        else
+
+        // 队列为空，等待生产者唤醒
+        mMutex.lock();
+        waiting.store(1, std::memory_order_seq_cst);
+        if (!abort_request
+            && !tail.load(std::memory_order_relaxed)->next.load(std::memory_order_seq_cst))
         {
             mCondition.wait(mMutex);
         }
+        waiting.store(0, std::memory_order_relaxed);
+        mMutex.unlock();
     }
-    mMutex.unlock();
     return ret;
 }
 
+/**
+ * 消费者取出一个节点
+ * @param pkt
+ * @param serial
+ * @return 1表示取出数据包，0表示队列为空，-1表示取出的是已经刷新的数据包并且已经释放
+ */
+int PacketQueue::take(AVPacket *pkt, int *serial)
+{
+    PacketList *dummy = tail.load(std::memory_order_relaxed);
+    PacketList *node = dummy->next.load(std::memory_order_acquire);
+    if (!node)
+    {
+        return 0;
+    }
+    int64_t index = node->index;
+    int64_t pktSize = node->pkt.size + sizeof(*node);
+    int64_t pktDuration = node->pkt.duration;
+    int stale = index < flushCount.load(std::memory_order_acquire);
+    if (stale)
+    {
+        av_packet_unref(&node->pkt);
+    }
+    else
+    {
+        *pkt = node->pkt;
+        if (serial)
+        {
+            *serial = node->serial;
+        }
+    }
+    // 取出的节点成为新的哑节点，之前的哑节点交给生产者回收
+    tail.store(node, std::memory_order_release);
+
+    popSize.store(popSize.load(std::memory_order_relaxed) + pktSize, std::memory_order_release);
+    popDuration.store(popDuration.load(std::memory_order_relaxed) + pktDuration,
+                      std::memory_order_release);
+    popCount.store(index + 1, std::memory_order_release);
+
+    // 共享内存占用刚好降到低水位时唤醒，多个消费者同时取包时只有一个会看到跨过低水位
+    if (memorySize)
+    {
+        int64_t previous = memorySize->fetch_sub(pktSize);
+        if (previous > memoryWatermark && previous - pktSize <= memoryWatermark)
+        {
+            notifyLowWatermark();
+        }
+    }
+    return stale ? -1 : 1;
+}
+
+/**
+ * 释放所有节点，只在析构时调用
+ */
+void PacketQueue::release()
+{
+    PacketList *node = tail.load(std::memory_order_acquire)->next;
+    while (node)
+    {
+        if (memorySize)
+        {
+            memorySize->fetch_sub(node->pkt.size + sizeof(*node));
+        }
+        av_packet_unref(&node->pkt);
+        node = node->next;
+    }
+    node = first;
+    while (node)
+    {
+        PacketList *next = node->next;
+        delete node;
+        node = next;
+    }
+    first = NULL;
+    head = NULL;
+    tail = NULL;
+    tailCopy = NULL;
+    nodeCount = 0;
+}
+
+int PacketQueue::getSerial()
+{
+    return serial;
+}
+
 int PacketQueue::getPacketSize()
 {
-    Mutex::Autolock lock(mMutex);
-    return nb_packets;
+    int64_t popped = popCount.load(std::memory_order_acquire);
+    int64_t flushed = flushCount.load(std::memory_order_acquire);
+    return (int) (pushCount.load(std::memory_order_acquire) - FFMAX(popped, flushed));
 }
 
 int PacketQueue::getSize()
 {
-    return size;
+    int64_t consumed = popCount.load(std::memory_order_acquire)
+                       >= flushCount.load(std::memory_order_acquire)
+                       ? popSize.load(std::memory_order_acquire)
+                       : flushSize.load(std::memory_order_acquire);
+    return (int) (pushSize.load(std::memory_order_acquire) - consumed);
 }
 
 int64_t PacketQueue::getDuration()
 {
-    return duration;
+    int64_t consumed = popCount.load(std::memory_order_acquire)
+                       >= flushCount.load(std::memory_order_acquire)
+                       ? popDuration.load(std::memory_order_acquire)
+                       : flushDuration.load(std::memory_order_acquire);
+    return pushDuration.load(std::memory_order_acquire) - consumed;
 }
 
 int PacketQueue::isAbort()
 {
     return abort_request;
 }
+
+int PacketQueue::getNodeCount()
+{
+    return nodeCount;
+}
+
+/**
+ * 设置低水位
+ * @param packets   数据包数量低于等于该值时处于低水位
+ * @param duration  数据包时长(stream time_base)低于等于该值时处于低水位，0表示不判断时长
+ * @param mutex     唤醒时使用的互斥锁，等待方需要持有该锁判断条件，避免丢失唤醒
+ * @param condition 唤醒时使用的条件变量
+ */
+void PacketQueue::setLowWatermark(int packets, int64_t duration, Mutex *mutex,
+                                  Condition *condition)
+{
+    Mutex::Autolock lock(mMutex);
+    lowWatermarkPackets = packets;
+    lowWatermarkDuration = duration;
+    waterMarkMutex = mutex;
+    waterMarkCondition = condition;
+}
+
+/**
+ * 设置共享的内存低水位
+ * @param memorySize    多个队列共享的内存占用计数，入队时增加，取出时减少
+ * @param size          计数从高于该值降到该值以下时唤醒低水位的等待方
+ */
+void PacketQueue::setMemoryWatermark(std::atomic<int64_t> *memorySize, int64_t size)
+{
+    Mutex::Autolock lock(mMutex);
+    this->memorySize = memorySize;
+    memoryWatermark = size;
+}
+
+int PacketQueue::isLowWatermark()
+{
+    return belowLowWatermark(getPacketSize(), getDuration());
+}
+
+/**
+ * 判断是否处于低水位以下
+ */
+int PacketQueue::belowLowWatermark(int64_t packets, int64_t duration)
+{
+    return packets <= lowWatermarkPackets
+           || (lowWatermarkDuration > 0 && duration > 0 && duration <= lowWatermarkDuration);
+}
+
+/**
+ * 唤醒等待低水位的线程
+ */
+void PacketQueue::notifyLowWatermark()
+{
+    if (waterMarkMutex && waterMarkCondition)
+    {
+        waterMarkMutex->lock();
+        waterMarkCondition->broadcast();
+        waterMarkMutex->unlock();
+    }
+}
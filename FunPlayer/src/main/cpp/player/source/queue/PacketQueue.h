@@ -2,6 +2,7 @@
 #define PACKETQUEUE_H
 
 #include <queue>
+#include <atomic>
 #include <Mutex.h>
 #include <Condition.h>
 
@@ -12,10 +13,15 @@ extern "C" {
 typedef struct PacketList
 {
     AVPacket pkt;
-    struct PacketList *next;
+    std::atomic<struct PacketList *> next;
+    int serial;
+    int64_t index;      // 数据包入队的序号，用于判断是否已经被刷新
 } PacketList;
 
 /**
+ * 数据包队列，单生产者单消费者，读包线程是唯一的生产者，解码线程是唯一的消费者
+ * 入队和出队不加锁，节点用完之后由生产者回收复用，稳定运行时不再分配内存
+ * 只有消费者需要阻塞等待时才会用到互斥锁和条件变量
  * 备注：这里不用std::queue是为了方便计算队列占用内存和队列的时长，在解码的时候要用到
  */
 class PacketQueue
@@ -25,13 +31,13 @@ public:
 
     virtual ~PacketQueue();
 
-    // 入队数据包
+    // 入队数据包，只能在生产者线程调用
     int pushPacket(AVPacket *pkt);
 
-    // 入队空数据包
+    // 入队空数据包，只能在生产者线程调用
     int pushNullPacket(int stream_index);
 
-    // 刷新
+    // 刷新，序列号递增，只能在生产者线程调用，队列中的数据包由消费者在出队时释放
     void flush();
 
     // 终止
@@ -40,12 +46,18 @@ public:
     // 开始
     void start();
 
-    // 获取数据包
+    // 获取数据包，只能在消费者线程调用
     int getPacket(AVPacket *pkt);
 
-    // 获取数据包
+    // 获取数据包，只能在消费者线程调用
     int getPacket(AVPacket *pkt, int block);
 
+    // 获取数据包以及数据包的序列号，只能在消费者线程调用
+    int getPacket(AVPacket *pkt, int block, int *serial);
+
+    // 获取队列当前的序列号，不加锁
+    int getSerial();
+
     int getPacketSize();
 
     int getSize();
@@ -54,17 +66,69 @@ public:
 
     int isAbort();
 
+    // 设置低水位，数据包被消耗到低水位以下时唤醒等待在condition上的读包线程
+    void setLowWatermark(int packets, int64_t duration, Mutex *mutex, Condition *condition);
+
+    // 设置多个队列共享的内存低水位，所有队列占用的内存降到低水位以下时同样唤醒读包线程
+    void setMemoryWatermark(std::atomic<int64_t> *memorySize, int64_t size);
+
+    // 是否处于低水位以下
+    int isLowWatermark();
+
+    // 获取已经分配的节点数量
+    int getNodeCount();
+
 private:
+    PacketList *allocNode();
+
     int put(AVPacket *pkt);
 
+    // 消费者取出一个节点，队列为空时返回0
+    int take(AVPacket *pkt, int *serial);
+
+    // 释放所有节点
+    void release();
+
+    int belowLowWatermark(int64_t packets, int64_t duration);
+
+    void notifyLowWatermark();
+
 private:
     Mutex mMutex;
     Condition mCondition;
-    PacketList *first_pkt, *last_pkt;
-    int nb_packets;
-    int size;
-    int64_t duration;
-    int abort_request;
+    std::atomic<int> waiting;       // 消费者是否在等待数据包
+
+    // 消费者使用
+    std::atomic<PacketList *> tail; // 哑节点，tail->next是队头的数据包
+
+    // 生产者使用
+    PacketList *head;               // 队尾的数据包
+    PacketList *first;              // 可回收节点的起点，first到tail之间的节点已经被消费者取出
+    PacketList *tailCopy;           // tail的缓存，减少对tail的读取
+    int nodeCount;                  // 已分配的节点数量
+
+    // 入队统计，生产者更新
+    std::atomic<int64_t> pushCount;
+    std::atomic<int64_t> pushSize;
+    std::atomic<int64_t> pushDuration;
+    // 出队统计，消费者更新
+    std::atomic<int64_t> popCount;
+    std::atomic<int64_t> popSize;
+    std::atomic<int64_t> popDuration;
+    // 刷新时的入队统计，序号小于flushCount的数据包都已被刷新
+    std::atomic<int64_t> flushCount;
+    std::atomic<int64_t> flushSize;
+    std::atomic<int64_t> flushDuration;
+
+    std::atomic<int> abort_request;
+    std::atomic<int> serial;        // 序列号，每次刷新都递增，用于丢弃刷新之前的数据包和帧
+
+    int lowWatermarkPackets;        // 低水位数据包数量
+    int64_t lowWatermarkDuration;   // 低水位时长
+    Mutex *waterMarkMutex;          // 低水位唤醒互斥锁
+    Condition *waterMarkCondition;  // 低水位唤醒条件变量
+    std::atomic<int64_t> *memorySize;   // 多个队列共享的节点内存占用，包括已经刷新还没有取出的数据包
+    int64_t memoryWatermark;        // 共享内存占用的低水位
 };
 
 
@@ -13,29 +13,32 @@ MediaClock::~MediaClock()
 
 void MediaClock::init()
 {
-    speed = 1.0;
-    paused = 0;
-    setClock(NAN);
+    double time = av_gettime_relative() / 1000000.0;
+    state.write([time](ClockSnapshot &clock)
+                {
+                    clock.speed = 1.0;
+                    clock.paused = 0;
+                    clock.pts = NAN;
+                    clock.last_updated = time;
+                    clock.pts_drift = NAN;
+                });
 }
 
 double MediaClock::getClock()
 {
-    if (paused)
-    {
-        return pts;
-    }
-    else
-    {
-        double time = av_gettime_relative() / 1000000.0;
-        return pts_drift + time - (time - last_updated) * (1.0 - speed);
-    }
+    ClockSnapshot snapshot;
+    getSnapshot(&snapshot);
+    return calculateClock(&snapshot, av_gettime_relative() / 1000000.0);
 }
 
 void MediaClock::setClock(double pts, double time)
 {
-    this->pts = pts;
-    this->last_updated = time;
-    this->pts_drift = this->pts - time;
+    state.write([pts, time](ClockSnapshot &clock)
+                {
+                    clock.pts = pts;
+                    clock.last_updated = time;
+                    clock.pts_drift = pts - time;
+                });
 }
 
 void MediaClock::setClock(double pts)
@@ -44,10 +47,21 @@ void MediaClock::setClock(double pts)
     setClock(pts, time);
 }
 
+/**
+ * 以当前时间为基准重设时钟并修改速度，在同一次更新里完成，读取方不会看到新的速度搭配旧的基准
+ * @param speed
+ */
 void MediaClock::setSpeed(double speed)
 {
-    setClock(getClock());
-    this->speed = speed;
+    double time = av_gettime_relative() / 1000000.0;
+    state.write([speed, time](ClockSnapshot &clock)
+                {
+                    double pts = calculateClock(&clock, time);
+                    clock.pts = pts;
+                    clock.last_updated = time;
+                    clock.pts_drift = pts - time;
+                    clock.speed = speed;
+                });
 }
 
 void MediaClock::syncToSlave(MediaClock *slave)
@@ -62,6 +76,28 @@ void MediaClock::syncToSlave(MediaClock *slave)
 
 double MediaClock::getSpeed() const
 {
-    return speed;
+    ClockSnapshot snapshot;
+    getSnapshot(&snapshot);
+    return snapshot.speed;
 }
 
+/**
+ * 读取时钟状态，不会等待正在进行的更新
+ * @param snapshot
+ */
+void MediaClock::getSnapshot(ClockSnapshot *snapshot) const
+{
+    state.read(snapshot);
+}
+
+double MediaClock::calculateClock(const ClockSnapshot *snapshot, double time)
+{
+    if (snapshot->paused)
+    {
+        return snapshot->pts;
+    }
+    else
+    {
+        return snapshot->pts_drift + time - (time - snapshot->last_updated) * (1.0 - snapshot->speed);
+    }
+}
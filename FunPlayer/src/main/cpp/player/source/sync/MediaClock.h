@@ -2,11 +2,28 @@
 #define MEDIACLOCK_H
 
 #include <math.h>
+#include <common/SeqLock.h>
 
 extern "C" {
 #include <libavutil/time.h>
 };
 
+/**
+ * 时钟的一致快照
+ */
+typedef struct ClockSnapshot
+{
+    double pts;
+    double pts_drift;
+    double last_updated;
+    double speed;
+    int paused;
+} ClockSnapshot;
+
+/**
+ * 媒体时钟，由音频回调线程、同步线程以及读包线程更新，解码线程和调用线程读取
+ * 用双缓冲顺序锁发布状态，读取时不加锁、不等待更新，也不会读到更新到一半的状态
+ */
 class MediaClock
 {
 
@@ -36,12 +53,15 @@ public:
     // 获取时钟速度
     double getSpeed() const;
 
+    // 获取时钟状态的快照
+    void getSnapshot(ClockSnapshot *snapshot) const;
+
 private:
-    double pts;
-    double pts_drift;
-    double last_updated;
-    double speed;
-    int paused;
+    // 根据快照计算时钟
+    static double calculateClock(const ClockSnapshot *snapshot, double time);
+
+private:
+    SeqLock<ClockSnapshot> state;           // 时钟状态
 };
 
 
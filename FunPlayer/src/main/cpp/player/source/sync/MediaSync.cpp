@@ -14,9 +14,16 @@ MediaSync::MediaSync(PlayerState *playerState)
 
     forceRefresh = 0;
     maxFrameDuration = 10.0;
+    startOffset = 0;
     frameTimerRefresh = 1;
     frameTimer = 0;
 
+    eventPending = 0;
+    lastPaused = 0;
+    posterPending = 0;
+    presentDueTime = NAN;
+    presentDuration = 0;
+    lastPresentTime = NAN;
 
     videoDevice = NULL;
     swsContext = NULL;
@@ -64,8 +71,10 @@ void MediaSync::start(VideoDecoder *videoDecoder, AudioDecoder *audioDecoder)
     mExit = false;
     mCondition.signal();
     mMutex.unlock();
+    posterPending = playerState->fastStart && !playerState->displayDisable;
     if (videoDecoder)
     {
+        videoDecoder->getFrameQueue()->setPushNotify(&mWaitMutex, &mWaitCondition);
         syncThread = std::thread(&MediaSync::run, this);
     }
 }
@@ -76,6 +85,7 @@ void MediaSync::stop()
     abortRequest = true;
     mCondition.signal();
     mMutex.unlock();
+    wakeUp();
 
     mMutex.lock();
     while (!mExit)
@@ -83,7 +93,14 @@ void MediaSync::stop()
         mCondition.wait(mMutex);
     }
     mMutex.unlock();
-    syncThread.join();
+    if (syncThread.joinable())
+    {
+        syncThread.join();
+    }
+    if (videoDecoder)
+    {
+        videoDecoder->getFrameQueue()->setPushNotify(NULL, NULL);
+    }
 }
 
 void MediaSync::setVideoDevice(VideoDevice *device)
@@ -97,12 +114,58 @@ void MediaSync::setMaxDuration(double maxDuration)
     this->maxFrameDuration = maxDuration;
 }
 
+void MediaSync::setStartTime(int64_t startTime)
+{
+    int64_t offset = 0;
+    if (startTime > 0 && startTime != AV_NOPTS_VALUE)
+    {
+        offset = av_rescale(startTime, 1000, AV_TIME_BASE);
+    }
+    startOffset.store(offset, std::memory_order_relaxed);
+}
+
+/**
+ * 音频回调线程和同步线程都会调用，时钟还没有开始时用定位位置代替
+ * 同时发布音视频时钟差值，供getAVDiff不加锁读取
+ * @return
+ */
+int64_t MediaSync::updatePosition()
+{
+    int64_t pos;
+    double clock = getMasterClock();
+    if (isnan(clock))
+    {
+        pos = av_rescale(playerState->seekPos, 1000, AV_TIME_BASE);
+    }
+    else
+    {
+        pos = (int64_t) (clock * 1000);
+    }
+    pos -= startOffset.load(std::memory_order_relaxed);
+    if (pos < 0)
+    {
+        pos = 0;
+    }
+    playerState->playback.setPosition(pos);
+    playerState->playback.setAVDiff(audioDecoder && videoDecoder ? getVideoDiffClock() : NAN);
+    return pos;
+}
+
 void MediaSync::refreshVideoTimer()
 {
     mMutex.lock();
     this->frameTimerRefresh = 1;
     mCondition.signal();
     mMutex.unlock();
+    wakeUp();
+}
+
+void MediaSync::wakeUp()
+{
+    mWaitMutex.lock();
+    eventPending = 1;
+    mWaitCondition.signal();
+    mWaitMutex.unlock();
 }
 
 void MediaSync::updateAudioClock(double pts, double time)
@@ -116,6 +179,11 @@ double MediaSync::getAudioDiffClock()
     return audioClock->getClock() - getMasterClock();
 }
 
+double MediaSync::getVideoDiffClock()
+{
+    return videoClock->getClock() - audioClock->getClock();
+}
+
 void MediaSync::updateExternalClock(double pts)
 {
     extClock->setClock(pts);
@@ -162,7 +230,8 @@ MediaClock *MediaSync::getExternalClock()
 
 void MediaSync::run()
 {
-    double remaining_time = 0.0;
+    double remaining_time;
+    TRACE_THREAD("video_sync");
     while (true)
     {
 
@@ -175,15 +244,41 @@ void MediaSync::run()
             break;
         }
 
-        if (remaining_time > 0.0)
+        // 暂停期间画面停留的时间不算作重复帧
+        if (playerState->pauseRequest != lastPaused)
         {
-            av_usleep((int64_t) (remaining_time * 1000000.0));
+            lastPaused = playerState->pauseRequest;
+            lastPresentTime = NAN;
         }
-        remaining_time = REFRESH_RATE;
+
+        // 快速起播时，开始播放之前显示第一帧作为封面
+        if (posterPending)
+        {
+            if (playerState->pauseRequest)
+            {
+                presentPoster();
+            }
+            else
+            {
+                posterPending = 0;
+            }
+        }
+
+        // 拖动时不与时钟同步，关键帧解码出来就显示
+        if (playerState->scrubbing)
+        {
+            presentScrubFrame();
+            waitEvent(-1);
+            continue;
+        }
+
+        // 小于0表示没有待显示的帧，等待新的帧入队
+        remaining_time = -1;
         if (!playerState->pauseRequest || forceRefresh)
         {
             refreshVideo(&remaining_time);
         }
+        waitEvent(remaining_time);
     }
 
     mExit = true;
@@ -218,11 +313,18 @@ void MediaSync::refreshVideo(double *remaining_time)
             lastFrame = videoDecoder->getFrameQueue()->lastFrame();
             // 当前帧
             currentFrame = videoDecoder->getFrameQueue()->currentFrame();
-            // 判断是否需要强制更新帧的时间
+            // 丢弃定位之前解码的旧帧
+            if (currentFrame->serial != videoDecoder->getPacketSerial())
+            {
+                videoDecoder->getFrameQueue()->popFrame();
+                continue;
+            }
+            // 判断是否需要强制更新帧的时间，定位之后的第一帧不统计重复
             if (frameTimerRefresh)
             {
                 frameTimer = av_gettime_relative() / 1000000.0;
                 frameTimerRefresh = 0;
+                lastPresentTime = NAN;
             }
 
             // 如果处于暂停状态，则直接显示
@@ -256,9 +358,11 @@ void MediaSync::refreshVideo(double *remaining_time)
             // 如果当前时间小于帧计时器的时间 + 延时时间，则表示还没到当前帧
             if (time < frameTimer + delay)
             {
-                *remaining_time = FFMIN(frameTimer + delay - time, *remaining_time);
+                *remaining_time = frameTimer + delay - time;
                 break;
             }
+            presentDueTime = frameTimer + delay;
+            presentDuration = lastDuration;
 
             // 更新帧计时器
             frameTimer += delay;
@@ -268,14 +372,12 @@ void MediaSync::refreshVideo(double *remaining_time)
                 frameTimer = time;
             }
 
-            // 更新视频时钟的pts
-            mMutex.lock();
+            // 更新视频时钟的pts，时钟自身保证读写一致，不需要加锁
             if (!isnan(currentFrame->pts))
             {
                 videoClock->setClock(currentFrame->pts);
                 extClock->syncToSlave(videoClock);
             }
-            mMutex.unlock();
 
             // 如果队列中还剩余超过一帧的数据时，需要拿到下一帧，然后计算间隔，并判断是否需要进行舍帧操作
             if (videoDecoder->getFrameSize() > 1)
@@ -288,6 +390,9 @@ void MediaSync::refreshVideo(double *remaining_time)
                         || (playerState->frameDrop && playerState->syncType != AV_SYNC_VIDEO)))
                 {
                     videoDecoder->getFrameQueue()->popFrame();
+                    playerState->droppedFrames++;
+                    playerState->skippedFrames++;
+                    TRACE_INSTANT("skip_frame", (int64_t) (nextFrame->pts * 1000));
                     continue;
                 }
             }
@@ -295,52 +400,164 @@ void MediaSync::refreshVideo(double *remaining_time)
             // 下一帧
             videoDecoder->getFrameQueue()->popFrame();
             forceRefresh = 1;
+            // 立即计算下一帧的显示时间
+            *remaining_time = 0;
         }
 
         break;
     }
 
-    // 回调当前时长
-    if (playerState->messageQueue && playerState->syncType == AV_SYNC_VIDEO)
+    // 回调当前时长，同步到音频时钟时由音频回调线程负责
+    if (playerState->syncType != AV_SYNC_AUDIO)
     {
-        // 起始延时
-        int64_t start_time = videoDecoder->getFormatContext()->start_time;
-        int64_t start_diff = 0;
-        if (start_time > 0 && start_time != AV_NOPTS_VALUE)
+        int64_t pos = updatePosition();
+        if (playerState->messageQueue && playerState->syncType == AV_SYNC_VIDEO)
         {
-            start_diff = av_rescale(start_time, 1000, AV_TIME_BASE);
+            if (playerState->videoDuration < 0)
+            {
+                pos = 0;
+            }
+            playerState->messageQueue->postMessage(MSG_CURRENT_POSITON, (int) pos,
+                                                   playerState->videoDuration);
         }
-        // 计算主时钟的时间
-        int64_t pos = 0;
-        double clock = getMasterClock();
-        if (isnan(clock))
+    }
+
+    // 显示画面
+    if (!playerState->displayDisable && forceRefresh && videoDecoder
+        && videoDecoder->getFrameQueue()->getShowIndex())
+    {
+        renderVideo();
+        updatePresentStats();
+        playerState->markStartupPhase(STARTUP_FIRST_FRAME);
+        playerState->markSeekPresented(videoDecoder->getFrameQueue()->lastFrame()->serial, 0);
+    }
+    forceRefresh = 0;
+}
+
+/**
+ * 等待下一帧的显示时间，remaining_time 为0时不等待，小于0时一直等待到被唤醒
+ * 没有待显示的帧时，由帧队列入队时唤醒，暂停时不关心入队，只等待播放状态变化
+ * @param remaining_time 距离下一帧显示的时间(秒)
+ */
+void MediaSync::waitEvent(double remaining_time)
+{
+    if (remaining_time == 0)
+    {
+        return;
+    }
+    // 实时流同步到外部时钟时需要定时调整外部时钟的速度
+    if (remaining_time < 0 && !playerState->pauseRequest && playerState->realTime
+        && playerState->syncType == AV_SYNC_EXTERNAL)
+    {
+        remaining_time = REFRESH_RATE;
+    }
+
+    TRACE_SCOPE("wait");
+    VideoFrameQueue *frameQueue = videoDecoder->getFrameQueue();
+    mWaitMutex.lock();
+    if (!eventPending && !abortRequest && !playerState->abortRequest)
+    {
+        if (remaining_time > 0)
+        {
+            mWaitCondition.waitRelative(mWaitMutex, (nsecs_t) (remaining_time * 1000000000.0));
+        }
+        else if (playerState->pauseRequest && !posterPending && !playerState->scrubbing)
         {
-            pos = playerState->seekPos;
+            mWaitCondition.wait(mWaitMutex);
         }
         else
         {
-            pos = (int64_t) (clock * 1000);
+            // 先标记等待再检查队列，入队时能看到标记并唤醒，不会丢失通知
+            if (frameQueue->setConsumerWaiting(1) <= 0)
+            {
+                mWaitCondition.wait(mWaitMutex);
+            }
+            frameQueue->setConsumerWaiting(0);
+        }
+    }
+    eventPending = 0;
+    mWaitMutex.unlock();
+}
+
+/**
+ * 拖动时解码线程只输出目标附近的关键帧，依次显示并更新视频时钟，结束拖动之后重新设置帧计时器
+ */
+void MediaSync::presentScrubFrame()
+{
+    VideoFrameQueue *frameQueue = videoDecoder->getFrameQueue();
+    while (frameQueue->getFrameSize() > 0)
+    {
+        // 丢弃上一次拖动位置解码的旧帧
+        if (frameQueue->currentFrame()->serial != videoDecoder->getPacketSerial())
+        {
+            frameQueue->popFrame();
+            continue;
         }
-        if (pos < 0 || pos < start_diff)
+        frameQueue->popFrame();
+        Frame *frame = frameQueue->lastFrame();
+        if (!isnan(frame->pts))
         {
-            pos = 0;
+            videoClock->setClock(frame->pts);
         }
-        pos = (long) (pos - start_diff);
-        if (playerState->videoDuration < 0)
+        TRACE_INSTANT("scrub_frame", (int64_t) (frame->pts * 1000));
+        if (!playerState->displayDisable)
         {
-            pos = 0;
+            renderVideo();
         }
-        playerState->messageQueue->postMessage(MSG_CURRENT_POSITON, pos,
-                                               playerState->videoDuration);
+        playerState->markSeekPresented(frame->serial, 0);
+        frameTimerRefresh = 1;
     }
+}
 
-    // 显示画面
-    if (!playerState->displayDisable && forceRefresh && videoDecoder
-        && videoDecoder->getFrameQueue()->getShowIndex())
+/**
+ * 暂停状态下显示帧队列中的第一帧，帧队列保留最后显示的帧，开始播放后从下一帧继续同步，
+ * 不计入送显误差，开始播放时重新设置帧计时器
+ */
+void MediaSync::presentPoster()
+{
+    VideoFrameQueue *frameQueue = videoDecoder->getFrameQueue();
+    while (frameQueue->getFrameSize() > 0)
     {
+        // 丢弃定位之前解码的旧帧
+        if (frameQueue->currentFrame()->serial != videoDecoder->getPacketSerial())
+        {
+            frameQueue->popFrame();
+            continue;
+        }
+        frameQueue->popFrame();
+        Frame *frame = frameQueue->lastFrame();
+        if (!isnan(frame->pts))
+        {
+            videoClock->setClock(frame->pts);
+        }
+        TRACE_INSTANT("poster", (int64_t) (frame->pts * 1000));
         renderVideo();
+        playerState->markStartupPhase(STARTUP_FIRST_FRAME);
+        playerState->markSeekPresented(frame->serial, 0);
+        frameTimerRefresh = 1;
+        posterPending = 0;
+        break;
     }
-    forceRefresh = 0;
+}
+
+/**
+ * 统计帧的送显误差以及画面重复
+ */
+void MediaSync::updatePresentStats()
+{
+    if (isnan(presentDueTime))
+    {
+        return;
+    }
+    double time = av_gettime_relative() / 1000000.0;
+    playerState->presentError.add((int64_t) (fabs(time - presentDueTime) * 1000000.0));
+    if (!isnan(lastPresentTime) && presentDuration > 0
+        && time - lastPresentTime > presentDuration * 1.5)
+    {
+        playerState->repeatedFrames++;
+    }
+    lastPresentTime = time;
+    presentDueTime = NAN;
 }
 
 void MediaSync::checkExternalClockSpeed()
@@ -402,6 +619,11 @@ double MediaSync::calculateDelay(double delay)
 
 double MediaSync::calculateDuration(Frame *vp, Frame *nextvp)
 {
+    // 不同序列号的帧之间发生了定位，时间戳不连续
+    if (vp->serial != nextvp->serial)
+    {
+        return 0.0;
+    }
     double duration = nextvp->pts - vp->pts;
     if (isnan(duration) || duration <= 0 || duration > maxFrameDuration)
     {
@@ -415,7 +637,10 @@ double MediaSync::calculateDuration(Frame *vp, Frame *nextvp)
 
 void MediaSync::renderVideo()
 {
+    TRACE_SCOPE("render");
+    TRACE_BEGIN("render_lock");
     mMutex.lock();
+    TRACE_END("render_lock");
     if (!videoDecoder || !videoDevice)
     {
         mMutex.unlock();
@@ -443,32 +668,41 @@ void MediaSync::renderVideo()
                     vp->frame->linesize[2] < 0)
                 {
                     av_log(NULL, AV_LOG_ERROR, "Negative linesize is not supported for YUV.\n");
+                    mMutex.unlock();
                     return;
                 }
+                TRACE_SCOPE("upload");
+                STATS_BEGIN(uploadStart);
                 ret = videoDevice->onUpdateYUV(vp->frame->data[0], vp->frame->linesize[0],
                                                vp->frame->data[1], vp->frame->linesize[1],
                                                vp->frame->data[2], vp->frame->linesize[2]);
+                STATS_END(playerState, STAGE_VIDEO_UPLOAD, uploadStart);
                 if (ret < 0)
                 {
+                    mMutex.unlock();
                     return;
                 }
                 break;
             }
 
-                // 直接渲染BGRA，对应的是shader->argb格式
+                // 直接渲染BGRA，对应的是shader->argb格式，解码线程转换过的帧也走这里
             case AV_PIX_FMT_BGRA:
             {
                 videoDevice->onInitTexture(vp->frame->width, vp->frame->height,
-                                           FMT_ARGB, BLEND_NONE);
+                                           FMT_ARGB, BLEND_NONE, videoDecoder->getRotate());
+                TRACE_SCOPE("upload");
+                STATS_BEGIN(uploadStart);
                 ret = videoDevice->onUpdateARGB(vp->frame->data[0], vp->frame->linesize[0]);
+                STATS_END(playerState, STAGE_VIDEO_UPLOAD, uploadStart);
                 if (ret < 0)
                 {
+                    mMutex.unlock();
                     return;
                 }
                 break;
             }
 
-                // 其他格式转码成BGRA格式再做渲染
+                // 解码线程转换失败的帧，在这里转码成BGRA格式再做渲染
             default:
             {
                 swsContext = sws_getCachedContext(swsContext,
@@ -476,6 +710,13 @@ void MediaSync::renderVideo()
                                                   (AVPixelFormat) vp->frame->format,
                                                   vp->frame->width, vp->frame->height,
                                                   AV_PIX_FMT_BGRA, SWS_BICUBIC, NULL, NULL, NULL);
+                // 分辨率变化时重新分配缓冲
+                if (mBuffer && (pFrameARGB->width != vp->frame->width
+                                || pFrameARGB->height != vp->frame->height))
+                {
+                    av_frame_free(&pFrameARGB);
+                    av_freep(&mBuffer);
+                }
                 if (!mBuffer)
                 {
                     int numBytes = av_image_get_buffer_size(AV_PIX_FMT_BGRA, vp->frame->width,
@@ -485,19 +726,28 @@ void MediaSync::renderVideo()
                     av_image_fill_arrays(pFrameARGB->data, pFrameARGB->linesize, mBuffer,
                                          AV_PIX_FMT_BGRA,
                                          vp->frame->width, vp->frame->height, 1);
+                    pFrameARGB->width = vp->frame->width;
+                    pFrameARGB->height = vp->frame->height;
                 }
                 if (swsContext != NULL)
                 {
+                    TRACE_SCOPE("convert");
+                    STATS_BEGIN(convertStart);
                     sws_scale(swsContext, (uint8_t const *const *) vp->frame->data,
                               vp->frame->linesize, 0, vp->frame->height,
                               pFrameARGB->data, pFrameARGB->linesize);
+                    STATS_END(playerState, STAGE_VIDEO_CONVERT, convertStart);
                 }
 
                 videoDevice->onInitTexture(vp->frame->width, vp->frame->height,
                                            FMT_ARGB, BLEND_NONE, videoDecoder->getRotate());
+                TRACE_SCOPE("upload");
+                STATS_BEGIN(uploadStart);
                 ret = videoDevice->onUpdateARGB(pFrameARGB->data[0], pFrameARGB->linesize[0]);
+                STATS_END(playerState, STAGE_VIDEO_UPLOAD, uploadStart);
                 if (ret < 0)
                 {
+                    mMutex.unlock();
                     return;
                 }
                 break;
@@ -508,7 +758,10 @@ void MediaSync::renderVideo()
     // 请求渲染视频
     if (videoDevice != NULL)
     {
+        TRACE_SCOPE("present");
+        STATS_BEGIN(renderStart);
         videoDevice->onRequestRender(vp->frame->linesize[0] < 0);
+        STATS_END(playerState, STAGE_VIDEO_RENDER, renderStart);
     }
     mMutex.unlock();
 }
@@ -10,6 +10,8 @@
 
 /**
  * 视频同步器
+ * 同步线程只在下一帧的预定显示时间醒来，队列为空或者暂停时一直休眠，
+ * 直到有新的帧入队、定位、暂停恢复或者退出
  */
 class MediaSync
 {
@@ -31,15 +33,27 @@ public:
     // 设置帧最大间隔
     void setMaxDuration(double maxDuration);
 
+    // 设置文件的起始时间(AV_TIME_BASE)，计算播放位置时扣除
+    void setStartTime(int64_t startTime);
+
+    // 根据主时钟计算播放位置(毫秒)并发布到播放状态快照
+    int64_t updatePosition();
+
     // 更新视频帧的计时器
     void refreshVideoTimer();
 
+    // 唤醒同步线程重新计算下一帧的显示时间，播放状态变化时调用
+    void wakeUp();
+
     // 更新音频时钟
     void updateAudioClock(double pts, double time);
 
     // 获取音频时钟与主时钟的差值
     double getAudioDiffClock();
 
+    // 获取视频时钟与音频时钟的差值
+    double getVideoDiffClock();
+
     // 更新外部时钟
     void updateExternalClock(double pts);
 
@@ -64,6 +78,16 @@ private:
 
     void renderVideo();
 
+    void waitEvent(double remaining_time);
+
+    // 显示第一帧作为封面
+    void presentPoster();
+
+    // 拖动时立即显示解码出来的关键帧
+    void presentScrubFrame();
+
+    void updatePresentStats();
+
 private:
     PlayerState *playerState;               // 播放器状态
     bool abortRequest;                      // 停止
@@ -80,11 +104,22 @@ private:
     Condition mCondition;
     std::thread syncThread;                 // 同步线程
 
+    Mutex mWaitMutex;                       // 同步线程等待事件的锁
+    Condition mWaitCondition;               // 新的帧入队、定位、暂停恢复以及退出时唤醒
+    int eventPending;                       // 是否有未处理的唤醒事件
+    int lastPaused;                         // 上一次的暂停状态
+    int posterPending;                      // 快速起播时，开始播放之前等待显示第一帧
+
     int forceRefresh;                       // 强制刷新标志
     double maxFrameDuration;                // 最大帧延时
+    std::atomic<int64_t> startOffset;       // 文件的起始时间(毫秒)
     int frameTimerRefresh;                  // 刷新时钟
     double frameTimer;                      // 视频时钟
 
+    double presentDueTime;                  // 当前帧的预定显示时间
+    double presentDuration;                 // 上一帧预期的显示时长
+    double lastPresentTime;                 // 上一帧实际送显的时间
+
     VideoDevice *videoDevice;               // 视频输出设备
 
     AVFrame *pFrameARGB;
@@ -621,6 +621,47 @@ public class MediaPlayerEx implements IMediaPlayer {
 
     private native void _seekTo(float msec) throws IllegalStateException;
 
+    /**
+     * Starts scrubbing, e.g. when the user starts dragging the seek bar.
+     * <p>
+     * Until {@link #endScrub()} only the key frame nearest each target is decoded and
+     * shown immediately without A/V sync, and audio is muted. Has no effect without video.
+     *
+     * @throws IllegalStateException if the internal player engine has not been
+     *                               initialized
+     */
+    public void beginScrub() throws IllegalStateException {
+        _beginScrub();
+    }
+
+    private native void _beginScrub() throws IllegalStateException;
+
+    /**
+     * Moves the scrub preview to a new position. Earlier targets that have not been
+     * shown yet are dropped.
+     *
+     * @param msec the offset in milliseconds from the start to preview
+     * @throws IllegalStateException if the internal player engine has not been
+     *                               initialized
+     */
+    public void updateScrub(float msec) throws IllegalStateException {
+        _updateScrub(msec);
+    }
+
+    private native void _updateScrub(float msec) throws IllegalStateException;
+
+    /**
+     * Ends scrubbing, seeks to the last scrub position and resumes normal playback.
+     *
+     * @throws IllegalStateException if the internal player engine has not been
+     *                               initialized
+     */
+    public void endScrub() throws IllegalStateException {
+        _endScrub();
+    }
+
+    private native void _endScrub() throws IllegalStateException;
+
     /**
      * Gets the current playback position.
      *
@@ -645,6 +686,205 @@ public class MediaPlayerEx implements IMediaPlayer {
 
     private native long _getDuration();
 
+    /** Number of pipeline stages reported by {@link #getStats()}. */
+    public static final int STATS_STAGE_COUNT = 7;
+
+    /** Number of values reported per pipeline stage by {@link #getStats()}. */
+    public static final int STATS_STAGE_FIELDS = 5;
+
+    /** Stage index of reading packets from the demuxer. */
+    public static final int STATS_STAGE_DEMUX = 0;
+    /** Stage index of audio decoding. */
+    public static final int STATS_STAGE_AUDIO_DECODE = 1;
+    /** Stage index of video decoding. */
+    public static final int STATS_STAGE_VIDEO_DECODE = 2;
+    /** Stage index of audio resampling. */
+    public static final int STATS_STAGE_AUDIO_RESAMPLE = 3;
+    /** Stage index of video pixel format conversion. */
+    public static final int STATS_STAGE_VIDEO_CONVERT = 4;
+    /** Stage index of video texture upload. */
+    public static final int STATS_STAGE_VIDEO_UPLOAD = 5;
+    /** Stage index of video drawing and buffer swap. */
+    public static final int STATS_STAGE_VIDEO_RENDER = 6;
+
+    /** Offset of the sample count within a stage or latency group. */
+    public static final int STATS_FIELD_COUNT = 0;
+    /** Offset of the total time (us) within a stage or latency group. */
+    public static final int STATS_FIELD_TOTAL_TIME = 1;
+    /** Offset of the max time (us) within a stage or latency group. */
+    public static final int STATS_FIELD_MAX_TIME = 2;
+    /** Offset of the p50 bucket bound (us) within a stage or latency group. */
+    public static final int STATS_FIELD_P50 = 3;
+    /** Offset of the p99 bucket bound (us) within a stage or latency group. */
+    public static final int STATS_FIELD_P99 = 4;
+
+    /** Index of the queued audio packet count in {@link #getStats()}. */
+    public static final int STATS_AUDIO_PACKETS = 35;
+    /** Index of the queued video packet count in {@link #getStats()}. */
+    public static final int STATS_VIDEO_PACKETS = 36;
+    /** Index of the queued audio packet bytes in {@link #getStats()}. */
+    public static final int STATS_AUDIO_QUEUE_BYTES = 37;
+    /** Index of the queued video packet bytes in {@link #getStats()}. */
+    public static final int STATS_VIDEO_QUEUE_BYTES = 38;
+    /** Index of the pending decoded video frame count in {@link #getStats()}. */
+    public static final int STATS_VIDEO_FRAMES = 39;
+    /** Index of the buffered PCM bytes in {@link #getStats()}. */
+    public static final int STATS_AUDIO_BUFFER_BYTES = 40;
+    /** Index of the decoded video frame count in {@link #getStats()}. */
+    public static final int STATS_DECODED_FRAMES = 41;
+    /** Index of the dropped video frame count in {@link #getStats()}. */
+    public static final int STATS_DROPPED_FRAMES = 42;
+    /** Index of the presented video frame count in {@link #getStats()}. */
+    public static final int STATS_PRESENTED_FRAMES = 43;
+    /** Index of the repeated video frame count in {@link #getStats()}. */
+    public static final int STATS_REPEATED_FRAMES = 44;
+    /** Index of the skipped video frame count in {@link #getStats()}. */
+    public static final int STATS_SKIPPED_FRAMES = 45;
+    /** Index of the open milestone (us since prepare) in {@link #getStats()}. */
+    public static final int STATS_STARTUP_OPEN = 46;
+    /** Index of the probe milestone (us since prepare) in {@link #getStats()}. */
+    public static final int STATS_STARTUP_PROBE = 47;
+    /** Index of the codec open milestone (us since prepare) in {@link #getStats()}. */
+    public static final int STATS_STARTUP_CODEC_OPEN = 48;
+    /** Index of the first packet milestone (us since prepare) in {@link #getStats()}. */
+    public static final int STATS_STARTUP_FIRST_PACKET = 49;
+    /** Index of the first frame milestone (us since prepare) in {@link #getStats()}. */
+    public static final int STATS_STARTUP_FIRST_FRAME = 50;
+    /** Index of the number of seeks served from the packet cache in {@link #getStats()}. */
+    public static final int STATS_CACHED_SEEKS = 51;
+    /** Index of the number of seeks that went to the demuxer in {@link #getStats()}. */
+    public static final int STATS_DEMUXER_SEEKS = 52;
+    /** Index of the packet cache size in bytes in {@link #getStats()}. */
+    public static final int STATS_PACKET_CACHE_BYTES = 53;
+    /** Index of the number of seeks replaced by a newer request in {@link #getStats()}. */
+    public static final int STATS_COALESCED_SEEKS = 54;
+    /** Index of the number of seeks aborted by a newer request in {@link #getStats()}. */
+    public static final int STATS_ABORTED_SEEKS = 55;
+    /** Start of the seek-to-presented latency group in {@link #getStats()}. */
+    public static final int STATS_SEEK_LATENCY = 56;
+    /** Index of the number of completed accurate-seek catch-ups in {@link #getStats()}. */
+    public static final int STATS_ACCURATE_SEEKS = 61;
+    /** Index of the frames decoded and discarded before seek targets in {@link #getStats()}. */
+    public static final int STATS_CATCHUP_FRAMES = 62;
+    /** Start of the accurate-seek catch-up time group in {@link #getStats()}. */
+    public static final int STATS_CATCHUP_TIME = 63;
+    /** Index of the demuxer seeks resolved through the keyframe index in {@link #getStats()}. */
+    public static final int STATS_INDEX_SEEKS = 68;
+    /** Index of the number of keyframe index entries in {@link #getStats()}. */
+    public static final int STATS_SEEK_INDEX_ENTRIES = 69;
+    /** Index of the bytes read ahead of the demuxer in {@link #getStats()}. */
+    public static final int STATS_IO_BUFFERED_BYTES = 70;
+    /** Index of the total bytes read by the read-ahead thread in {@link #getStats()}. */
+    public static final int STATS_IO_READ_BYTES = 71;
+    /** Index of the time (us) the read-ahead thread spent reading in {@link #getStats()}. */
+    public static final int STATS_IO_READ_TIME = 72;
+    /** Index of the number of demuxer reads that found the buffer empty in {@link #getStats()}. */
+    public static final int STATS_IO_STALLS = 73;
+    /** Index of the time (us) the demuxer waited for data in {@link #getStats()}. */
+    public static final int STATS_IO_STALL_TIME = 74;
+    /** Index of the number of seeks served inside the read-ahead buffer in {@link #getStats()}. */
+    public static final int STATS_IO_BUFFER_SEEKS = 75;
+    /** Index of the number of seeks that went to the protocol in {@link #getStats()}. */
+    public static final int STATS_IO_SEEKS = 76;
+
+    /**
+     * Gets a snapshot of the pipeline statistics. Use the STATS_* constants to index the
+     * returned array. Times are in microseconds. In order, the array holds:
+     * <ol>
+     * <li>For each stage, from {@link #STATS_STAGE_DEMUX} to {@link #STATS_STAGE_VIDEO_RENDER},
+     * {@link #STATS_STAGE_FIELDS} values at {@code stage * STATS_STAGE_FIELDS}: the sample
+     * count, total time, max time, and p50 and p99 bucket bounds (STATS_FIELD_* offsets).
+     * <li>The queued audio/video packet counts and bytes, the pending video frames and the
+     * buffered audio bytes, from {@link #STATS_AUDIO_PACKETS}.
+     * <li>The decoded, dropped, presented, repeated and skipped video frame counts, from
+     * {@link #STATS_DECODED_FRAMES}.
+     * <li>The startup milestones (open, probe, codec open, first packet, first frame) since
+     * prepare began, or 0 if not reached yet, from {@link #STATS_STARTUP_OPEN}.
+     * <li>The seeks served from the packet cache, the seeks that went to the demuxer and the
+     * packet cache size in bytes, from {@link #STATS_CACHED_SEEKS}.
+     * <li>The seeks replaced or aborted by a newer request, from
+     * {@link #STATS_COALESCED_SEEKS}, and the seek-to-presented latency at
+     * {@link #STATS_SEEK_LATENCY} (STATS_FIELD_* offsets).
+     * <li>The completed accurate-seek catch-ups and the frames decoded and discarded before
+     * the target, from {@link #STATS_ACCURATE_SEEKS}, and the catch-up time at
+     * {@link #STATS_CATCHUP_TIME} (STATS_FIELD_* offsets).
+     * <li>The demuxer seeks resolved through the keyframe index and the number of keyframe
+     * index entries, from {@link #STATS_INDEX_SEEKS}.
+     * <li>The read-ahead I/O values, from {@link #STATS_IO_BUFFERED_BYTES}: bytes buffered
+     * ahead of the demuxer, total bytes read and time spent reading (their ratio is the I/O
+     * throughput), the number and total time of demuxer reads that found the buffer empty,
+     * and seeks served inside the buffer versus seeks that went to the underlying protocol.
+     * </ol>
+     *
+     * @return the statistics, or null if the player is not initialized
+     */
+    public long[] getStats() {
+        return _getStats();
+    }
+
+    private native long[] _getStats();
+
+    /** Index of the playback position (ms) in {@link #getPlaybackSnapshot()}. */
+    public static final int SNAPSHOT_POSITION = 0;
+    /** Index of the duration (ms, -1 if unknown) in {@link #getPlaybackSnapshot()}. */
+    public static final int SNAPSHOT_DURATION = 1;
+    /** Index of the buffered position (ms) in {@link #getPlaybackSnapshot()}. */
+    public static final int SNAPSHOT_BUFFERED_POSITION = 2;
+    /** Index of the video width in {@link #getPlaybackSnapshot()}. */
+    public static final int SNAPSHOT_VIDEO_WIDTH = 3;
+    /** Index of the video height in {@link #getPlaybackSnapshot()}. */
+    public static final int SNAPSHOT_VIDEO_HEIGHT = 4;
+    /** Index of the video rotation in degrees in {@link #getPlaybackSnapshot()}. */
+    public static final int SNAPSHOT_ROTATION = 5;
+    /** Index of the playback state (PLAYBACK_STATE_*) in {@link #getPlaybackSnapshot()}. */
+    public static final int SNAPSHOT_STATE = 6;
+    /** Index of the seeking flag (1 while a seek is pending) in {@link #getPlaybackSnapshot()}. */
+    public static final int SNAPSHOT_SEEKING = 7;
+    /** Index of the dropped video frame count in {@link #getPlaybackSnapshot()}. */
+    public static final int SNAPSHOT_DROPPED_FRAMES = 8;
+    /** Index of the audio stall count in {@link #getPlaybackSnapshot()}. */
+    public static final int SNAPSHOT_STALL_COUNT = 9;
+
+    public static final int PLAYBACK_STATE_IDLE = 0;
+    public static final int PLAYBACK_STATE_PREPARING = 1;
+    public static final int PLAYBACK_STATE_PREPARED = 2;
+    public static final int PLAYBACK_STATE_PLAYING = 3;
+    public static final int PLAYBACK_STATE_PAUSED = 4;
+    public static final int PLAYBACK_STATE_COMPLETED = 5;
+    public static final int PLAYBACK_STATE_STOPPED = 6;
+    public static final int PLAYBACK_STATE_ERROR = 7;
+
+    /**
+     * Gets the position, duration, buffered position, video size, rotation, state
+     * and frame drop / stall counters in a single call. The values are published by
+     * the playback threads and read without locking, so this never blocks, even
+     * while the data source is being opened. Use the SNAPSHOT_* constants to index
+     * the returned array.
+     *
+     * @return the snapshot, or null if the player is not initialized
+     */
+    public long[] getPlaybackSnapshot() {
+        return _getPlaybackSnapshot();
+    }
+
+    private native long[] _getPlaybackSnapshot();
+
+    /**
+     * Writes the recorded pipeline trace events to a Chrome trace-event JSON file,
+     * which can be opened in chrome://tracing or Perfetto. Recording is enabled by
+     * setting the player option "trace" to the number of events buffered per thread
+     * before preparing. Recording stops when the last player that enabled it is
+     * released, so call this before {@link #release()}.
+     *
+     * @param path the output file
+     * @return the number of events written, or a negative value on error
+     */
+    public int dumpTrace(String path) {
+        return _dumpTrace(path);
+    }
+
+    private native int _dumpTrace(String path);
+
 
     // TODO public Metadata getMetadata(final boolean update_only, final boolean apply_filter)
 
@@ -889,6 +1129,8 @@ public class MediaPlayerEx implements IMediaPlayer {
     private static final int MEDIA_ERROR = 100;
     private static final int MEDIA_INFO = 200;
     private static final int MEDIA_CURRENT = 300;
+    // events posted together by native code, only used on the java side
+    private static final int MEDIA_EVENT_BATCH = 1000;
 
     private class EventHandler extends Handler {
 
@@ -907,6 +1149,16 @@ public class MediaPlayerEx implements IMediaPlayer {
             }
 
             switch (msg.what) {
+                case MEDIA_EVENT_BATCH: {
+                    int[] events = (int[]) msg.obj;
+                    for (int i = 0; i + 2 < events.length; i += 3) {
+                        Message m = obtainMessage(events[i], events[i + 1], events[i + 2]);
+                        handleMessage(m);
+                        m.recycle();
+                    }
+                    return;
+                }
+
                 case MEDIA_PREPARED: {
                     if (mOnPreparedListener != null)
                         mOnPreparedListener.onPrepared(mMediaPlayer);
@@ -1020,6 +1272,23 @@ public class MediaPlayerEx implements IMediaPlayer {
         }
     }
 
+    /**
+     * Called from native code to post several events at once. Each event takes
+     * three ints (what, arg1, arg2) in order, and they are dispatched in a single
+     * message to save a handler round trip per event.
+     */
+    private static void postEventsFromNative(Object mediaplayer_ref, int[] events) {
+        final MediaPlayerEx mp = (MediaPlayerEx) ((WeakReference) mediaplayer_ref).get();
+        if (mp == null) {
+            return;
+        }
+
+        if (mp.mEventHandler != null) {
+            Message m = mp.mEventHandler.obtainMessage(MEDIA_EVENT_BATCH, events);
+            mp.mEventHandler.sendMessage(m);
+        }
+    }
+
     /**
      * Register a callback to be invoked when the media source is ready
      * for playback.